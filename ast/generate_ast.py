@@ -2,8 +2,26 @@
 
 # run in the `generated/ast` directory:
 #   rm Expr.hpp && ../../ast/generate_ast.py ../../ast/ExprAst.json . && less Expr.hpp
+# and for the arena-allocated version of the same tree:
+#   rm ArenaExpr.hpp && ../../ast/generate_ast.py --arena ../../ast/ExprAst.json . && less ArenaExpr.hpp
+#
+# and for the flat version:
+#   rm FlatExpr.hpp && ../../ast/generate_ast.py --flat ../../ast/ExprAst.json . && less FlatExpr.hpp
+#
+# and for the binary (saved) version:
+#   rm BinaryExpr.hpp && ../../ast/generate_ast.py --binary ../../ast/ExprAst.json . && less BinaryExpr.hpp
+#
+# The default tree owns its nodes with unique_ptrs, and destroys them with a worklist
+# rather than recursively, so deep trees can't overflow the stack. The arena tree lives in `ast::arena`
+# and refers to its nodes with raw pointers into an `Arena`, which frees them all at once.
+# The flat tree lives in `ast::flat` and keeps its nodes in one table (a `Tree`), referring
+# to them by 32-bit index.
+# The binary tree lives in `ast::binary`, and is a flat tree saved as bytes that can be
+# mapped from a file and read in place; its strings are offsets into the saved bytes.
+# The other layouts reuse the default tree's enums, so it needs to be generated too.
 
 from sys import argv
+import hashlib
 import json
 from pathlib import Path
 
@@ -22,35 +40,126 @@ def resolve(classes):
   for _,c in classes["subClasses"].items():
     c["children"] = [split_child(child) for child in c["children"]]
 
-def emit(classes, output_dir):
+LAYOUTS = [ "default", "arena", "flat", "binary" ]
+
+# (size, alignment) of each type a node can hold, on the 64-bit platforms we build for.
+# Fields are stored largest alignment first, so there's no padding between them, and
+# each node gets a `static_assert` that it's no bigger than these add up to. A type
+# missing from here needs adding before a node can use it.
+FIELD_LAYOUTS = {
+  "double": (8, 8),
+  "utils::Symbol": (8, 8),
+  "uint32_t": (4, 4),
+  "StringRef": (8, 4),
+}
+# Saved trees can't hold pointers, so these types are replaced when saving.
+BINARY_TYPES = { "utils::Symbol": "StringRef" }
+# Node references, which depend on the layout: a variant of (unique or raw) pointers, or an index.
+EXPR_LAYOUTS = { "default": (16, 8), "arena": (16, 8), "flat": (4, 4), "binary": (4, 4) }
+# Every enum has a one-byte underlying type.
+ENUM_LAYOUT = (1, 1)
+
+def field_layout(base_class, subclass, child_type, layout):
+  if child_type == base_class:
+    return EXPR_LAYOUTS[layout]
+  enum_definition = subclass.get("enumDefinition")
+  if enum_definition is not None and child_type == enum_definition["name"]:
+    return ENUM_LAYOUT
+  assert child_type in FIELD_LAYOUTS, f"Unknown size for field type {child_type}; add it to FIELD_LAYOUTS"
+  return FIELD_LAYOUTS[child_type]
+
+# Sorting is stable, so fields with the same alignment stay in declaration order.
+def storage_order(base_class, subclass, layout):
+  return sorted(subclass["children"], key=lambda child: -field_layout(base_class, subclass, child[0], layout)[1])
+
+# The size of a struct of these (size, alignment)s in this order, rounded up to its alignment.
+def packed_size(layouts):
+  size = 0
+  for field_size, alignment in layouts:
+    size = (size + alignment - 1) // alignment * alignment + field_size
+  alignment = max([alignment for _, alignment in layouts], default=1)
+  return (size + alignment - 1) // alignment * alignment
+
+def emit(classes, output_dir, layout):
     base_class = classes["baseClass"]
     subclass_names = classes["subClasses"].keys()
 
     output_dir = Path(output_dir)
     assert output_dir.exists() and output_dir.is_dir(), f"Output dir is not valid directory: {output_dir}"
 
-    output_file = output_dir / f"{base_class}.hpp"
+    prefix = { "default": "", "arena": "Arena", "flat": "Flat", "binary": "Binary" }[layout]
+    output_file = output_dir / f"{prefix}{base_class}.hpp"
     assert not output_file.exists(), f"Output file already exists: {output_file}"
 
+    includes_for_ast = classes["includesForAst"]
+    if layout == "default":
+      includes_for_ast = includes_for_ast + [ "<vector>" ]
+    elif layout == "arena":
+      includes_for_ast = includes_for_ast + [ f"\"ast/{base_class}.hpp\"", "\"utils/Arena.hpp\"", "<vector>" ]
+    elif layout == "flat":
+      includes_for_ast = includes_for_ast + [
+        f"\"ast/{base_class}.hpp\"", "<vector>", "<cstdint>", "<cstddef>", "<unordered_map>"
+      ]
+    elif layout == "binary":
+      includes_for_ast = includes_for_ast + [
+        f"\"ast/Flat{base_class}.hpp\"", "<cstdint>", "<cstddef>", "<cstring>", "<new>", "<stdexcept>",
+        "<string>", "<string_view>", "<type_traits>", "<unordered_map>", "\"utils/Assert.hpp\""
+      ]
+      return emit_binary(classes, output_file, includes_for_ast)
+
     forward_decls_snippet = make_forward_decls_snippet(subclass_names) # needed because variant refers to the subclasses
-    includes_snippet = make_includes_snippet(classes["includesForAst"])
-    using_decls_snippet = make_using_decls_snippet(subclass_names)
-    variant_snippet = make_variant_snippet(base_class, subclass_names)
-    subclasses_snippet = make_subclasses_snippet(classes["subClasses"].items())
-    factory_funs_snippet = make_factory_funs_snippet(classes["subClasses"].items(), classes["autoProvidedDefs"])
-    visitor_snippet = make_visitor_snippet(base_class, subclass_names)
+    includes_snippet = make_includes_snippet(includes_for_ast)
+    using_decls_snippet = make_using_decls_snippet(subclass_names, layout)
+    variant_snippet = make_variant_snippet(base_class, subclass_names, layout)
+    subclasses_snippet = make_subclasses_snippet(base_class, classes["subClasses"].items(), layout)
+    tree_snippet = ""
+    if layout == "flat":
+      node_layouts = [
+        (packed_size([field_layout(base_class, o, t, layout) for t, _ in storage_order(base_class, o, layout)]),
+         max([field_layout(base_class, o, t, layout)[1] for t, _ in o["children"]]))
+        for _, o in classes["subClasses"].items()
+      ]
+      # A variant is its biggest alternative followed by a one-byte index.
+      node_budget = packed_size([(max(size for size, _ in node_layouts), max(a for _, a in node_layouts)), (1, 1)])
+      tree_snippet = make_tree_snippet(base_class, subclass_names, node_budget)
+    destructors_snippet = (
+      make_destructors_snippet(base_class, classes["subClasses"].items()) if layout == "default" else ""
+    )
+    factory_funs_snippet = make_factory_funs_snippet(
+      base_class, classes["subClasses"].items(), classes["autoProvidedDefs"], layout
+    )
+    factory_class_snippet = make_factory_class_snippet(
+      base_class, classes["subClasses"].items(), classes["autoProvidedDefs"],
+      classes.get("factoryState"), classes.get("factoryProvidedDefs", {}), layout
+    )
+    visitor_snippet = make_visitor_snippet(base_class, subclass_names, layout)
+    traversal_snippet = make_traversal_snippet(base_class, classes["subClasses"].items(), layout)
+    structural_snippet = make_structural_snippet(
+      base_class, classes["subClasses"].items(), classes["autoProvidedDefs"], layout
+    )
+    sharing_factory_snippet = make_sharing_factory_snippet(
+      base_class, classes["subClasses"].items(), classes["autoProvidedDefs"],
+      classes.get("factoryState"), classes.get("factoryProvidedDefs", {})
+    ) if layout == "flat" else ""
 
+    namespace = "ast" if layout == "default" else f"ast::{layout}"
     full_class = (
       "#pragma once\n" +
       includes_snippet + "\n" +
-      "namespace ast {\n" +
+      f"namespace {namespace} {{\n" +
       "".join([
           forward_decls_snippet,
           using_decls_snippet,
           variant_snippet,
           subclasses_snippet,
+          destructors_snippet,
+          tree_snippet,
           factory_funs_snippet,
-          visitor_snippet
+          factory_class_snippet,
+          structural_snippet,
+          sharing_factory_snippet,
+          visitor_snippet,
+          traversal_snippet
         ]) +
       "}\n"
     )
@@ -58,10 +167,339 @@ def emit(classes, output_dir):
     with open(output_file, "x") as writer:
       writer.write(full_class)
 
+def emit_binary(classes, output_file, includes_for_ast):
+  base_class = classes["baseClass"]
+  # The saved nodes are the flat tree's, with strings as references into the saved bytes.
+  # The originals are kept for converting to and from the flat tree.
+  flat_subclasses = classes["subClasses"]
+  subclasses = {
+    c: dict(o, children=[[BINARY_TYPES.get(t, t), n] for t, n in o["children"]])
+    for c, o in flat_subclasses.items()
+  }
+
+  full_class = (
+    "#pragma once\n" +
+    make_includes_snippet(includes_for_ast) + "\n" +
+    "namespace ast::binary {\n" +
+    "".join([
+        make_variant_snippet(base_class, subclasses.keys(), "binary"),
+        make_string_ref_snippet(),
+        make_subclasses_snippet(base_class, subclasses.items(), "binary"),
+        make_binary_snippet(base_class, subclasses, flat_subclasses)
+      ]) +
+    "}\n"
+  )
+
+  with open(output_file, "x") as writer:
+    writer.write(full_class)
+
+def make_string_ref_snippet():
+  return """
+// A string in a saved tree, as where its bytes are in the tree's strings (see `Image::string`).
+struct StringRef {
+  uint32_t offset;
+  uint32_t length;
+
+  bool operator==(StringRef other) const { return offset == other.offset && length == other.length; }
+  bool operator!=(StringRef other) const { return !(*this == other); }
+};
+"""
+
+def make_binary_snippet(base_class, subclasses, flat_subclasses):
+  # Everything else a saved tree needs: a `Record` holding any one node, the header, the
+  # `Image` that reads a saved tree in place, and conversions to and from the flat tree.
+  camel_base_class = to_camel_case(base_class)
+  names = list(subclasses.keys())
+
+  # Files saved from a different set of nodes can't be read, so the nodes' definitions are
+  # part of what's checked when opening one.
+  schema = int.from_bytes(
+    hashlib.sha256(json.dumps(flat_subclasses, sort_keys=True).encode()).digest()[:8], "little"
+  )
+
+  node_layouts = [
+    (packed_size([field_layout(base_class, o, t, "binary") for t, _ in storage_order(base_class, o, "binary")]),
+     max([field_layout(base_class, o, t, "binary")[1] for t, _ in o["children"]]))
+    for o in subclasses.values()
+  ]
+  storage_size = max(size for size, _ in node_layouts)
+  storage_alignment = max(alignment for _, alignment in node_layouts)
+  record_budget = packed_size([(storage_size, storage_alignment), ENUM_LAYOUT])
+
+  kind_ofs = "\n".join([
+    f"template <> struct KindOf<{c}> {{ static constexpr Kind value = Kind::{c}; }};" for c in names
+  ])
+  cases = "\n".join([f"    case Kind::{c}: return f(get<{c}>());" for c in names[:-1]])
+
+  checks = []
+  saves = []
+  loads = []
+  for c, o in subclasses.items():
+    camel_c = to_camel_case(c)
+    conditions = []
+    save_arguments = []
+    load_arguments = []
+    for t, n in o["children"]:
+      enum = o.get("enumDefinition")
+      if t == base_class:
+        # Children come before their parents, which also rules out cycles.
+        conditions.append(f"{camel_c}.{n}().index < index")
+        save_arguments.append(f"{base_class}{{ node.{n}().index }}")
+        load_arguments.append(f"flat::{base_class}{{ first + {camel_c}.{n}().index }}")
+      elif t == "StringRef":
+        conditions.append(f"uint64_t({camel_c}.{n}().offset) + {camel_c}.{n}().length <= stringBytes")
+        save_arguments.append(f"strings.add(node.{n}())")
+        load_arguments.append(f"interner.intern(image.string({camel_c}.{n}()))")
+      else:
+        if enum is not None and t == enum["name"]:
+          conditions.append(f"static_cast<size_t>({camel_c}.{n}()) < {len(enum['values'])}")
+        save_arguments.append(f"node.{n}()")
+        load_arguments.append(f"{camel_c}.{n}()")
+
+    uses_index = any(t == base_class for t, _ in o["children"])
+    uses_strings = any(t == "StringRef" for t, _ in o["children"])
+    parameters = ", ".join([
+      f"const {c} &{camel_c}" if conditions else f"const {c} &",
+      "uint32_t index" if uses_index else "uint32_t",
+      "uint64_t stringBytes" if uses_strings else "uint64_t"
+    ])
+    checks.append(f"""
+inline bool
+isWellFormed({parameters})
+{{
+  return {(chr(10) + "    && ").join(conditions) if conditions else "true"};
+}}
+""")
+
+    saves.append(f"""
+inline void
+save(const flat::{c} &node, StringTable &{"strings" if uses_strings else ""}, void *record)
+{{
+  new (record) Record(std::in_place_type<{c}>, {", ".join(save_arguments)});
+}}
+""")
+
+    load_parameters = ", ".join([
+      f"const {c} &{camel_c}",
+      "const Image &image" if uses_strings else "const Image &",
+      "utils::StringInterner &interner" if uses_strings else "utils::StringInterner &",
+      f"uint32_t first" if uses_index else "uint32_t",
+      "flat::Tree &tree"
+    ])
+    loads.append(f"""
+inline flat::{base_class}
+load({load_parameters})
+{{
+  return tree.add<flat::{c}>({", ".join(load_arguments)});
+}}
+""")
+
+  return f"""
+enum class Kind : uint8_t {{ {", ".join(names)} }};
+
+template <class T> struct KindOf;
+{kind_ofs}
+
+// One node of a saved tree, which can be read as whichever kind of node it is.
+class Record {{
+public:
+  template <class T, class... Args>
+  explicit Record(std::in_place_type_t<T>, Args &&... args)
+    : kind_(KindOf<T>::value)
+  {{
+    new (storage_) T(std::forward<Args>(args)...);
+  }}
+
+  Kind kind() const {{ return kind_; }}
+
+  template <class T>
+  const T &
+  get() const
+  {{
+    ASSERT(kind_ == KindOf<T>::value && "Record holds a different kind of node");
+    return *std::launder(reinterpret_cast<const T *>(storage_));
+  }}
+
+  // Calls `f` with the node, like `std::visit`.
+  template <class F>
+  decltype(auto)
+  visit(F &&f) const
+  {{
+    switch (kind_) {{
+{cases}
+    default: return f(get<{names[-1]}>());
+    }}
+  }}
+
+private:
+  // Zeroed so the padding saved to files doesn't depend on what was in memory before.
+  alignas({storage_alignment}) unsigned char storage_[{storage_size}] = {{ }};
+  Kind kind_;
+
+}};
+
+static_assert(std::is_trivially_copyable_v<Record>, "Records are read straight from saved bytes");
+static_assert(sizeof(Record) <= {record_budget}, "Records have grown");
+
+// Checked when opening a saved tree. `VERSION` is for changes to how trees are saved, and
+// `SCHEMA` changes by itself whenever the nodes do.
+inline constexpr char MAGIC[8] = "LoxAST";
+inline constexpr uint32_t VERSION = 1;
+inline constexpr uint64_t SCHEMA = 0x{schema:016x};
+
+// A saved tree is this header, then a `Record` for each node in the same order as the flat
+// tree it was saved from (so the last one is the root), then the bytes of its strings.
+// Numbers are in the byte order of the machine that saved it, so a tree saved on a machine
+// with the opposite byte order won't open (its version won't match).
+struct Header {{
+  char magic[8];
+  uint32_t version;
+  uint32_t nodeCount;
+  uint64_t schema;
+  uint64_t stringBytes;
+  // `hashBytes` of everything after the header.
+  uint64_t checksum;
+}};
+
+static_assert(sizeof(Header) % alignof(Record) == 0, "Records after the header need to be aligned");
+
+// A saved tree, read where it is in memory: typically a file mapped by a `lexer::SourceBuffer`.
+// Opening it checks the whole thing, so nodes can then be read without any more checks, but
+// nothing is copied, so the saved bytes need to outlive the image.
+class Image {{
+public:
+  // Throws `std::runtime_error` if `bytes` aren't a whole tree saved by this version of the
+  // code, or have been corrupted. They need to be aligned for a `Record`.
+  static Image open(std::string_view bytes);
+
+  const Record &operator[]({base_class} {camel_base_class}) const {{ return records_[{camel_base_class}.index]; }}
+
+  {base_class} root() const {{ return {{ nodeCount_ - 1 }}; }}
+  size_t size() const {{ return nodeCount_; }}
+  std::string_view string(StringRef ref) const {{ return {{ strings_ + ref.offset, ref.length }}; }}
+
+private:
+  Image(const Record *records, uint32_t nodeCount, const char *strings)
+    : records_(records)
+    , nodeCount_(nodeCount)
+    , strings_(strings)
+    {{ }}
+
+  const Record *records_;
+  uint32_t nodeCount_;
+  const char *strings_;
+
+}};
+
+// Gathers the strings of a tree being saved, keeping one copy of each.
+class StringTable {{
+public:
+  StringRef
+  add(utils::Symbol symbol)
+  {{
+    const auto [existing, isNew] = refs_.try_emplace(symbol);
+    if (isNew) {{
+      const auto string = symbol.str();
+      existing->second = {{ static_cast<uint32_t>(bytes_.size()), static_cast<uint32_t>(string.size()) }};
+      bytes_.append(string);
+    }}
+    return existing->second;
+  }}
+
+  const std::string &bytes() const {{ return bytes_; }}
+
+private:
+  std::string bytes_;
+  std::unordered_map<utils::Symbol, StringRef> refs_;
+
+}};
+
+namespace detail {{
+{"".join(checks)}{"".join(saves)}{"".join(loads)}
+}}
+
+inline Image
+Image::open(std::string_view bytes)
+{{
+  if (bytes.size() < sizeof(Header)) {{
+    throw std::runtime_error("Saved tree is too short to have a header");
+  }}
+  Header header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {{
+    throw std::runtime_error("Not a saved tree");
+  }}
+  if (header.version != VERSION || header.schema != SCHEMA) {{
+    throw std::runtime_error("Tree was saved by a different version");
+  }}
+  const auto recordBytes = uint64_t(header.nodeCount) * sizeof(Record);
+  if (header.nodeCount == 0 || header.stringBytes > bytes.size()
+      || bytes.size() != sizeof(Header) + recordBytes + header.stringBytes) {{
+    throw std::runtime_error("Saved tree is the wrong size");
+  }}
+  if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(Record) != 0) {{
+    throw std::runtime_error("Saved tree is not aligned");
+  }}
+  if (hashBytes(bytes.data() + sizeof(Header), bytes.size() - sizeof(Header)) != header.checksum) {{
+    throw std::runtime_error("Saved tree is corrupted");
+  }}
+
+  const auto records = reinterpret_cast<const Record *>(bytes.data() + sizeof(Header));
+  for (uint32_t index = 0; index < header.nodeCount; ++index) {{
+    const auto &record = records[index];
+    const bool isWellFormed = static_cast<size_t>(record.kind()) < {len(names)} && record.visit([&](const auto &node) {{
+      return detail::isWellFormed(node, index, header.stringBytes);
+    }});
+    if (!isWellFormed) {{
+      throw std::runtime_error("Saved tree is malformed");
+    }}
+  }}
+  return Image(records, header.nodeCount, bytes.data() + sizeof(Header) + recordBytes);
+}}
+
+// Saves the whole of `tree` as bytes, ready to be written to a file and opened with `Image::open`.
+inline std::string
+save(const flat::Tree &tree)
+{{
+  ASSERT(tree.size() > 0 && "Can't save an empty tree");
+  std::string bytes(sizeof(Header) + tree.size() * sizeof(Record), '\\0');
+  StringTable strings;
+  for (uint32_t index = 0; index < tree.size(); ++index) {{
+    const auto record = bytes.data() + sizeof(Header) + index * sizeof(Record);
+    std::visit([&](const auto &node) {{ detail::save(node, strings, record); }}, tree[flat::{base_class}{{ index }}]);
+  }}
+  bytes += strings.bytes();
+
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.nodeCount = static_cast<uint32_t>(tree.size());
+  header.schema = SCHEMA;
+  header.stringBytes = strings.bytes().size();
+  header.checksum = hashBytes(bytes.data() + sizeof(Header), bytes.size() - sizeof(Header));
+  std::memcpy(bytes.data(), &header, sizeof(header));
+  return bytes;
+}}
+
+// Adds the nodes of a saved tree to `tree`, for when it needs to be changed, and returns the
+// root. Each string is interned, so this is slower than reading the saved tree in place.
+inline flat::{base_class}
+load(const Image &image, utils::StringInterner &interner, flat::Tree &tree)
+{{
+  const auto first = static_cast<uint32_t>(tree.size());
+  tree.reserve(tree.size() + image.size());
+  for (uint32_t index = 0; index < image.size(); ++index) {{
+    image[{base_class}{{ index }}].visit([&](const auto &node) {{ detail::load(node, image, interner, first, tree); }});
+  }}
+  return tree.root();
+}}
+
+"""
+
 def make_includes_snippet(includes_for_ast):
   # We have a known set of includes based on hard-coded code generation logic,
   # plus includes used by the AST nodes themselves.
-  known_includes = [ "<variant>", "<memory>", "<utility>" ]
+  known_includes = [ "<variant>", "<memory>", "<utility>", "<functional>", "\"utils/Hash.hpp\"" ]
   system_includes, project_includes = [], []
   for include in sorted(set(known_includes + includes_for_ast)):
     if include[0] == "<":
@@ -76,7 +514,11 @@ def make_includes_snippet(includes_for_ast):
     "\n"
   )
 
-def make_visitor_snippet(base_class, subclass_names):
+def make_visitor_snippet(base_class, subclass_names, layout):
+  static_visitors = make_static_visitor_snippet(base_class, subclass_names, layout)
+  if layout == "flat":
+    return make_flat_visitor_snippet(base_class, subclass_names) + static_visitors
+
   camel_base_class = to_camel_case(base_class)
 
   top = f"""
@@ -92,7 +534,8 @@ public:
   for c in subclass_names:
     camel_c = to_camel_case(c)
     operator_methods.append(f"  virtual T visit{c}({c} &{camel_c}) =0;")
-    virtual_methods.append(f"  T operator()(std::unique_ptr<{c}> &{camel_c}) {{ return visit{c}(*{camel_c}); }}")
+    pointer = f"{c} *" if layout == "arena" else f"std::unique_ptr<{c}> &"
+    virtual_methods.append(f"  T operator()({pointer}{camel_c}) {{ return visit{c}(*{camel_c}); }}")
 
   visit_method = f"""
   T
@@ -128,8 +571,9 @@ public:
     # because it's not easy in cpp to pass a const version of a non-const unique ptr -- it doesn't
     # have those semantics (although vector does). It's ok because this visitor will still provide a
     # const-correct interface to its subclasses.
+    pointer = f"const {c} *" if layout == "arena" else f"const std::unique_ptr<{c}> &"
     const_virtual_methods.append(
-      f"  T operator()(const std::unique_ptr<{c}> &{camel_c}) {{ return visit{c}(*{camel_c}); }}"
+      f"  T operator()({pointer}{camel_c}) {{ return visit{c}(*{camel_c}); }}"
     )
 
   const_visit_method = f"""
@@ -158,12 +602,276 @@ public:
     "\n};\n"
   )
 
-  return non_const_visitor + const_visitor
+  return non_const_visitor + const_visitor + static_visitors
+
+def make_static_visitor_snippet(base_class, subclass_names, layout):
+  # The same interface as the visitors above, but with the `visitX` methods looked up on
+  # the derived class at compile time (CRTP) instead of being virtual. That saves a
+  # virtual call per node on top of `std::visit`'s dispatch, and lets the methods be
+  # inlined.
+  camel_base_class = to_camel_case(base_class)
+
+  def make_visitor(name, const):
+    const_prefix = "const " if const else ""
+    operators = []
+    for c in subclass_names:
+      camel_c = to_camel_case(c)
+      if layout == "flat":
+        operators.append(f"  T operator()({const_prefix}{c} &{camel_c}) {{ return derived().visit{c}({camel_c}); }}")
+      else:
+        pointer = f"{const_prefix}{c} *" if layout == "arena" else f"{const_prefix}std::unique_ptr<{c}> &"
+        operators.append(f"  T operator()({pointer}{camel_c}) {{ return derived().visit{c}(*{camel_c}); }}")
+
+    if layout == "flat":
+      visit_methods = f"""
+  T
+  visit({const_prefix}Tree &tree, {base_class} {camel_base_class})
+  {{
+    tree_ = &tree;
+    return visit({camel_base_class});
+  }}
+
+  T
+  visit({base_class} {camel_base_class})
+  {{
+    return std::visit(*this, (*tree_)[{camel_base_class}]);
+  }}
+"""
+      fields = f"  {const_prefix}Tree *tree_ = nullptr;\n"
+    else:
+      visit_methods = f"""
+  T
+  visit({const_prefix}{base_class} &{camel_base_class})
+  {{
+    return std::visit(*this, {camel_base_class});
+  }}
+"""
+      fields = ""
 
-def make_using_decls_snippet(subclasses):
+    return f"""
+// Derive from this as `class V : public {name}<V, T>`, and give `V` a `visitX` method for
+// each node. If `V` derives privately or the methods are private, it needs to be friends
+// with `{name}<V, T>`.
+template <class Derived, class T>
+class {name} {{
+public:
+{chr(10).join(operators)}
+{visit_methods}
+private:
+  Derived &derived() {{ return static_cast<Derived &>(*this); }}
+{fields}
+}};
+"""
+
+  return make_visitor("StaticVisitor", False) + make_visitor("StaticConstVisitor", True)
+
+def make_traversal_snippet(base_class, subclasses, layout):
+  # Like the static const visitor, but walks the tree with a stack of its own rather than by
+  # recursing, so it copes with trees of any depth. Each entry on the stack is a node with
+  # children, and how many of them have been started (its phase). Starting a node goes
+  # straight on down into its first child, and leaves are visited as soon as they're reached,
+  # so only nodes waiting for their later children (or to be left) are on the stack.
+  # Leaves get a single `visitX` call, like the visitors. Nodes with children get `enterX`
+  # before them, `betweenX` between each pair of them, and `leaveX` after them.
+  camel_base_class = to_camel_case(base_class)
+  flat = layout == "flat"
+
+  defaults = []
+  starts = []
+  leaf_starts = []
+  resumes = []
+  cases = []
+  for kind, (c, o) in enumerate(subclasses):
+    camel_c = to_camel_case(c)
+    children = [n for t, n in o["children"] if t == base_class]
+    if not children:
+      defaults.append(f"  void visit{c}(const {c} &) {{ }}")
+      leaf_starts.append(
+        f"  const {base_class} *start(const {c} &{camel_c}) {{ derived().visit{c}({camel_c}); return nullptr; }}\n"
+      )
+      continue
+
+    defaults.append(f"  void enter{c}(const {c} &) {{ }}")
+    if len(children) > 1:
+      defaults.append(f"  void between{c}(const {c} &) {{ }}")
+    defaults.append(f"  void leave{c}(const {c} &) {{ }}")
+    starts.append(f"""
+  const {base_class} *
+  start(const {c} &{camel_c})
+  {{
+    derived().enter{c}({camel_c});
+    stack_.push_back({{ &{camel_c}, {kind}, 1 }});
+    return &{camel_c}.{children[0]}();
+  }}
+""")
+    cases.append(f"      case {kind}: resume(*static_cast<const {c} *>(entry.node), entry.phase); break;")
+    later_children = "".join([
+      f"""    case {phase}:
+      ++stack_.back().phase;
+      derived().between{c}({camel_c});
+      return descend(&{camel_c}.{child}());
+"""
+      for phase, child in enumerate(children) if phase > 0
+    ])
+    if later_children:
+      resumes.append(f"""
+  void
+  resume(const {c} &{camel_c}, uint32_t phase)
+  {{
+    switch (phase) {{
+{later_children}    default:
+      stack_.pop_back();
+      derived().leave{c}({camel_c});
+    }}
+  }}
+""")
+    else:
+      resumes.append(f"""
+  void
+  resume(const {c} &{camel_c}, uint32_t)
+  {{
+    stack_.pop_back();
+    derived().leave{c}({camel_c});
+  }}
+""")
+
+  lookup = "(*tree_)[*expr]" if flat else "*expr"
+  unwrap = "node" if flat else "*node"
+  if flat:
+    traverse = f"""
+  void
+  traverse(const Tree &tree, {base_class} {camel_base_class})
+  {{
+    tree_ = &tree;
+    run(&{camel_base_class});
+  }}
+"""
+    tree_field = "  const Tree *tree_ = nullptr;\n"
+  else:
+    traverse = f"""
+  void
+  traverse(const {base_class} &{camel_base_class})
+  {{
+    run(&{camel_base_class});
+  }}
+"""
+    tree_field = ""
+
+  return f"""
+// Derive from this as `class T : public ConstTraversal<T>`, and give `T` the callbacks it
+// needs (the rest do nothing): `visitX` for each leaf node, and `enterX`, `betweenX` (between
+// children) and `leaveX` for each node with children. Like the static visitors, `T` needs to be
+// friends with `ConstTraversal<T>` if it derives privately or the callbacks are private.
+// The stack is kept between traversals, so reusing a traversal doesn't reallocate it.
+template <class Derived>
+class ConstTraversal {{
+public:{traverse}
+{chr(10).join(defaults)}
+
+private:
+  struct Entry {{
+    const void *node;
+    // Which of the `{base_class}` alternatives the node is.
+    uint32_t kind;
+    // How many of its children have been started.
+    uint32_t phase;
+  }};
+
+  std::vector<Entry> stack_;
+{tree_field}
+  Derived &derived() {{ return static_cast<Derived &>(*this); }}
+
+  void
+  run(const {base_class} *{camel_base_class})
+  {{
+    // Left over if a callback threw partway through the last traversal.
+    stack_.clear();
+    descend({camel_base_class});
+    while (!stack_.empty()) {{
+      const auto entry = stack_.back();
+      switch (entry.kind) {{
+{chr(10).join(cases)}
+      }}
+    }}
+  }}
+
+  // Starts nodes down to the first leaf, leaving the ones with more children on the stack.
+  void
+  descend(const {base_class} *{camel_base_class})
+  {{
+    while ({camel_base_class}) {{
+      {camel_base_class} = std::visit([this](const auto &node) {{ return start({unwrap}); }}, {lookup.replace("expr", camel_base_class)});
+    }}
+  }}
+{"".join(starts)}
+{"".join(leaf_starts)}{"".join(resumes)}
+}};
+"""
+
+def make_flat_visitor_snippet(base_class, subclass_names):
+  # Children are only indices, so the visitors need to know which tree to look them up in.
+  # `visit(tree, expr)` remembers the tree, so that visiting children with `visit(expr)` works
+  # the same as for the other layouts.
+  def make_visitor(name, const):
+    const_prefix = "const " if const else ""
+    visit_methods = "\n".join([f"  virtual T visit{c}({const_prefix}{c} &{to_camel_case(c)}) =0;" for c in subclass_names])
+    operators = "\n".join([
+      f"  T operator()({const_prefix}{c} &{to_camel_case(c)}) {{ return visit{c}({to_camel_case(c)}); }}"
+      for c in subclass_names
+    ])
+    return f"""
+template <class T>
+class {name} {{
+public:
+  virtual ~{name}() =default;
+
+{visit_methods}
+
+{operators}
+
+  T
+  visit({const_prefix}Tree &tree, {base_class} {to_camel_case(base_class)})
+  {{
+    tree_ = &tree;
+    return visit({to_camel_case(base_class)});
+  }}
+
+  T
+  visit({base_class} {to_camel_case(base_class)})
+  {{
+    return std::visit(*this, (*tree_)[{to_camel_case(base_class)}]);
+  }}
+
+private:
+  {const_prefix}Tree *tree_ = nullptr;
+
+}};
+"""
+
+  return make_visitor("Visitor", False) + make_visitor("ConstVisitor", True)
+
+def make_using_decls_snippet(subclasses, layout):
+  if layout == "flat":
+    # Nodes are all referred to by their index in the tree.
+    return ""
+  if layout == "arena":
+    # The arena owns the nodes, so the tree only needs to point at them.
+    return "\n" + "\n".join([f"using {name}Ptr = {name} *;" for name in subclasses]) + "\n"
   return "\n" + "\n".join([f"using {name}Ptr = std::unique_ptr<{name}>;" for name in subclasses]) + "\n"
 
-def make_variant_snippet(base_class, subclasses):
+def make_variant_snippet(base_class, subclasses, layout):
+  if layout in ("flat", "binary"):
+    table = "`Tree`" if layout == "flat" else "saved tree"
+    return f"""
+// A node in a {table}, as its index in the tree's table of nodes.
+struct {base_class} {{
+  uint32_t index;
+
+  bool operator==({base_class} other) const {{ return index == other.index; }}
+  bool operator!=({base_class} other) const {{ return index != other.index; }}
+}};
+"""
+
   top =  f"""
 using {base_class} = std::variant<
 """
@@ -176,7 +884,53 @@ def make_forward_decls_snippet(subclass_names):
 """
   return comment_about_decls + "\n".join(map(lambda s: f"class {s};", subclass_names)) + "\n"
 
-def make_subclasses_snippet(subclasses):
+def make_tree_snippet(base_class, subclass_names, node_budget):
+  alternatives = ",\n".join([f"  {c}" for c in subclass_names])
+  camel_base_class = to_camel_case(base_class)
+  return f"""
+using Node = std::variant<
+{alternatives}
+>;
+
+// The biggest node plus the variant's index, rounded up to the alignment.
+static_assert(sizeof(Node) <= {node_budget}, "Flat tree nodes have grown");
+
+// Owns the nodes of a tree in one table, in the order they were made. Children have
+// to be made before their parents (so the nodes are in post-order), which means the
+// last node made is the root.
+class Tree {{
+public:
+  template <class T, class... Args>
+  {base_class}
+  add(Args &&... args)
+  {{
+    nodes_.emplace_back(std::in_place_type<T>, std::forward<Args>(args)...);
+    return {{ static_cast<uint32_t>(nodes_.size() - 1) }};
+  }}
+
+  {base_class}
+  add(Node &&node)
+  {{
+    nodes_.push_back(std::move(node));
+    return {{ static_cast<uint32_t>(nodes_.size() - 1) }};
+  }}
+
+  Node &operator[]({base_class} {camel_base_class}) {{ return nodes_[{camel_base_class}.index]; }}
+  const Node &operator[]({base_class} {camel_base_class}) const {{ return nodes_[{camel_base_class}.index]; }}
+
+  {base_class} root() const {{ return {{ static_cast<uint32_t>(nodes_.size() - 1) }}; }}
+  size_t size() const {{ return nodes_.size(); }}
+  void reserve(size_t nodeCount) {{ nodes_.reserve(nodeCount); }}
+  // Bytes of memory allocated to hold the nodes.
+  size_t memoryUsage() const {{ return nodes_.capacity() * sizeof(Node); }}
+
+private:
+  std::vector<Node> nodes_;
+
+}};
+"""
+
+def make_subclasses_snippet(base_class, subclasses, layout):
   # Accessors are added because they might be useful later for changing the internal representation
   # without breaking clients too badly.
   def make_accessor(child):
@@ -191,25 +945,40 @@ def make_subclasses_snippet(subclasses):
   def make_const_accessor(child):
       return f"  const {child[0]} &{child[1]}() const {{ return {child[1]}_; }}"
 
-  def make_constructor(name, arguments):
+  # Arguments stay in the order they're declared in, but the fields (and so their
+  # initializers) are in storage order.
+  def make_constructor(name, arguments, fields):
     argument_list = ",\n    ".join(map(lambda a: f"{a[0]} {a[1]}", arguments))
-    initializers = ",\n    ".join(map(lambda a: f"{a[1]}_(std::move({a[1]}))", arguments))
+    initializers = ",\n    ".join(map(lambda a: f"{a[1]}_(std::move({a[1]}))", fields))
     return f"  {name}(\n    {argument_list}\n  ): {initializers} {{ }}"
 
-  def make_enum(definition):
+  def make_enum(class_type, definition):
     if definition is None:
       return ""
 
     name = definition["name"]
+    if layout != "default":
+      # Share the enums with the default tree, so code that maps onto them works with either tree.
+      return f"  using {name} = ::ast::{class_type}::{name};\n"
     values = ", ".join(definition["values"])
-    return f"  enum class {name} {{ {values} }};\n"
+    assert len(definition["values"]) <= 256, f"Too many values for enum {name} to fit in a byte"
+    return f"  enum class {name} : uint8_t {{ {values} }};\n"
+
+  def make_destructor(name, children):
+    # Only the unique_ptr tree owns its children (see `make_destructors_snippet`).
+    if layout != "default" or not any(t == base_class for t, _ in children):
+      return ""
+    return f"\n  ~{name}();"
 
   snippets = []
 
   for c, o in subclasses:
-    enum_definition =  make_enum(o.get("enumDefinition")) # use `get` because definition may not exist
-    constructor = make_constructor(c, o["children"])
-    fields = "\n".join(map(lambda c: f"  {c[0]} {c[1]}_;", o["children"]))
+    enum_definition =  make_enum(c, o.get("enumDefinition")) # use `get` because definition may not exist
+    # Sorting is stable, so fields with the same alignment stay in declaration order.
+    stored = storage_order(base_class, o, layout)
+    constructor = make_constructor(c, o["children"], stored) + make_destructor(c, o["children"])
+    fields = "\n".join(map(lambda c: f"  {c[0]} {c[1]}_;", stored))
+    budget = packed_size([field_layout(base_class, o, t, layout) for t, _ in stored])
     accessors = "\n".join(map(make_accessor, o["children"]))
     const_accessors = "\n".join(map(make_const_accessor, o["children"]))
 
@@ -226,17 +995,98 @@ public:
 private:
 {fields}
 }};
+
+static_assert(sizeof({c}) <= {budget}, "{c} is bigger than its fields packed together");
 """)
 
   return "\n" + "\n".join(snippets)
 
-def make_factory_funs_snippet(subclasses, auto_provided_defs):
+def make_destructors_snippet(base_class, subclasses):
+  # Left to themselves, the unique_ptrs would destroy a tree recursively, one stack frame
+  # (or several) per level, which overflows the stack on deep enough trees. Instead, a
+  # node with anything below its children moves its children onto a worklist, and then
+  # takes each node on the worklist apart in turn. Everything on the worklist has been
+  # emptied of children by the time it's destroyed, so no destructor goes more than one
+  # level deep.
+  with_children = [(c, [n for t, n in o["children"] if t == base_class]) for c, o in subclasses]
+  camel_base_class = to_camel_case(base_class)
+
+  take_children = []
+  has_children = []
+  destructors = []
+  for c, children in with_children:
+    if not children:
+      take_children.append(f"inline void takeChildren({c} &, std::vector<{base_class}> &) {{ }}")
+      has_children.append(f"inline bool hasChildren(const {c}Ptr &) {{ return false; }}")
+      continue
+
+    pushes = "\n".join([f"  worklist.push_back(std::move(node.{n}()));" for n in children])
+    take_children.append(f"""inline void
+takeChildren({c} &node, std::vector<{base_class}> &worklist)
+{{
+{pushes}
+}}""")
+    has_children.append(f"inline bool hasChildren(const {c}Ptr &node) {{ return node != nullptr; }}")
+
+    any_grandchildren = " || ".join([f"detail::hasChildren({n}_)" for n in children])
+    destructors.append(f"""
+inline
+{c}::~{c}()
+{{
+  // Not worth a worklist if the children can't recurse any further anyway.
+  if (!({any_grandchildren})) {{
+    return;
+  }}
+  std::vector<{base_class}> worklist;
+  detail::takeChildren(*this, worklist);
+  detail::destroyAll(worklist);
+}}
+""")
+
+  return f"""
+namespace detail {{
+
+// Moves a node's children onto `worklist`, so destroying the node won't destroy them.
+{chr(10).join(take_children)}
+
+// Whether destroying the node would destroy any nodes under it.
+{chr(10).join(has_children)}
+
+inline bool
+hasChildren(const {base_class} &{camel_base_class})
+{{
+  return std::visit([](const auto &node) {{ return hasChildren(node); }}, {camel_base_class});
+}}
+
+// Destroys the trees on `worklist` one node at a time, pushing each node's children
+// onto `worklist` before it goes.
+inline void
+destroyAll(std::vector<{base_class}> &worklist)
+{{
+  while (!worklist.empty()) {{
+    auto {camel_base_class} = std::move(worklist.back());
+    worklist.pop_back();
+    std::visit([&worklist](auto &node) {{
+      if (node) {{
+        takeChildren(*node, worklist);
+      }}
+    }}, {camel_base_class});
+  }}
+}}
+
+}}
+{"".join(destructors)}"""
+
+def make_factory_funs_snippet(base_class, subclasses, auto_provided_defs, layout):
   # - If a child is in the list of auto-provided children, use a lookup to find
   #   out how to populate that child, instead of expecting it as an argument.
   # - Returns a unique_ptr to the created AST node, which will implicitly convert
   #   to the base class variant type if passed to another factory function.
   # - If a subclass has an enum definition, create one function per enum value,
   #   which sets the enum to the appropriate value.
+  # - For the arena tree, the functions take the arena to create the node in first,
+  #   and return a pointer to it instead.
+  # - For the flat tree, they take the tree to add the node to, and return its index.
 
   def make_snippet(class_type, name, children, enum_name_and_value):
     arguments = ",\n".join([
@@ -262,6 +1112,32 @@ def make_factory_funs_snippet(subclasses, auto_provided_defs):
         forwards.append(f"    std::move({n})")
     forwards = ",\n".join(forwards)
 
+    if layout == "flat":
+      tree_argument = "  Tree &tree" + (",\n" if arguments else "")
+      return f"""
+{base_class}
+inline {name}(
+{tree_argument}{arguments}
+) {{
+  return tree.add<{class_type}>(
+{forwards}
+  );
+}}
+"""
+
+    if layout == "arena":
+      arena_argument = "  Arena &arena" + (",\n" if arguments else "")
+      return f"""
+{class_type}Ptr
+inline {name}(
+{arena_argument}{arguments}
+) {{
+  return arena.create<{class_type}>(
+{forwards}
+  );
+}}
+"""
+
     return f"""
 {class_type}Ptr
 inline {name}(
@@ -297,6 +1173,344 @@ inline {name}(
 
   return "\n".join(defs)
 
+def make_factory_class_snippet(base_class, subclasses, auto_provided_defs, factory_state, factory_provided_defs, layout):
+  # One method per subclass, taking every child that isn't auto-provided (including enums).
+  # Unlike the factory functions, which node gets made doesn't have to be known at compile
+  # time, and code written against a factory (e.g. the parser) can build either tree.
+  # The factory can also hold a reference to some state (`factoryState`, e.g. where ids come
+  # from), which `factoryProvidedDefs` use instead of the free functions' auto-provided defs.
+  def provide(n):
+    return factory_provided_defs[n] if n in factory_provided_defs else auto_provided_defs[n].strip()
+
+  methods = []
+  for c, o in subclasses:
+    enum = o.get("enumDefinition")
+    # Enums are declared inside their subclass, so need qualifying out here.
+    def qualify(t):
+      return f"{c}::{t}" if enum is not None and t == enum["name"] else t
+    arguments = ", ".join([f"{qualify(t)} &&{n}" for t, n in o["children"] if n not in auto_provided_defs])
+    forwards = ",\n      ".join([
+      provide(n) if n in auto_provided_defs else f"std::move({n})" for _, n in o["children"]
+    ])
+    create = {
+      "default": f"std::make_unique<{c}>", "arena": f"arena_.create<{c}>", "flat": f"tree_.add<{c}>"
+    }[layout]
+    return_type = base_class if layout == "flat" else f"{c}Ptr"
+    methods.append(f"""
+  {return_type}
+  {to_camel_case(c)}({arguments})
+  {{
+    return {create}(
+      {forwards}
+    );
+  }}
+""")
+
+  # (type, name) of everything the factory refers to.
+  state = { "default": [], "arena": [("Arena", "arena")], "flat": [("Tree", "tree")] }[layout]
+  if factory_state is not None:
+    state.append(tuple(factory_state.split(" ")))
+
+  if state:
+    parameters = ", ".join([f"{t} &{n}" for t, n in state])
+    initializers = "\n    , ".join([f"{n}_({n})" for _, n in state])
+    constructor = f"""
+  {"explicit " if len(state) == 1 else ""}Factory({parameters})
+    : {initializers}
+    {{ }}
+"""
+    fields = "\nprivate:\n" + "".join([f"  {t} &{n}_;\n" for t, n in state])
+  else:
+    constructor = ""
+    fields = ""
+
+  return f"""
+class Factory {{
+public:
+  using {base_class} = ::ast::{"" if layout == "default" else layout + "::"}{base_class};
+{constructor}{"".join(methods)}{fields}
+}};
+"""
+
+def hash_field(class_type, subclass, child_type, value):
+  # Doubles are hashed by their bits, to agree with `equal_fields`.
+  if child_type == "double":
+    return f"std::hash<uint64_t>()(bitPattern({value}))"
+  return f"std::hash<{qualify_enum(class_type, subclass, child_type)}>()({value})"
+
+def equal_fields(child_type, lhs, rhs):
+  # With `==`, a NaN would never match itself, and 0.0 would match -0.0, so doubles are
+  # compared by their bits instead.
+  if child_type == "double":
+    return f"bitPattern({lhs}) == bitPattern({rhs})"
+  return f"{lhs} == {rhs}"
+
+def make_structural_snippet(base_class, subclasses, auto_provided_defs, layout):
+  # Hashing and equality that look at what the trees contain rather than where the nodes
+  # are, so two trees parsed from the same source are equal. Fields that are provided
+  # automatically (ids) aren't part of the structure, so they're left out.
+  # Like the traversals, these walk the tree with a stack of their own rather than by
+  # recursing, so they cope with trees of any depth.
+  camel_base_class = to_camel_case(base_class)
+  flat = layout == "flat"
+  # The flat tree's children are indices, so they go on the stack as they are.
+  stack_entry = base_class if flat else f"const {base_class} *"
+  address = "" if flat else "&"
+
+  hashes = []
+  equals = []
+  pushes = []
+  for kind, (c, o) in enumerate(subclasses):
+    camel_c = to_camel_case(c)
+    children = [(t, n) for t, n in o["children"] if n not in auto_provided_defs]
+    fields = [(t, n) for t, n in children if t != base_class]
+    subtrees = [n for t, n in children if t == base_class]
+
+    if fields:
+      hash_lines = "".join([
+        f"\n  seed = hashCombine(seed, {hash_field(c, o, t, f'{camel_c}.{n}()')});" for t, n in fields
+      ])
+      hashes.append(f"""
+inline size_t
+structuralHashOf(const {c} &{camel_c})
+{{
+  size_t seed = {kind};{hash_lines}
+  return seed;
+}}
+""")
+      comparisons = "\n    && ".join([equal_fields(t, f"lhs.{n}()", f"rhs.{n}()") for t, n in fields])
+      equals.append(f"""
+inline bool
+sameFields(const {c} &lhs, const {c} &rhs)
+{{
+  return {comparisons};
+}}
+""")
+    else:
+      # Only the kind of node to go on.
+      hashes.append(f"\ninline size_t structuralHashOf(const {c} &) {{ return {kind}; }}\n")
+      equals.append(f"\ninline bool sameFields(const {c} &, const {c} &) {{ return true; }}\n")
+
+    if subtrees:
+      # Last child first, so the first comes off the stack first.
+      push_lines = "\n".join([f"  stack.push_back({address}{camel_c}.{n}());" for n in reversed(subtrees)])
+      pushes.append(f"""
+inline void
+pushChildren(const {c} &{camel_c}, std::vector<{stack_entry}> &stack)
+{{
+{push_lines}
+}}
+""")
+    else:
+      pushes.append(f"\ninline void pushChildren(const {c} &, std::vector<{stack_entry}> &) {{ }}\n")
+
+  if flat:
+    hash_parameters = f"const Tree &tree, {base_class} {camel_base_class}"
+    equal_parameters = f"const Tree &lhsTree, {base_class} lhs, const Tree &rhsTree, {base_class} rhs"
+    hash_root, lhs_root, rhs_root = camel_base_class, "lhs", "rhs"
+    hash_lookup = "tree[next]"
+    lhs_lookup, rhs_lookup = "lhsTree[lhsNext]", "rhsTree[rhsNext]"
+    take_next = f"const {base_class} next"
+    take_lhs, take_rhs = f"const {base_class} lhsNext", f"const {base_class} rhsNext"
+    unwrap = "node"
+    get_other = "std::get<std::decay_t<decltype(node)>>(rhsNode)"
+  else:
+    hash_parameters = f"const {base_class} &{camel_base_class}"
+    equal_parameters = f"const {base_class} &lhs, const {base_class} &rhs"
+    hash_root, lhs_root, rhs_root = f"&{camel_base_class}", "&lhs", "&rhs"
+    hash_lookup = "*next"
+    lhs_lookup, rhs_lookup = "*lhsNext", "*rhsNext"
+    take_next = f"const {base_class} *next"
+    take_lhs, take_rhs = f"const {base_class} *lhsNext", f"const {base_class} *rhsNext"
+    unwrap = "*node"
+    get_other = "*std::get<std::decay_t<decltype(node)>>(rhsNode)"
+
+  return f"""
+namespace detail {{
+
+// What a node adds to its tree's structural hash besides its children: its kind, and its
+// other fields.
+{"".join(hashes).lstrip()}
+// Whether two nodes of the same kind have the same fields, leaving aside their children.
+{"".join(equals).lstrip()}
+// Pushes a node's children onto `stack`, to be walked after it.
+{"".join(pushes).lstrip()}
+}}
+
+// Equal trees have equal hashes, and trees are equal if they have the same kinds of node
+// in the same places, with the same values in them. Ids don't count.
+inline size_t
+structuralHash({hash_parameters})
+{{
+  // The nodes come off the stack in preorder, and each kind of node always has the same
+  // number of children, so the order the nodes are hashed in is enough to tell shapes apart.
+  size_t seed = 0;
+  std::vector<{stack_entry}> stack{{ {hash_root} }};
+  while (!stack.empty()) {{
+    {take_next} = stack.back();
+    stack.pop_back();
+    std::visit([&](const auto &node) {{
+      seed = hashCombine(seed, detail::structuralHashOf({unwrap}));
+      detail::pushChildren({unwrap}, stack);
+    }}, {hash_lookup});
+  }}
+  return seed;
+}}
+
+inline bool
+structurallyEqual({equal_parameters})
+{{
+  // Children are only pushed once their parents are known to be the same kind, so the two
+  // stacks always hold the same number of nodes.
+  std::vector<{stack_entry}> lhsStack{{ {lhs_root} }};
+  std::vector<{stack_entry}> rhsStack{{ {rhs_root} }};
+  while (!lhsStack.empty()) {{
+    {take_lhs} = lhsStack.back();
+    {take_rhs} = rhsStack.back();
+    lhsStack.pop_back();
+    rhsStack.pop_back();
+    const auto &lhsNode = {lhs_lookup};
+    const auto &rhsNode = {rhs_lookup};
+    if (lhsNode.index() != rhsNode.index()) {{
+      return false;
+    }}
+    const bool same = std::visit([&](const auto &node) {{
+      const auto &other = {get_other};
+      if (!detail::sameFields({unwrap}, other)) {{
+        return false;
+      }}
+      detail::pushChildren({unwrap}, lhsStack);
+      detail::pushChildren(other, rhsStack);
+      return true;
+    }}, lhsNode);
+    if (!same) {{
+      return false;
+    }}
+  }}
+  return true;
+}}
+"""
+
+def make_sharing_factory_snippet(base_class, subclasses, auto_provided_defs, factory_state, factory_provided_defs):
+  # The same interface as `Factory`, but a node that's the same as one the factory has already
+  # made isn't added again: the existing one is returned instead, and ends up with more than
+  # one parent. Nodes are made children first, so by the time a node is made its children have
+  # already been shared, and comparing the children's indices is as good as comparing them
+  # structurally. Each node only has to be hashed on its own, without going down the tree.
+  def provide(n):
+    return factory_provided_defs[n] if n in factory_provided_defs else auto_provided_defs[n].strip()
+
+  hashes = []
+  equals = []
+  methods = []
+  for c, o in subclasses:
+    camel_c = to_camel_case(c)
+    children = [(t, n) for t, n in o["children"] if n not in auto_provided_defs]
+    hash_lines = "".join([
+      f"\n    seed = hashCombine(seed, {'node.' + n + '().index' if t == base_class else hash_field(c, o, t, f'node.{n}()')});"
+      for t, n in children
+    ])
+    if children:
+      hashes.append(f"""
+  size_t
+  operator()(const {c} &node) const
+  {{
+    size_t seed = 0;{hash_lines}
+    return seed;
+  }}
+""")
+      comparisons = "\n      && ".join([equal_fields(t, f"lhs.{n}()", f"rhs.{n}()") for t, n in children])
+      equals.append(f"""
+  bool
+  operator()(const {c} &lhs, const {c} &rhs) const
+  {{
+    return {comparisons};
+  }}
+""")
+    else:
+      # Nothing to tell nodes of the same kind apart.
+      hashes.append(f"\n  size_t operator()(const {c} &) const {{ return 0; }}\n")
+      equals.append(f"\n  bool operator()(const {c} &, const {c} &) const {{ return true; }}\n")
+
+    arguments = ", ".join([f"{qualify_enum(c, o, t)} &&{n}" for t, n in children])
+    # Automatically provided fields are filled in once the node is known to be new.
+    forwards = ", ".join(["{}" if n in auto_provided_defs else f"std::move({n})" for _, n in o["children"]])
+    methods.append(f"""
+  {base_class}
+  {camel_c}({arguments})
+  {{
+    return share({c}({forwards}));
+  }}
+""")
+
+  fill = "\n".join([f"          node.{n}() = {provide(n)};" for n in auto_provided_defs])
+  state = [("Tree", "tree")] + ([tuple(factory_state.split(" "))] if factory_state is not None else [])
+  parameters = ", ".join([f"{t} &{n}" for t, n in state])
+  initializers = "\n    , ".join([f"{n}_({n})" for _, n in state])
+  fields = "".join([f"  {t} &{n}_;\n" for t, n in state])
+
+  return f"""
+// Hashes and compares nodes by their own fields and their children's indices, but not by
+// automatically provided fields (ids). See `SharingFactory`.
+struct ShallowHash {{
+  size_t
+  operator()(const Node &node) const
+  {{
+    return hashCombine(node.index(), std::visit(*this, node));
+  }}
+{"".join(hashes)}
+}};
+
+struct ShallowEqual {{
+  bool
+  operator()(const Node &lhs, const Node &rhs) const
+  {{
+    if (lhs.index() != rhs.index()) {{
+      return false;
+    }}
+    return std::visit([&](const auto &node) {{
+      return (*this)(node, std::get<std::decay_t<decltype(node)>>(rhs));
+    }}, lhs);
+  }}
+
+{"".join(equals)}
+}};
+
+// Like `Factory`, but shares identical subtrees (hash-consing), which turns the tree into a
+// DAG. Only nodes made by the same factory are shared.
+class SharingFactory {{
+public:
+  using {base_class} = ::ast::flat::{base_class};
+
+  SharingFactory({parameters})
+    : {initializers}
+    {{ }}
+{"".join(methods)}
+private:
+{fields}  std::unordered_map<Node, {base_class}, ShallowHash, ShallowEqual> shared_;
+
+  {base_class}
+  share(Node &&candidate)
+  {{
+    const auto [existing, isNew] = shared_.try_emplace(std::move(candidate), {base_class}{{ static_cast<uint32_t>(tree_.size()) }});
+    if (isNew) {{
+      Node node = existing->first;
+      std::visit([this](auto &node) {{
+{fill}
+        }}, node);
+      tree_.add(std::move(node));
+    }}
+    return existing->second;
+  }}
+
+}};
+"""
+
+def qualify_enum(class_type, subclass, child_type):
+  # Enums are declared inside their subclass, so need qualifying outside of it.
+  enum = subclass.get("enumDefinition")
+  return f"{class_type}::{child_type}" if enum is not None and child_type == enum["name"] else child_type
+
 def to_camel_case(pascal_case_word):
   if len(pascal_case_word) > 0 and pascal_case_word[0].isupper():
     return pascal_case_word[0].lower() + pascal_case_word[1:]
@@ -304,17 +1518,22 @@ def to_camel_case(pascal_case_word):
     return pascal_case_word
 
 def main():
-  if len(argv) != 3:
-    raise Exception(f"Usage: {argv[0]} <ast-file> <output-dir>")
+  args = argv[1:]
+  layout = "default"
+  if len(args) > 0 and args[0].startswith("--"):
+    layout = args[0][2:]
+    args = args[1:]
+  if layout not in LAYOUTS or len(args) != 2:
+    raise Exception(f"Usage: {argv[0]} [--arena|--flat|--binary] <ast-file> <output-dir>")
 
-  ast_file = argv[1]
-  output_dir = argv[2]
+  ast_file = args[0]
+  output_dir = args[1]
 
   with open(ast_file) as f:
     classes = json.loads("".join(f.readlines()))
 
   resolve(classes)
-  emit(classes, output_dir)
+  emit(classes, output_dir, layout)
 
 if __name__ == "__main__":
   main()
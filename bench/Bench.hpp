@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <iomanip>
+#include <utility>
+
+// A very small benchmarking harness. Benchmarks register themselves with
+// `BENCHMARK(name)` and call `measure` for each variant they want to compare;
+// `bench/main.cpp` runs them all (or those whose name contains the first
+// command line argument).
+// Build with optimisations on (e.g. RelWithDebInfo) or the numbers are meaningless.
+
+namespace bench {
+
+using BenchmarkFunction = void (*)();
+
+inline std::vector<std::pair<std::string, BenchmarkFunction>> &
+registry()
+{
+  static std::vector<std::pair<std::string, BenchmarkFunction>> benchmarks;
+  return benchmarks;
+}
+
+inline bool
+registerBenchmark(std::string name, BenchmarkFunction function)
+{
+  registry().emplace_back(std::move(name), function);
+  return true;
+}
+
+// Stops the compiler from optimising away a result that is never used.
+template <class T>
+inline void
+doNotOptimize(const T &value)
+{
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Runs `function` repeatedly for roughly a fifth of a second and prints the
+// average time per run. If `itemsPerRun` is given, also prints how many items
+// (bytes, tokens, nodes, ...) were processed per second.
+template <class F>
+void
+measure(const std::string &label, F &&function, size_t itemsPerRun = 0)
+{
+  using Clock = std::chrono::steady_clock;
+  constexpr auto minimumDuration = std::chrono::milliseconds(200);
+
+  function(); // warm up
+
+  size_t runs = 0;
+  const auto start = Clock::now();
+  auto elapsed = Clock::duration::zero();
+  do {
+    function();
+    ++runs;
+    elapsed = Clock::now() - start;
+  } while (elapsed < minimumDuration);
+
+  const double nanosPerRun = std::chrono::duration<double, std::nano>(elapsed).count() / runs;
+  std::cout << "  " << std::left << std::setw(48) << label
+            << std::right << std::fixed << std::setprecision(1) << std::setw(14) << nanosPerRun << " ns/run";
+  if (itemsPerRun > 0) {
+    std::cout << std::setw(12) << (itemsPerRun * 1e3 / nanosPerRun) << " M items/s";
+  }
+  std::cout << std::endl;
+}
+
+// Prints a number that isn't a timing (e.g. memory use) in line with `measure`'s output.
+inline void
+report(const std::string &label, double value, const std::string &unit)
+{
+  std::cout << "  " << std::left << std::setw(48) << label
+            << std::right << std::fixed << std::setprecision(1) << std::setw(14) << value << " " << unit
+            << std::endl;
+}
+
+}
+
+#define BENCHMARK(name) \
+  static void name(); \
+  static const bool name##Registered = bench::registerBenchmark(#name, name); \
+  static void name()
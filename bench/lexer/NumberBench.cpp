@@ -0,0 +1,74 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <system_error>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "parser/Parser.h"
+#include "utils/Number.hpp"
+
+namespace {
+
+// Whole numbers and decimals of various lengths, like a table of constants.
+std::vector<std::string>
+makeNumbers()
+{
+  const std::vector<std::string> pool {
+    "0", "1", "42", "3.14159", "2.5", "1000000", "0.001", "65536", "12.75", "299792458",
+    "6.02214076", "9", "128", "0.5", "1.0000001"
+  };
+
+  std::vector<std::string> numbers;
+  for (size_t i = 0; i < 10000; ++i) {
+    numbers.push_back(pool[(i * 7919) % pool.size()]);
+  }
+  return numbers;
+}
+
+}
+
+BENCHMARK(NumberConversion)
+{
+  const auto numbers = makeNumbers();
+
+  // What the parser used to do: copy the text out of the token and call `std::stod`.
+  bench::measure("std::stod(std::string)", [&] {
+    double sum = 0;
+    for (const auto &number : numbers) {
+      sum += std::stod(std::string(std::string_view(number)));
+    }
+    bench::doNotOptimize(sum);
+  }, numbers.size());
+
+  bench::measure("parseNumber", [&] {
+    double sum = 0;
+    std::errc error;
+    for (const auto &number : numbers) {
+      sum += *parseNumber(number, error);
+    }
+    bench::doNotOptimize(sum);
+  }, numbers.size());
+}
+
+BENCHMARK(LexNumberHeavy)
+{
+  // A long sum, so that the whole thing can be parsed as well.
+  std::string source;
+  for (const auto &number : makeNumbers()) {
+    if (!source.empty()) {
+      source += " + ";
+    }
+    source += number;
+  }
+
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  bench::measure("Lexer::lex", [&] { bench::doNotOptimize(lexer.lex(source)); }, source.size());
+
+  const auto tokens = lexer.lex(source);
+  bench::measure("Parser::parse", [&] {
+    parser::Parser parser(strings);
+    bench::doNotOptimize(parser.parse(tokens));
+  }, tokens.size());
+}
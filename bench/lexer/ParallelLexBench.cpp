@@ -0,0 +1,45 @@
+#include <string>
+#include <thread>
+#include <algorithm>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+
+namespace {
+
+// Roughly what our generated scripts look like: short statements with the
+// occasional comment and multi-line string.
+std::string
+makeLargeSource()
+{
+  std::string source;
+  for (int i = 0; source.size() < 32 * 1024 * 1024; ++i) {
+    source += "var value" + std::to_string(i) + " = (counter + 1.25) * limit >= 10 and !done;\n";
+    if (i % 8 == 0) {
+      source += "// Generated from template " + std::to_string(i) + "\n";
+    }
+    if (i % 16 == 0) {
+      source += "print \"a string that goes\non for more than\none line\";\n";
+    }
+  }
+  return source;
+}
+
+}
+
+BENCHMARK(LexParallelScaling)
+{
+  const auto source = makeLargeSource();
+  lexer::Lexer lexer;
+
+  bench::measure("lex", [&] { bench::doNotOptimize(lexer.lex(source)); }, source.size());
+
+  const auto maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+    bench::measure(
+      "lexParallel, " + std::to_string(threads) + " thread(s)",
+      [&] { bench::doNotOptimize(lexer.lexParallel(source, threads)); },
+      source.size()
+    );
+  }
+}
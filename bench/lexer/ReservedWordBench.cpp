@@ -0,0 +1,94 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <optional>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/ReservedWords.h"
+
+using lexer::Token;
+
+namespace {
+
+// Mostly identifiers with some reserved words and near-misses mixed in,
+// like typical generated code.
+std::vector<std::string>
+makeWords()
+{
+  const std::vector<std::string> pool {
+    "counter", "i", "x1", "value", "for", "fortune", "result", "print", "printer",
+    "this", "thing", "_tmp", "while", "whiles", "nil", "nil_", "index", "var", "variable",
+    "and", "android", "fun", "funnel", "return", "returned", "el", "else", "true", "trueish"
+  };
+
+  std::vector<std::string> words;
+  for (size_t i = 0; i < 10000; ++i) {
+    words.push_back(pool[(i * 7919) % pool.size()]);
+  }
+  return words;
+}
+
+// What the lexer used to do: build a string for the word and hash it.
+std::optional<Token::Type>
+lookUpInMap(std::string_view word)
+{
+  static const std::unordered_map<std::string, Token::Type> reservedWordMap {
+    { "for", Token::Type::FOR },
+    { "if", Token::Type::IF },
+    { "and", Token::Type::AND },
+    { "class", Token::Type::CLASS },
+    { "else", Token::Type::ELSE },
+    { "false", Token::Type::FALSE },
+    { "fun", Token::Type::FUN },
+    { "nil", Token::Type::NIL },
+    { "or", Token::Type::OR },
+    { "print", Token::Type::PRINT },
+    { "return", Token::Type::RETURN },
+    { "super", Token::Type::SUPER },
+    { "this", Token::Type::THIS },
+    { "true", Token::Type::TRUE },
+    { "var", Token::Type::VAR },
+    { "while", Token::Type::WHILE },
+  };
+
+  const auto it = reservedWordMap.find(std::string(word));
+  if (it == reservedWordMap.cend()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+template <class F>
+void
+lookUpAll(const std::vector<std::string> &words, F &&lookUp)
+{
+  size_t reserved = 0;
+  for (const auto &word : words) {
+    reserved += lookUp(word).has_value();
+  }
+  bench::doNotOptimize(reserved);
+}
+
+}
+
+BENCHMARK(ReservedWordLookup)
+{
+  const auto words = makeWords();
+
+  bench::measure("unordered_map<std::string>", [&] { lookUpAll(words, lookUpInMap); }, words.size());
+  bench::measure("reservedWordType", [&] { lookUpAll(words, lexer::reservedWordType); }, words.size());
+}
+
+BENCHMARK(LexIdentifierHeavy)
+{
+  std::string source;
+  for (const auto &word : makeWords()) {
+    source += word;
+    source += ' ';
+  }
+
+  lexer::Lexer lexer;
+  bench::measure("Lexer::lex", [&] { bench::doNotOptimize(lexer.lex(source)); }, source.size());
+}
@@ -0,0 +1,38 @@
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/SourceBuffer.h"
+
+namespace fs = std::filesystem;
+
+BENCHMARK(LoadAndLexFile)
+{
+  std::string source;
+  for (int i = 0; source.size() < 32 * 1024 * 1024; ++i) {
+    source += "var value" + std::to_string(i) + " = (counter + 1.25) * limit >= 10 and !done;\n";
+  }
+  const auto path = (fs::temp_directory_path() / "lox1-load-bench.lox").string();
+  std::ofstream(path, std::ios::binary) << source;
+
+  lexer::Lexer lexer;
+
+  // What `runFile` used to do.
+  bench::measure("ifstream + stringstream + str()", [&] {
+    std::ifstream fileStream(path);
+    std::stringstream stringStream;
+    stringStream << fileStream.rdbuf();
+    const auto contents = stringStream.str();
+    bench::doNotOptimize(lexer.lex(contents));
+  }, source.size());
+
+  bench::measure("SourceBuffer::fromFile", [&] {
+    const auto buffer = lexer::SourceBuffer::fromFile(path);
+    bench::doNotOptimize(lexer.lex(buffer.view()));
+  }, source.size());
+
+  fs::remove(path);
+}
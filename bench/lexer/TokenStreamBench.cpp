@@ -0,0 +1,89 @@
+#include <string>
+#include <vector>
+#include <optional>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/TokenSource.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+
+namespace {
+
+// A long, flat expression (mostly punctuation, like real code). Kept flat so that
+// the tree doesn't get deep enough to matter for destruction.
+std::string
+makeExpression()
+{
+  std::string source = "0";
+  for (int i = 0; i < 20000; ++i) {
+    source += " + (" + std::to_string(i) + " * -1) == \"s\"";
+  }
+  return source;
+}
+
+// Like VectorTokenSource, but borrows the tokens so that copying them isn't part of the measurement.
+class BorrowedTokenSource final : public lexer::TokenSource {
+public:
+  explicit BorrowedTokenSource(const std::vector<lexer::Token> &tokens) : tokens_(tokens) { }
+
+  std::optional<lexer::Token>
+  next() override
+  {
+    if (next_ >= tokens_.size()) {
+      return std::nullopt;
+    }
+    return tokens_[next_++];
+  }
+
+private:
+  const std::vector<lexer::Token> &tokens_;
+  size_t next_ = 0;
+};
+
+}
+
+BENCHMARK(TokenStreamMemory)
+{
+  const auto source = makeExpression();
+  lexer::Lexer lexer;
+  const auto tokens = lexer.lex(source);
+  const auto stream = lexer.lexToStream(source);
+
+  bench::report("std::vector<Token>", static_cast<double>(tokens.capacity() * sizeof(lexer::Token)) / tokens.size(), "bytes/token");
+  bench::report("TokenStream", static_cast<double>(stream.memoryUsage()) / stream.size(), "bytes/token");
+}
+
+BENCHMARK(TokenStreamParse)
+{
+  const auto source = makeExpression();
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto tokens = lexer.lex(source);
+  const auto stream = lexer.lexToStream(source);
+  parser::Parser parser(strings);
+
+  bench::measure(
+    "parse std::vector<Token>",
+    [&] {
+      BorrowedTokenSource tokenSource(tokens);
+      bench::doNotOptimize(parser.parse(tokenSource));
+    },
+    tokens.size()
+  );
+  bench::measure(
+    "parse TokenStream through TokenStreamSource",
+    [&] {
+      lexer::TokenStreamSource tokenSource(stream);
+      bench::doNotOptimize(parser.parse(tokenSource));
+    },
+    stream.size()
+  );
+  bench::measure(
+    "parse TokenStream in place",
+    [&] {
+      bench::doNotOptimize(parser.parse(stream));
+    },
+    stream.size()
+  );
+}
@@ -0,0 +1,18 @@
+#include <string>
+#include <iostream>
+
+#include "Bench.hpp"
+
+int
+main(int argc, char **argv)
+{
+  const std::string filter = argc > 1 ? argv[1] : "";
+
+  for (const auto &[name, function] : bench::registry()) {
+    if (name.find(filter) == std::string::npos) {
+      continue;
+    }
+    std::cout << name << std::endl;
+    function();
+  }
+}
@@ -0,0 +1,54 @@
+#include <string>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+#include "utils/AllocationCounter.hpp"
+#include "utils/Arena.hpp"
+
+namespace {
+
+// Lots of small nodes, but kept flat so that freeing the unique_ptr tree doesn't
+// recurse deeply.
+std::string
+makeExpression()
+{
+  std::string source = "0";
+  for (int i = 0; i < 20000; ++i) {
+    source += " + (" + std::to_string(i) + " * -1) == \"s\"";
+  }
+  return source;
+}
+
+}
+
+BENCHMARK(ArenaParse)
+{
+  const auto source = makeExpression();
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto stream = lexer.lexToStream(source);
+  parser::Parser parser(strings);
+
+  // Parsing and then freeing the tree, since freeing is where the layouts differ most.
+  const auto parseUniquePtrTree = [&] {
+    const auto expr = parser.parse(stream);
+    bench::doNotOptimize(expr);
+  };
+  const auto parseArenaTree = [&] {
+    Arena arena;
+    const auto expr = parser.parse(stream, arena);
+    bench::doNotOptimize(expr);
+  };
+
+  auto before = utils::allocationCount();
+  parseUniquePtrTree();
+  bench::report("unique_ptr tree", static_cast<double>(utils::allocationCount() - before), "allocations/parse");
+  before = utils::allocationCount();
+  parseArenaTree();
+  bench::report("arena tree", static_cast<double>(utils::allocationCount() - before), "allocations/parse");
+
+  bench::measure("parse + free unique_ptr tree", parseUniquePtrTree, stream.size());
+  bench::measure("parse + free arena tree", parseArenaTree, stream.size());
+}
@@ -0,0 +1,85 @@
+#include <string>
+#include <fstream>
+#include <filesystem>
+
+#include "Bench.hpp"
+#include "ast/BinaryExpr.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/SourceBuffer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Adds up the numbers in a saved tree without loading it, to show reading it in place.
+double
+sumNumbers(const ast::binary::Image &image)
+{
+  double sum = 0;
+  for (uint32_t index = 0; index < image.size(); ++index) {
+    const auto &record = image[ast::binary::Expr{ index }];
+    if (record.kind() == ast::binary::Kind::Num) {
+      sum += record.get<ast::binary::Num>().value();
+    }
+  }
+  return sum;
+}
+
+}
+
+BENCHMARK(BinaryAst)
+{
+  // About 1.6 million nodes.
+  std::string source = "0";
+  for (int i = 0; i < 200000; ++i) {
+    source += " + (" + std::to_string(i % 100) + " * -1) == \"s\"";
+  }
+  const auto sourcePath = (fs::temp_directory_path() / "lox1-binary-ast-bench.lox").string();
+  std::ofstream(sourcePath, std::ios::binary) << source;
+
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  parser::Parser parser(strings);
+  ast::flat::Tree tree;
+  {
+    const auto stream = lexer.lexToStream(source);
+    parser.parse(stream, tree);
+  }
+  const auto saved = ast::binary::save(tree);
+  const auto savedPath = (fs::temp_directory_path() / "lox1-binary-ast-bench.ast").string();
+  std::ofstream(savedPath, std::ios::binary) << saved;
+
+  bench::report("source", source.size() / 1e6, "MB");
+  bench::report("saved tree", saved.size() / 1e6, "MB");
+
+  // Both from a mapped file, as a script run again would be. Items are nodes.
+  bench::measure("lex + parse source into flat tree", [&] {
+    const auto buffer = lexer::SourceBuffer::fromFile(sourcePath);
+    const auto stream = lexer.lexToStream(buffer.view());
+    ast::flat::Tree parsed;
+    bench::doNotOptimize(parser.parse(stream, parsed));
+  }, tree.size());
+  bench::measure("open saved tree", [&] {
+    const auto buffer = lexer::SourceBuffer::fromFile(savedPath);
+    bench::doNotOptimize(ast::binary::Image::open(buffer.view()));
+  }, tree.size());
+  bench::measure("open saved tree + sum numbers in place", [&] {
+    const auto buffer = lexer::SourceBuffer::fromFile(savedPath);
+    bench::doNotOptimize(sumNumbers(ast::binary::Image::open(buffer.view())));
+  }, tree.size());
+  bench::measure("open saved tree + load into flat tree", [&] {
+    const auto buffer = lexer::SourceBuffer::fromFile(savedPath);
+    const auto image = ast::binary::Image::open(buffer.view());
+    utils::StringInterner interner;
+    ast::flat::Tree loaded;
+    bench::doNotOptimize(ast::binary::load(image, interner, loaded));
+  }, tree.size());
+  bench::measure("checksum only", [&] {
+    bench::doNotOptimize(hashBytes(saved.data(), saved.size()));
+  }, tree.size());
+
+  fs::remove(sourcePath);
+  fs::remove(savedPath);
+}
@@ -0,0 +1,56 @@
+#include <string>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+#include "visit/PrettyPrinter.hpp"
+
+namespace {
+
+// A deep left-leaning chain, so walking it chases a pointer (or an index) per
+// level. Kept to a depth the recursive visitors and destructors can cope with.
+std::string
+makeDeepExpression()
+{
+  std::string source = "0";
+  for (int i = 0; i < 5000; ++i) {
+    source += (i % 2 ? " + " : " * ") + std::to_string(i);
+  }
+  return source;
+}
+
+}
+
+BENCHMARK(FlatAst)
+{
+  const auto source = makeDeepExpression();
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto stream = lexer.lexToStream(source);
+  parser::Parser parser(strings);
+
+  const auto pointerTree = parser.parse(stream);
+  ast::flat::Tree flatTree;
+  const auto flatRoot = parser.parse(stream, flatTree);
+
+  // Not counting the allocator's own overhead for each of the pointer tree's nodes.
+  bench::report("pointer tree binary node", sizeof(ast::Expr) + sizeof(ast::BinOp), "bytes");
+  bench::report("flat tree node", static_cast<double>(flatTree.memoryUsage()) / flatTree.size(), "bytes");
+
+  visit::PrettyPrinter printer;
+  bench::measure("print pointer tree", [&] {
+    bench::doNotOptimize(printer.print(pointerTree));
+  }, flatTree.size());
+  bench::measure("print flat tree", [&] {
+    bench::doNotOptimize(printer.print(flatTree, flatRoot));
+  }, flatTree.size());
+
+  bench::measure("parse + free pointer tree", [&] {
+    bench::doNotOptimize(parser.parse(stream));
+  }, stream.size());
+  bench::measure("parse + free flat tree", [&] {
+    ast::flat::Tree tree;
+    bench::doNotOptimize(parser.parse(stream, tree));
+  }, stream.size());
+}
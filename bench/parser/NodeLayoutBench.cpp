@@ -0,0 +1,71 @@
+#include <string>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+#include "utils/AllocationCounter.hpp"
+#include "utils/Arena.hpp"
+
+namespace {
+
+template <class Parse>
+void
+reportPeakHeap(const std::string &label, const lexer::TokenStream &stream, Parse parse)
+{
+  const auto before = utils::resetPeakHeap();
+  parse(stream);
+  bench::report(label, (utils::peakHeap() - before) / 1e6, "MB peak heap");
+}
+
+}
+
+BENCHMARK(NodeLayout)
+{
+  bench::report("sizeof(ast::BinOp)", sizeof(ast::BinOp), "bytes");
+  bench::report("sizeof(ast::Num)", sizeof(ast::Num), "bytes");
+  bench::report("sizeof(ast::flat::Node)", sizeof(ast::flat::Node), "bytes");
+
+  // About 1.6 million nodes.
+  std::string source = "0";
+  for (int i = 0; i < 200000; ++i) {
+    source += " + (" + std::to_string(i % 100) + " * -1) == \"s\"";
+  }
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto stream = lexer.lexToStream(source);
+  parser::Parser parser(strings);
+
+  // Includes freeing the tree, which should never raise the peak.
+  reportPeakHeap("unique_ptr tree", stream, [&](auto &tokens) {
+    bench::doNotOptimize(parser.parse(tokens));
+  });
+  reportPeakHeap("arena tree", stream, [&](auto &tokens) {
+    Arena arena;
+    bench::doNotOptimize(parser.parse(tokens, arena));
+  });
+  reportPeakHeap("flat tree", stream, [&](auto &tokens) {
+    ast::flat::Tree tree;
+    bench::doNotOptimize(parser.parse(tokens, tree));
+  });
+  reportPeakHeap("flat tree, reserved up front", stream, [&](auto &tokens) {
+    ast::flat::Tree tree;
+    tree.reserve(stream.size());
+    bench::doNotOptimize(parser.parse(tokens, tree));
+  });
+  // The repeated "(i * -1)" and "s" subtrees only get one node each.
+  reportPeakHeap("flat tree, shared subtrees", stream, [&](auto &tokens) {
+    ast::flat::Tree tree;
+    bench::doNotOptimize(parser.parse(tokens, tree, parser::Parser::Subtrees::Shared));
+  });
+
+  // What sharing costs in time: a hash and a lookup for every node.
+  bench::measure("parse + free flat tree", [&] {
+    ast::flat::Tree tree;
+    bench::doNotOptimize(parser.parse(stream, tree));
+  }, stream.size());
+  bench::measure("parse + free flat tree, shared subtrees", [&] {
+    ast::flat::Tree tree;
+    bench::doNotOptimize(parser.parse(stream, tree, parser::Parser::Subtrees::Shared));
+  }, stream.size());
+}
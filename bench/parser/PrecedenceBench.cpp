@@ -0,0 +1,56 @@
+#include <string>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+#include "utils/Arena.hpp"
+
+namespace {
+
+// Long runs of operators at every precedence level, but hardly any nesting.
+std::string
+makeFlatExpression()
+{
+  std::string source = "0";
+  const char *ops[] = { " + ", " * ", " == ", " - ", " < ", " / ", " != ", " >= " };
+  for (int i = 0; i < 40000; ++i) {
+    source += ops[i % 8] + std::to_string(i % 100);
+  }
+  return source;
+}
+
+// Mostly literals and brackets, where each level of the grammar is paid for on
+// the way down to every single literal.
+std::string
+makeNestedExpression()
+{
+  std::string source = "0";
+  for (int i = 0; i < 2000; ++i) {
+    source += " + " + std::string(20, '(') + std::to_string(i) + std::string(20, ')');
+  }
+  return source;
+}
+
+void
+measureParse(const std::string &label, const std::string &source)
+{
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto stream = lexer.lexToStream(source);
+  parser::Parser parser(strings);
+
+  // Into an arena, so that allocating and freeing nodes doesn't drown out the parsing.
+  bench::measure(label, [&] {
+    Arena arena;
+    bench::doNotOptimize(parser.parse(stream, arena));
+  }, stream.size());
+}
+
+}
+
+BENCHMARK(ExpressionParse)
+{
+  measureParse("parse flat expression", makeFlatExpression());
+  measureParse("parse nested expression", makeNestedExpression());
+}
@@ -0,0 +1,85 @@
+#include <variant>
+#include <type_traits>
+
+#include "Bench.hpp"
+#include "ast/Expr.hpp"
+#include "utils/AllocationCounter.hpp"
+#include "visit/Evaluator.hpp"
+
+namespace {
+
+// A balanced tree of arithmetic on numbers, with a negation every few levels.
+ast::Expr
+makeArithmetic(int depth)
+{
+  if (depth == 0) {
+    return ast::num(1.5);
+  }
+  if (depth % 4 == 0) {
+    return ast::negate(ast::grouping(makeArithmetic(depth - 1)));
+  }
+  auto lhs = makeArithmetic(depth - 1);
+  auto rhs = makeArithmetic(depth - 1);
+  switch (depth % 4) {
+    case 1: return ast::add(std::move(lhs), std::move(rhs));
+    case 2: return ast::mult(std::move(lhs), std::move(rhs));
+    default: return ast::sub(std::move(lhs), std::move(rhs));
+  }
+}
+
+// Comparisons of arithmetic at the bottom, and equality of the booleans they make above that,
+// so numbers and booleans both go through the stack.
+ast::Expr
+makeComparison(int depth)
+{
+  if (depth <= 2) {
+    return ast::lt(makeArithmetic(depth), makeArithmetic(depth));
+  }
+  auto lhs = makeComparison(depth - 1);
+  auto rhs = makeComparison(depth - 1);
+  if (depth % 2) {
+    return ast::eq(std::move(lhs), std::move(rhs));
+  }
+  return ast::neq(std::move(lhs), ast::nott(std::move(rhs)));
+}
+
+size_t
+countNodes(const ast::Expr &expr)
+{
+  return std::visit([](const auto &node) -> size_t {
+    using Node = std::decay_t<decltype(*node)>;
+    if constexpr (std::is_same_v<Node, ast::BinOp>) {
+      return 1 + countNodes(node->lhs()) + countNodes(node->rhs());
+    } else if constexpr (std::is_same_v<Node, ast::UnaryOp> || std::is_same_v<Node, ast::Grouping>) {
+      return 1 + countNodes(node->child());
+    } else {
+      return 1;
+    }
+  }, expr);
+}
+
+}
+
+BENCHMARK(Evaluate)
+{
+  // About 600k and 500k nodes.
+  const auto arithmetic = makeArithmetic(23);
+  const auto comparison = makeComparison(17);
+
+  bench::report("sizeof(visit::Value)", sizeof(visit::Value), "bytes");
+
+  // The same evaluator each time, so its stacks are already allocated. Items are nodes.
+  utils::StringInterner strings;
+  visit::Evaluator evaluator(strings);
+  bench::measure("arithmetic tree", [&] {
+    bench::doNotOptimize(evaluator.evaluate(arithmetic));
+  }, countNodes(arithmetic));
+  bench::measure("comparison tree", [&] {
+    bench::doNotOptimize(evaluator.evaluate(comparison));
+  }, countNodes(comparison));
+
+  const auto before = utils::allocationCount();
+  bench::doNotOptimize(evaluator.evaluate(arithmetic));
+  bench::doNotOptimize(evaluator.evaluate(comparison));
+  bench::report("allocations per evaluation", (utils::allocationCount() - before) / 2.0, "");
+}
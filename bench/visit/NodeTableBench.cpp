@@ -0,0 +1,46 @@
+#include <string>
+#include <unordered_map>
+
+#include "Bench.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+#include "visit/NodeTable.hpp"
+
+BENCHMARK(NodeTable)
+{
+  std::string source = "0";
+  for (int i = 0; i < 50000; ++i) {
+    source += " + (" + std::to_string(i) + " * -1)";
+  }
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto stream = lexer.lexToStream(source);
+  parser::Parser parser(strings);
+  ast::flat::Tree tree;
+  parser.parse(stream, tree);
+
+  // Annotate every node, then read every annotation back, as a pass over the tree would.
+  bench::measure("annotate + look up, NodeTable", [&] {
+    visit::NodeTable<uint32_t> counts(parser.nodeCount());
+    for (uint32_t index = 0; index < tree.size(); ++index) {
+      counts[visit::id(tree, ast::flat::Expr{ index })] = index;
+    }
+    uint32_t sum = 0;
+    for (uint32_t index = 0; index < tree.size(); ++index) {
+      sum += counts[visit::id(tree, ast::flat::Expr{ index })];
+    }
+    bench::doNotOptimize(sum);
+  }, tree.size());
+  bench::measure("annotate + look up, unordered_map", [&] {
+    std::unordered_map<size_t, uint32_t> counts;
+    for (uint32_t index = 0; index < tree.size(); ++index) {
+      counts[visit::id(tree, ast::flat::Expr{ index })] = index;
+    }
+    uint32_t sum = 0;
+    for (uint32_t index = 0; index < tree.size(); ++index) {
+      sum += counts[visit::id(tree, ast::flat::Expr{ index })];
+    }
+    bench::doNotOptimize(sum);
+  }, tree.size());
+}
@@ -0,0 +1,135 @@
+#include "Bench.hpp"
+#include "ast/Expr.hpp"
+#include "ast/FlatExpr.hpp"
+
+namespace {
+
+// A balanced tree, so the recursive visitors don't go too deep.
+ast::Expr
+makeTree(int depth)
+{
+  if (depth == 0) {
+    return ast::num(1);
+  }
+  if (depth % 3 == 0) {
+    return ast::negate(ast::grouping(makeTree(depth - 1)));
+  }
+  return ast::add(makeTree(depth - 1), makeTree(depth - 1));
+}
+
+ast::flat::Expr
+makeFlatTree(ast::flat::Tree &tree, int depth)
+{
+  if (depth == 0) {
+    return ast::flat::num(tree, 1);
+  }
+  if (depth % 3 == 0) {
+    return ast::flat::negate(tree, ast::flat::grouping(tree, makeFlatTree(tree, depth - 1)));
+  }
+  auto lhs = makeFlatTree(tree, depth - 1);
+  return ast::flat::add(tree, std::move(lhs), makeFlatTree(tree, depth - 1));
+}
+
+// The same (small) amount of work per node either way, so the dispatch is what's measured.
+class VirtualSum final : public ast::ConstVisitor<double> {
+public:
+  double visitBinOp(const ast::BinOp &binOp) override { return visit(binOp.lhs()) + visit(binOp.rhs()); }
+  double visitUnaryOp(const ast::UnaryOp &unaryOp) override { return -visit(unaryOp.child()); }
+  double visitString(const ast::String &) override { return 0; }
+  double visitNum(const ast::Num &num) override { return num.value(); }
+  double visitGrouping(const ast::Grouping &grouping) override { return visit(grouping.child()); }
+  double visitTruee(const ast::Truee &) override { return 1; }
+  double visitFalsee(const ast::Falsee &) override { return 0; }
+  double visitNil(const ast::Nil &) override { return 0; }
+};
+
+class StaticSum final : public ast::StaticConstVisitor<StaticSum, double> {
+public:
+  double visitBinOp(const ast::BinOp &binOp) { return visit(binOp.lhs()) + visit(binOp.rhs()); }
+  double visitUnaryOp(const ast::UnaryOp &unaryOp) { return -visit(unaryOp.child()); }
+  double visitString(const ast::String &) { return 0; }
+  double visitNum(const ast::Num &num) { return num.value(); }
+  double visitGrouping(const ast::Grouping &grouping) { return visit(grouping.child()); }
+  double visitTruee(const ast::Truee &) { return 1; }
+  double visitFalsee(const ast::Falsee &) { return 0; }
+  double visitNil(const ast::Nil &) { return 0; }
+};
+
+class FlatVirtualSum final : public ast::flat::ConstVisitor<double> {
+public:
+  double visitBinOp(const ast::flat::BinOp &binOp) override { return visit(binOp.lhs()) + visit(binOp.rhs()); }
+  double visitUnaryOp(const ast::flat::UnaryOp &unaryOp) override { return -visit(unaryOp.child()); }
+  double visitString(const ast::flat::String &) override { return 0; }
+  double visitNum(const ast::flat::Num &num) override { return num.value(); }
+  double visitGrouping(const ast::flat::Grouping &grouping) override { return visit(grouping.child()); }
+  double visitTruee(const ast::flat::Truee &) override { return 1; }
+  double visitFalsee(const ast::flat::Falsee &) override { return 0; }
+  double visitNil(const ast::flat::Nil &) override { return 0; }
+};
+
+class FlatStaticSum final : public ast::flat::StaticConstVisitor<FlatStaticSum, double> {
+public:
+  double visitBinOp(const ast::flat::BinOp &binOp) { return visit(binOp.lhs()) + visit(binOp.rhs()); }
+  double visitUnaryOp(const ast::flat::UnaryOp &unaryOp) { return -visit(unaryOp.child()); }
+  double visitString(const ast::flat::String &) { return 0; }
+  double visitNum(const ast::flat::Num &num) { return num.value(); }
+  double visitGrouping(const ast::flat::Grouping &grouping) { return visit(grouping.child()); }
+  double visitTruee(const ast::flat::Truee &) { return 1; }
+  double visitFalsee(const ast::flat::Falsee &) { return 0; }
+  double visitNil(const ast::flat::Nil &) { return 0; }
+};
+
+// Explicit-stack traversals can't return a value from each node, so the sum is kept as it goes
+// (negations and all would need a stack of their own, so this only adds up the leaves).
+class TraversalSum final : public ast::ConstTraversal<TraversalSum> {
+public:
+  double sum = 0;
+
+  void visitNum(const ast::Num &num) { sum += num.value(); }
+  void visitTruee(const ast::Truee &) { sum += 1; }
+};
+
+class FlatTraversalSum final : public ast::flat::ConstTraversal<FlatTraversalSum> {
+public:
+  double sum = 0;
+
+  void visitNum(const ast::flat::Num &num) { sum += num.value(); }
+  void visitTruee(const ast::flat::Truee &) { sum += 1; }
+};
+
+}
+
+BENCHMARK(StaticVisitor)
+{
+  constexpr int depth = 27; // about 500k nodes
+  const auto expr = makeTree(depth);
+  ast::flat::Tree tree;
+  const auto root = makeFlatTree(tree, depth);
+
+  bench::measure("virtual visitor, unique_ptr tree", [&] {
+    bench::doNotOptimize(VirtualSum().visit(expr));
+  }, tree.size());
+  bench::measure("static visitor, unique_ptr tree", [&] {
+    bench::doNotOptimize(StaticSum().visit(expr));
+  }, tree.size());
+  bench::measure("virtual visitor, flat tree", [&] {
+    bench::doNotOptimize(FlatVirtualSum().visit(tree, root));
+  }, tree.size());
+  bench::measure("static visitor, flat tree", [&] {
+    bench::doNotOptimize(FlatStaticSum().visit(tree, root));
+  }, tree.size());
+
+  // The same traversal each time, as a printer would be, so the stack is already allocated.
+  TraversalSum traversal;
+  bench::measure("explicit-stack traversal, unique_ptr tree", [&] {
+    traversal.sum = 0;
+    traversal.traverse(expr);
+    bench::doNotOptimize(traversal.sum);
+  }, tree.size());
+  FlatTraversalSum flatTraversal;
+  bench::measure("explicit-stack traversal, flat tree", [&] {
+    flatTraversal.sum = 0;
+    flatTraversal.traverse(tree, root);
+    bench::doNotOptimize(flatTraversal.sum);
+  }, tree.size());
+}
@@ -0,0 +1,962 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "ast/Expr.hpp"
+#include "utils/Arena.hpp"
+#include "utils/Counter.hpp"
+#include "utils/Hash.hpp"
+#include "utils/StringInterner.hpp"
+
+namespace ast::arena {
+
+// Forward declarations are needed because the superclass and subclasses mutually refer to each other.
+class BinOp;
+class UnaryOp;
+class String;
+class Num;
+class Grouping;
+class Truee;
+class Falsee;
+class Nil;
+
+using BinOpPtr = BinOp *;
+using UnaryOpPtr = UnaryOp *;
+using StringPtr = String *;
+using NumPtr = Num *;
+using GroupingPtr = Grouping *;
+using TrueePtr = Truee *;
+using FalseePtr = Falsee *;
+using NilPtr = Nil *;
+
+using Expr = std::variant<
+  BinOpPtr,
+  UnaryOpPtr,
+  StringPtr,
+  NumPtr,
+  GroupingPtr,
+  TrueePtr,
+  FalseePtr,
+  NilPtr
+>;
+
+
+class BinOp {
+public:
+  using Op = ::ast::BinOp::Op;
+
+  BinOp(
+    Expr lhs,
+    Op operation,
+    Expr rhs,
+    uint32_t id
+  ): lhs_(std::move(lhs)),
+    rhs_(std::move(rhs)),
+    id_(std::move(id)),
+    operation_(std::move(operation)) { }
+
+  Expr &lhs() { return lhs_; }
+  Op &operation() { return operation_; }
+  Expr &rhs() { return rhs_; }
+  uint32_t &id() { return id_; }
+
+  const Expr &lhs() const { return lhs_; }
+  const Op &operation() const { return operation_; }
+  const Expr &rhs() const { return rhs_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr lhs_;
+  Expr rhs_;
+  uint32_t id_;
+  Op operation_;
+};
+
+static_assert(sizeof(BinOp) <= 40, "BinOp is bigger than its fields packed together");
+
+
+class UnaryOp {
+public:
+  using Op = ::ast::UnaryOp::Op;
+
+  UnaryOp(
+    Op operation,
+    Expr child,
+    uint32_t id
+  ): child_(std::move(child)),
+    id_(std::move(id)),
+    operation_(std::move(operation)) { }
+
+  Op &operation() { return operation_; }
+  Expr &child() { return child_; }
+  uint32_t &id() { return id_; }
+
+  const Op &operation() const { return operation_; }
+  const Expr &child() const { return child_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr child_;
+  uint32_t id_;
+  Op operation_;
+};
+
+static_assert(sizeof(UnaryOp) <= 24, "UnaryOp is bigger than its fields packed together");
+
+
+class String {
+public:
+
+  String(
+    utils::Symbol value,
+    uint32_t id
+  ): value_(std::move(value)),
+    id_(std::move(id)) { }
+
+  utils::Symbol &value() { return value_; }
+  uint32_t &id() { return id_; }
+
+  const utils::Symbol &value() const { return value_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  utils::Symbol value_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(String) <= 16, "String is bigger than its fields packed together");
+
+
+class Num {
+public:
+
+  Num(
+    double value,
+    uint32_t id
+  ): value_(std::move(value)),
+    id_(std::move(id)) { }
+
+  double &value() { return value_; }
+  uint32_t &id() { return id_; }
+
+  const double &value() const { return value_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  double value_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(Num) <= 16, "Num is bigger than its fields packed together");
+
+
+class Grouping {
+public:
+
+  Grouping(
+    Expr child,
+    uint32_t id
+  ): child_(std::move(child)),
+    id_(std::move(id)) { }
+
+  Expr &child() { return child_; }
+  uint32_t &id() { return id_; }
+
+  const Expr &child() const { return child_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr child_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(Grouping) <= 24, "Grouping is bigger than its fields packed together");
+
+
+class Truee {
+public:
+
+  Truee(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Truee) <= 4, "Truee is bigger than its fields packed together");
+
+
+class Falsee {
+public:
+
+  Falsee(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Falsee) <= 4, "Falsee is bigger than its fields packed together");
+
+
+class Nil {
+public:
+
+  Nil(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Nil) <= 4, "Nil is bigger than its fields packed together");
+
+BinOpPtr
+inline mult(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Mult,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline div(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Div,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline add(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Add,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline sub(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Sub,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline gtEq(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::GtEq,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline gt(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Gt,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline ltEq(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::LtEq,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline lt(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Lt,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline eq(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Eq,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+BinOpPtr
+inline neq(
+  Arena &arena,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return arena.create<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Neq,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+UnaryOpPtr
+inline negate(
+  Arena &arena,
+  Expr &&child
+) {
+  return arena.create<UnaryOp>(
+    UnaryOp::Op::Negate,
+    std::move(child),
+    Counter::nextShared()
+  );
+}
+
+
+UnaryOpPtr
+inline nott(
+  Arena &arena,
+  Expr &&child
+) {
+  return arena.create<UnaryOp>(
+    UnaryOp::Op::Nott,
+    std::move(child),
+    Counter::nextShared()
+  );
+}
+
+
+StringPtr
+inline string(
+  Arena &arena,
+  utils::Symbol &&value
+) {
+  return arena.create<String>(
+    std::move(value),
+    Counter::nextShared()
+  );
+}
+
+
+NumPtr
+inline num(
+  Arena &arena,
+  double &&value
+) {
+  return arena.create<Num>(
+    std::move(value),
+    Counter::nextShared()
+  );
+}
+
+
+GroupingPtr
+inline grouping(
+  Arena &arena,
+  Expr &&child
+) {
+  return arena.create<Grouping>(
+    std::move(child),
+    Counter::nextShared()
+  );
+}
+
+
+TrueePtr
+inline truee(
+  Arena &arena
+) {
+  return arena.create<Truee>(
+    Counter::nextShared()
+  );
+}
+
+
+FalseePtr
+inline falsee(
+  Arena &arena
+) {
+  return arena.create<Falsee>(
+    Counter::nextShared()
+  );
+}
+
+
+NilPtr
+inline nil(
+  Arena &arena
+) {
+  return arena.create<Nil>(
+    Counter::nextShared()
+  );
+}
+
+class Factory {
+public:
+  using Expr = ::ast::arena::Expr;
+
+  Factory(Arena &arena, Counter &ids)
+    : arena_(arena)
+    , ids_(ids)
+    { }
+
+  BinOpPtr
+  binOp(Expr &&lhs, BinOp::Op &&operation, Expr &&rhs)
+  {
+    return arena_.create<BinOp>(
+      std::move(lhs),
+      std::move(operation),
+      std::move(rhs),
+      ids_.next()
+    );
+  }
+
+  UnaryOpPtr
+  unaryOp(UnaryOp::Op &&operation, Expr &&child)
+  {
+    return arena_.create<UnaryOp>(
+      std::move(operation),
+      std::move(child),
+      ids_.next()
+    );
+  }
+
+  StringPtr
+  string(utils::Symbol &&value)
+  {
+    return arena_.create<String>(
+      std::move(value),
+      ids_.next()
+    );
+  }
+
+  NumPtr
+  num(double &&value)
+  {
+    return arena_.create<Num>(
+      std::move(value),
+      ids_.next()
+    );
+  }
+
+  GroupingPtr
+  grouping(Expr &&child)
+  {
+    return arena_.create<Grouping>(
+      std::move(child),
+      ids_.next()
+    );
+  }
+
+  TrueePtr
+  truee()
+  {
+    return arena_.create<Truee>(
+      ids_.next()
+    );
+  }
+
+  FalseePtr
+  falsee()
+  {
+    return arena_.create<Falsee>(
+      ids_.next()
+    );
+  }
+
+  NilPtr
+  nil()
+  {
+    return arena_.create<Nil>(
+      ids_.next()
+    );
+  }
+
+private:
+  Arena &arena_;
+  Counter &ids_;
+
+};
+
+namespace detail {
+
+// What a node adds to its tree's structural hash besides its children: its kind, and its
+// other fields.
+inline size_t
+structuralHashOf(const BinOp &binOp)
+{
+  size_t seed = 0;
+  seed = hashCombine(seed, std::hash<BinOp::Op>()(binOp.operation()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const UnaryOp &unaryOp)
+{
+  size_t seed = 1;
+  seed = hashCombine(seed, std::hash<UnaryOp::Op>()(unaryOp.operation()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const String &string)
+{
+  size_t seed = 2;
+  seed = hashCombine(seed, std::hash<utils::Symbol>()(string.value()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const Num &num)
+{
+  size_t seed = 3;
+  seed = hashCombine(seed, std::hash<uint64_t>()(bitPattern(num.value())));
+  return seed;
+}
+
+inline size_t structuralHashOf(const Grouping &) { return 4; }
+
+inline size_t structuralHashOf(const Truee &) { return 5; }
+
+inline size_t structuralHashOf(const Falsee &) { return 6; }
+
+inline size_t structuralHashOf(const Nil &) { return 7; }
+
+// Whether two nodes of the same kind have the same fields, leaving aside their children.
+inline bool
+sameFields(const BinOp &lhs, const BinOp &rhs)
+{
+  return lhs.operation() == rhs.operation();
+}
+
+inline bool
+sameFields(const UnaryOp &lhs, const UnaryOp &rhs)
+{
+  return lhs.operation() == rhs.operation();
+}
+
+inline bool
+sameFields(const String &lhs, const String &rhs)
+{
+  return lhs.value() == rhs.value();
+}
+
+inline bool
+sameFields(const Num &lhs, const Num &rhs)
+{
+  return bitPattern(lhs.value()) == bitPattern(rhs.value());
+}
+
+inline bool sameFields(const Grouping &, const Grouping &) { return true; }
+
+inline bool sameFields(const Truee &, const Truee &) { return true; }
+
+inline bool sameFields(const Falsee &, const Falsee &) { return true; }
+
+inline bool sameFields(const Nil &, const Nil &) { return true; }
+
+// Pushes a node's children onto `stack`, to be walked after it.
+inline void
+pushChildren(const BinOp &binOp, std::vector<const Expr *> &stack)
+{
+  stack.push_back(&binOp.rhs());
+  stack.push_back(&binOp.lhs());
+}
+
+inline void
+pushChildren(const UnaryOp &unaryOp, std::vector<const Expr *> &stack)
+{
+  stack.push_back(&unaryOp.child());
+}
+
+inline void pushChildren(const String &, std::vector<const Expr *> &) { }
+
+inline void pushChildren(const Num &, std::vector<const Expr *> &) { }
+
+inline void
+pushChildren(const Grouping &grouping, std::vector<const Expr *> &stack)
+{
+  stack.push_back(&grouping.child());
+}
+
+inline void pushChildren(const Truee &, std::vector<const Expr *> &) { }
+
+inline void pushChildren(const Falsee &, std::vector<const Expr *> &) { }
+
+inline void pushChildren(const Nil &, std::vector<const Expr *> &) { }
+
+}
+
+// Equal trees have equal hashes, and trees are equal if they have the same kinds of node
+// in the same places, with the same values in them. Ids don't count.
+inline size_t
+structuralHash(const Expr &expr)
+{
+  // The nodes come off the stack in preorder, and each kind of node always has the same
+  // number of children, so the order the nodes are hashed in is enough to tell shapes apart.
+  size_t seed = 0;
+  std::vector<const Expr *> stack{ &expr };
+  while (!stack.empty()) {
+    const Expr *next = stack.back();
+    stack.pop_back();
+    std::visit([&](const auto &node) {
+      seed = hashCombine(seed, detail::structuralHashOf(*node));
+      detail::pushChildren(*node, stack);
+    }, *next);
+  }
+  return seed;
+}
+
+inline bool
+structurallyEqual(const Expr &lhs, const Expr &rhs)
+{
+  // Children are only pushed once their parents are known to be the same kind, so the two
+  // stacks always hold the same number of nodes.
+  std::vector<const Expr *> lhsStack{ &lhs };
+  std::vector<const Expr *> rhsStack{ &rhs };
+  while (!lhsStack.empty()) {
+    const Expr *lhsNext = lhsStack.back();
+    const Expr *rhsNext = rhsStack.back();
+    lhsStack.pop_back();
+    rhsStack.pop_back();
+    const auto &lhsNode = *lhsNext;
+    const auto &rhsNode = *rhsNext;
+    if (lhsNode.index() != rhsNode.index()) {
+      return false;
+    }
+    const bool same = std::visit([&](const auto &node) {
+      const auto &other = *std::get<std::decay_t<decltype(node)>>(rhsNode);
+      if (!detail::sameFields(*node, other)) {
+        return false;
+      }
+      detail::pushChildren(*node, lhsStack);
+      detail::pushChildren(other, rhsStack);
+      return true;
+    }, lhsNode);
+    if (!same) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class T>
+class Visitor {
+public:
+  virtual ~Visitor() =default;
+
+  virtual T visitBinOp(BinOp &binOp) =0;
+  virtual T visitUnaryOp(UnaryOp &unaryOp) =0;
+  virtual T visitString(String &string) =0;
+  virtual T visitNum(Num &num) =0;
+  virtual T visitGrouping(Grouping &grouping) =0;
+  virtual T visitTruee(Truee &truee) =0;
+  virtual T visitFalsee(Falsee &falsee) =0;
+  virtual T visitNil(Nil &nil) =0;
+
+  T operator()(BinOp *binOp) { return visitBinOp(*binOp); }
+  T operator()(UnaryOp *unaryOp) { return visitUnaryOp(*unaryOp); }
+  T operator()(String *string) { return visitString(*string); }
+  T operator()(Num *num) { return visitNum(*num); }
+  T operator()(Grouping *grouping) { return visitGrouping(*grouping); }
+  T operator()(Truee *truee) { return visitTruee(*truee); }
+  T operator()(Falsee *falsee) { return visitFalsee(*falsee); }
+  T operator()(Nil *nil) { return visitNil(*nil); }
+
+  T
+  visit(Expr &expr)
+  {
+    return std::visit(*this, expr);
+  }
+
+};
+
+template <class T>
+class ConstVisitor {
+public:
+  virtual ~ConstVisitor() =default;
+
+  virtual T visitBinOp(const BinOp &binOp) =0;
+  virtual T visitUnaryOp(const UnaryOp &unaryOp) =0;
+  virtual T visitString(const String &string) =0;
+  virtual T visitNum(const Num &num) =0;
+  virtual T visitGrouping(const Grouping &grouping) =0;
+  virtual T visitTruee(const Truee &truee) =0;
+  virtual T visitFalsee(const Falsee &falsee) =0;
+  virtual T visitNil(const Nil &nil) =0;
+
+  T operator()(const BinOp *binOp) { return visitBinOp(*binOp); }
+  T operator()(const UnaryOp *unaryOp) { return visitUnaryOp(*unaryOp); }
+  T operator()(const String *string) { return visitString(*string); }
+  T operator()(const Num *num) { return visitNum(*num); }
+  T operator()(const Grouping *grouping) { return visitGrouping(*grouping); }
+  T operator()(const Truee *truee) { return visitTruee(*truee); }
+  T operator()(const Falsee *falsee) { return visitFalsee(*falsee); }
+  T operator()(const Nil *nil) { return visitNil(*nil); }
+
+  T
+  visit(const Expr &expr)
+  {
+    return std::visit(*this, expr);
+  }
+
+};
+
+// Derive from this as `class V : public StaticVisitor<V, T>`, and give `V` a `visitX` method for
+// each node. If `V` derives privately or the methods are private, it needs to be friends
+// with `StaticVisitor<V, T>`.
+template <class Derived, class T>
+class StaticVisitor {
+public:
+  T operator()(BinOp *binOp) { return derived().visitBinOp(*binOp); }
+  T operator()(UnaryOp *unaryOp) { return derived().visitUnaryOp(*unaryOp); }
+  T operator()(String *string) { return derived().visitString(*string); }
+  T operator()(Num *num) { return derived().visitNum(*num); }
+  T operator()(Grouping *grouping) { return derived().visitGrouping(*grouping); }
+  T operator()(Truee *truee) { return derived().visitTruee(*truee); }
+  T operator()(Falsee *falsee) { return derived().visitFalsee(*falsee); }
+  T operator()(Nil *nil) { return derived().visitNil(*nil); }
+
+  T
+  visit(Expr &expr)
+  {
+    return std::visit(*this, expr);
+  }
+
+private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+};
+
+// Derive from this as `class V : public StaticConstVisitor<V, T>`, and give `V` a `visitX` method for
+// each node. If `V` derives privately or the methods are private, it needs to be friends
+// with `StaticConstVisitor<V, T>`.
+template <class Derived, class T>
+class StaticConstVisitor {
+public:
+  T operator()(const BinOp *binOp) { return derived().visitBinOp(*binOp); }
+  T operator()(const UnaryOp *unaryOp) { return derived().visitUnaryOp(*unaryOp); }
+  T operator()(const String *string) { return derived().visitString(*string); }
+  T operator()(const Num *num) { return derived().visitNum(*num); }
+  T operator()(const Grouping *grouping) { return derived().visitGrouping(*grouping); }
+  T operator()(const Truee *truee) { return derived().visitTruee(*truee); }
+  T operator()(const Falsee *falsee) { return derived().visitFalsee(*falsee); }
+  T operator()(const Nil *nil) { return derived().visitNil(*nil); }
+
+  T
+  visit(const Expr &expr)
+  {
+    return std::visit(*this, expr);
+  }
+
+private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+};
+
+// Derive from this as `class T : public ConstTraversal<T>`, and give `T` the callbacks it
+// needs (the rest do nothing): `visitX` for each leaf node, and `enterX`, `betweenX` (between
+// children) and `leaveX` for each node with children. Like the static visitors, `T` needs to be
+// friends with `ConstTraversal<T>` if it derives privately or the callbacks are private.
+// The stack is kept between traversals, so reusing a traversal doesn't reallocate it.
+template <class Derived>
+class ConstTraversal {
+public:
+  void
+  traverse(const Expr &expr)
+  {
+    run(&expr);
+  }
+
+  void enterBinOp(const BinOp &) { }
+  void betweenBinOp(const BinOp &) { }
+  void leaveBinOp(const BinOp &) { }
+  void enterUnaryOp(const UnaryOp &) { }
+  void leaveUnaryOp(const UnaryOp &) { }
+  void visitString(const String &) { }
+  void visitNum(const Num &) { }
+  void enterGrouping(const Grouping &) { }
+  void leaveGrouping(const Grouping &) { }
+  void visitTruee(const Truee &) { }
+  void visitFalsee(const Falsee &) { }
+  void visitNil(const Nil &) { }
+
+private:
+  struct Entry {
+    const void *node;
+    // Which of the `Expr` alternatives the node is.
+    uint32_t kind;
+    // How many of its children have been started.
+    uint32_t phase;
+  };
+
+  std::vector<Entry> stack_;
+
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+  void
+  run(const Expr *expr)
+  {
+    // Left over if a callback threw partway through the last traversal.
+    stack_.clear();
+    descend(expr);
+    while (!stack_.empty()) {
+      const auto entry = stack_.back();
+      switch (entry.kind) {
+      case 0: resume(*static_cast<const BinOp *>(entry.node), entry.phase); break;
+      case 1: resume(*static_cast<const UnaryOp *>(entry.node), entry.phase); break;
+      case 4: resume(*static_cast<const Grouping *>(entry.node), entry.phase); break;
+      }
+    }
+  }
+
+  // Starts nodes down to the first leaf, leaving the ones with more children on the stack.
+  void
+  descend(const Expr *expr)
+  {
+    while (expr) {
+      expr = std::visit([this](const auto &node) { return start(*node); }, *expr);
+    }
+  }
+
+  const Expr *
+  start(const BinOp &binOp)
+  {
+    derived().enterBinOp(binOp);
+    stack_.push_back({ &binOp, 0, 1 });
+    return &binOp.lhs();
+  }
+
+  const Expr *
+  start(const UnaryOp &unaryOp)
+  {
+    derived().enterUnaryOp(unaryOp);
+    stack_.push_back({ &unaryOp, 1, 1 });
+    return &unaryOp.child();
+  }
+
+  const Expr *
+  start(const Grouping &grouping)
+  {
+    derived().enterGrouping(grouping);
+    stack_.push_back({ &grouping, 4, 1 });
+    return &grouping.child();
+  }
+
+  const Expr *start(const String &string) { derived().visitString(string); return nullptr; }
+  const Expr *start(const Num &num) { derived().visitNum(num); return nullptr; }
+  const Expr *start(const Truee &truee) { derived().visitTruee(truee); return nullptr; }
+  const Expr *start(const Falsee &falsee) { derived().visitFalsee(falsee); return nullptr; }
+  const Expr *start(const Nil &nil) { derived().visitNil(nil); return nullptr; }
+
+  void
+  resume(const BinOp &binOp, uint32_t phase)
+  {
+    switch (phase) {
+    case 1:
+      ++stack_.back().phase;
+      derived().betweenBinOp(binOp);
+      return descend(&binOp.rhs());
+    default:
+      stack_.pop_back();
+      derived().leaveBinOp(binOp);
+    }
+  }
+
+  void
+  resume(const UnaryOp &unaryOp, uint32_t)
+  {
+    stack_.pop_back();
+    derived().leaveUnaryOp(unaryOp);
+  }
+
+  void
+  resume(const Grouping &grouping, uint32_t)
+  {
+    stack_.pop_back();
+    derived().leaveGrouping(grouping);
+  }
+
+};
+}
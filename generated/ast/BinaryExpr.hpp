@@ -0,0 +1,587 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+
+#include "ast/FlatExpr.hpp"
+#include "utils/Assert.hpp"
+#include "utils/Counter.hpp"
+#include "utils/Hash.hpp"
+#include "utils/StringInterner.hpp"
+
+namespace ast::binary {
+
+// A node in a saved tree, as its index in the tree's table of nodes.
+struct Expr {
+  uint32_t index;
+
+  bool operator==(Expr other) const { return index == other.index; }
+  bool operator!=(Expr other) const { return index != other.index; }
+};
+
+// A string in a saved tree, as where its bytes are in the tree's strings (see `Image::string`).
+struct StringRef {
+  uint32_t offset;
+  uint32_t length;
+
+  bool operator==(StringRef other) const { return offset == other.offset && length == other.length; }
+  bool operator!=(StringRef other) const { return !(*this == other); }
+};
+
+
+class BinOp {
+public:
+  using Op = ::ast::BinOp::Op;
+
+  BinOp(
+    Expr lhs,
+    Op operation,
+    Expr rhs,
+    uint32_t id
+  ): lhs_(std::move(lhs)),
+    rhs_(std::move(rhs)),
+    id_(std::move(id)),
+    operation_(std::move(operation)) { }
+
+  Expr &lhs() { return lhs_; }
+  Op &operation() { return operation_; }
+  Expr &rhs() { return rhs_; }
+  uint32_t &id() { return id_; }
+
+  const Expr &lhs() const { return lhs_; }
+  const Op &operation() const { return operation_; }
+  const Expr &rhs() const { return rhs_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr lhs_;
+  Expr rhs_;
+  uint32_t id_;
+  Op operation_;
+};
+
+static_assert(sizeof(BinOp) <= 16, "BinOp is bigger than its fields packed together");
+
+
+class UnaryOp {
+public:
+  using Op = ::ast::UnaryOp::Op;
+
+  UnaryOp(
+    Op operation,
+    Expr child,
+    uint32_t id
+  ): child_(std::move(child)),
+    id_(std::move(id)),
+    operation_(std::move(operation)) { }
+
+  Op &operation() { return operation_; }
+  Expr &child() { return child_; }
+  uint32_t &id() { return id_; }
+
+  const Op &operation() const { return operation_; }
+  const Expr &child() const { return child_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr child_;
+  uint32_t id_;
+  Op operation_;
+};
+
+static_assert(sizeof(UnaryOp) <= 12, "UnaryOp is bigger than its fields packed together");
+
+
+class String {
+public:
+
+  String(
+    StringRef value,
+    uint32_t id
+  ): value_(std::move(value)),
+    id_(std::move(id)) { }
+
+  StringRef &value() { return value_; }
+  uint32_t &id() { return id_; }
+
+  const StringRef &value() const { return value_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  StringRef value_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(String) <= 12, "String is bigger than its fields packed together");
+
+
+class Num {
+public:
+
+  Num(
+    double value,
+    uint32_t id
+  ): value_(std::move(value)),
+    id_(std::move(id)) { }
+
+  double &value() { return value_; }
+  uint32_t &id() { return id_; }
+
+  const double &value() const { return value_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  double value_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(Num) <= 16, "Num is bigger than its fields packed together");
+
+
+class Grouping {
+public:
+
+  Grouping(
+    Expr child,
+    uint32_t id
+  ): child_(std::move(child)),
+    id_(std::move(id)) { }
+
+  Expr &child() { return child_; }
+  uint32_t &id() { return id_; }
+
+  const Expr &child() const { return child_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr child_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(Grouping) <= 8, "Grouping is bigger than its fields packed together");
+
+
+class Truee {
+public:
+
+  Truee(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Truee) <= 4, "Truee is bigger than its fields packed together");
+
+
+class Falsee {
+public:
+
+  Falsee(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Falsee) <= 4, "Falsee is bigger than its fields packed together");
+
+
+class Nil {
+public:
+
+  Nil(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Nil) <= 4, "Nil is bigger than its fields packed together");
+
+enum class Kind : uint8_t { BinOp, UnaryOp, String, Num, Grouping, Truee, Falsee, Nil };
+
+template <class T> struct KindOf;
+template <> struct KindOf<BinOp> { static constexpr Kind value = Kind::BinOp; };
+template <> struct KindOf<UnaryOp> { static constexpr Kind value = Kind::UnaryOp; };
+template <> struct KindOf<String> { static constexpr Kind value = Kind::String; };
+template <> struct KindOf<Num> { static constexpr Kind value = Kind::Num; };
+template <> struct KindOf<Grouping> { static constexpr Kind value = Kind::Grouping; };
+template <> struct KindOf<Truee> { static constexpr Kind value = Kind::Truee; };
+template <> struct KindOf<Falsee> { static constexpr Kind value = Kind::Falsee; };
+template <> struct KindOf<Nil> { static constexpr Kind value = Kind::Nil; };
+
+// One node of a saved tree, which can be read as whichever kind of node it is.
+class Record {
+public:
+  template <class T, class... Args>
+  explicit Record(std::in_place_type_t<T>, Args &&... args)
+    : kind_(KindOf<T>::value)
+  {
+    new (storage_) T(std::forward<Args>(args)...);
+  }
+
+  Kind kind() const { return kind_; }
+
+  template <class T>
+  const T &
+  get() const
+  {
+    ASSERT(kind_ == KindOf<T>::value && "Record holds a different kind of node");
+    return *std::launder(reinterpret_cast<const T *>(storage_));
+  }
+
+  // Calls `f` with the node, like `std::visit`.
+  template <class F>
+  decltype(auto)
+  visit(F &&f) const
+  {
+    switch (kind_) {
+    case Kind::BinOp: return f(get<BinOp>());
+    case Kind::UnaryOp: return f(get<UnaryOp>());
+    case Kind::String: return f(get<String>());
+    case Kind::Num: return f(get<Num>());
+    case Kind::Grouping: return f(get<Grouping>());
+    case Kind::Truee: return f(get<Truee>());
+    case Kind::Falsee: return f(get<Falsee>());
+    default: return f(get<Nil>());
+    }
+  }
+
+private:
+  // Zeroed so the padding saved to files doesn't depend on what was in memory before.
+  alignas(8) unsigned char storage_[16] = { };
+  Kind kind_;
+
+};
+
+static_assert(std::is_trivially_copyable_v<Record>, "Records are read straight from saved bytes");
+static_assert(sizeof(Record) <= 24, "Records have grown");
+
+// Checked when opening a saved tree. `VERSION` is for changes to how trees are saved, and
+// `SCHEMA` changes by itself whenever the nodes do.
+inline constexpr char MAGIC[8] = "LoxAST";
+inline constexpr uint32_t VERSION = 1;
+inline constexpr uint64_t SCHEMA = 0x85c171712661d577;
+
+// A saved tree is this header, then a `Record` for each node in the same order as the flat
+// tree it was saved from (so the last one is the root), then the bytes of its strings.
+// Numbers are in the byte order of the machine that saved it, so a tree saved on a machine
+// with the opposite byte order won't open (its version won't match).
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t nodeCount;
+  uint64_t schema;
+  uint64_t stringBytes;
+  // `hashBytes` of everything after the header.
+  uint64_t checksum;
+};
+
+static_assert(sizeof(Header) % alignof(Record) == 0, "Records after the header need to be aligned");
+
+// A saved tree, read where it is in memory: typically a file mapped by a `lexer::SourceBuffer`.
+// Opening it checks the whole thing, so nodes can then be read without any more checks, but
+// nothing is copied, so the saved bytes need to outlive the image.
+class Image {
+public:
+  // Throws `std::runtime_error` if `bytes` aren't a whole tree saved by this version of the
+  // code, or have been corrupted. They need to be aligned for a `Record`.
+  static Image open(std::string_view bytes);
+
+  const Record &operator[](Expr expr) const { return records_[expr.index]; }
+
+  Expr root() const { return { nodeCount_ - 1 }; }
+  size_t size() const { return nodeCount_; }
+  std::string_view string(StringRef ref) const { return { strings_ + ref.offset, ref.length }; }
+
+private:
+  Image(const Record *records, uint32_t nodeCount, const char *strings)
+    : records_(records)
+    , nodeCount_(nodeCount)
+    , strings_(strings)
+    { }
+
+  const Record *records_;
+  uint32_t nodeCount_;
+  const char *strings_;
+
+};
+
+// Gathers the strings of a tree being saved, keeping one copy of each.
+class StringTable {
+public:
+  StringRef
+  add(utils::Symbol symbol)
+  {
+    const auto [existing, isNew] = refs_.try_emplace(symbol);
+    if (isNew) {
+      const auto string = symbol.str();
+      existing->second = { static_cast<uint32_t>(bytes_.size()), static_cast<uint32_t>(string.size()) };
+      bytes_.append(string);
+    }
+    return existing->second;
+  }
+
+  const std::string &bytes() const { return bytes_; }
+
+private:
+  std::string bytes_;
+  std::unordered_map<utils::Symbol, StringRef> refs_;
+
+};
+
+namespace detail {
+
+inline bool
+isWellFormed(const BinOp &binOp, uint32_t index, uint64_t)
+{
+  return binOp.lhs().index < index
+    && static_cast<size_t>(binOp.operation()) < 10
+    && binOp.rhs().index < index;
+}
+
+inline bool
+isWellFormed(const UnaryOp &unaryOp, uint32_t index, uint64_t)
+{
+  return static_cast<size_t>(unaryOp.operation()) < 2
+    && unaryOp.child().index < index;
+}
+
+inline bool
+isWellFormed(const String &string, uint32_t, uint64_t stringBytes)
+{
+  return uint64_t(string.value().offset) + string.value().length <= stringBytes;
+}
+
+inline bool
+isWellFormed(const Num &, uint32_t, uint64_t)
+{
+  return true;
+}
+
+inline bool
+isWellFormed(const Grouping &grouping, uint32_t index, uint64_t)
+{
+  return grouping.child().index < index;
+}
+
+inline bool
+isWellFormed(const Truee &, uint32_t, uint64_t)
+{
+  return true;
+}
+
+inline bool
+isWellFormed(const Falsee &, uint32_t, uint64_t)
+{
+  return true;
+}
+
+inline bool
+isWellFormed(const Nil &, uint32_t, uint64_t)
+{
+  return true;
+}
+
+inline void
+save(const flat::BinOp &node, StringTable &, void *record)
+{
+  new (record) Record(std::in_place_type<BinOp>, Expr{ node.lhs().index }, node.operation(), Expr{ node.rhs().index }, node.id());
+}
+
+inline void
+save(const flat::UnaryOp &node, StringTable &, void *record)
+{
+  new (record) Record(std::in_place_type<UnaryOp>, node.operation(), Expr{ node.child().index }, node.id());
+}
+
+inline void
+save(const flat::String &node, StringTable &strings, void *record)
+{
+  new (record) Record(std::in_place_type<String>, strings.add(node.value()), node.id());
+}
+
+inline void
+save(const flat::Num &node, StringTable &, void *record)
+{
+  new (record) Record(std::in_place_type<Num>, node.value(), node.id());
+}
+
+inline void
+save(const flat::Grouping &node, StringTable &, void *record)
+{
+  new (record) Record(std::in_place_type<Grouping>, Expr{ node.child().index }, node.id());
+}
+
+inline void
+save(const flat::Truee &node, StringTable &, void *record)
+{
+  new (record) Record(std::in_place_type<Truee>, node.id());
+}
+
+inline void
+save(const flat::Falsee &node, StringTable &, void *record)
+{
+  new (record) Record(std::in_place_type<Falsee>, node.id());
+}
+
+inline void
+save(const flat::Nil &node, StringTable &, void *record)
+{
+  new (record) Record(std::in_place_type<Nil>, node.id());
+}
+
+inline flat::Expr
+load(const BinOp &binOp, const Image &, utils::StringInterner &, uint32_t first, flat::Tree &tree)
+{
+  return tree.add<flat::BinOp>(flat::Expr{ first + binOp.lhs().index }, binOp.operation(), flat::Expr{ first + binOp.rhs().index }, binOp.id());
+}
+
+inline flat::Expr
+load(const UnaryOp &unaryOp, const Image &, utils::StringInterner &, uint32_t first, flat::Tree &tree)
+{
+  return tree.add<flat::UnaryOp>(unaryOp.operation(), flat::Expr{ first + unaryOp.child().index }, unaryOp.id());
+}
+
+inline flat::Expr
+load(const String &string, const Image &image, utils::StringInterner &interner, uint32_t, flat::Tree &tree)
+{
+  return tree.add<flat::String>(interner.intern(image.string(string.value())), string.id());
+}
+
+inline flat::Expr
+load(const Num &num, const Image &, utils::StringInterner &, uint32_t, flat::Tree &tree)
+{
+  return tree.add<flat::Num>(num.value(), num.id());
+}
+
+inline flat::Expr
+load(const Grouping &grouping, const Image &, utils::StringInterner &, uint32_t first, flat::Tree &tree)
+{
+  return tree.add<flat::Grouping>(flat::Expr{ first + grouping.child().index }, grouping.id());
+}
+
+inline flat::Expr
+load(const Truee &truee, const Image &, utils::StringInterner &, uint32_t, flat::Tree &tree)
+{
+  return tree.add<flat::Truee>(truee.id());
+}
+
+inline flat::Expr
+load(const Falsee &falsee, const Image &, utils::StringInterner &, uint32_t, flat::Tree &tree)
+{
+  return tree.add<flat::Falsee>(falsee.id());
+}
+
+inline flat::Expr
+load(const Nil &nil, const Image &, utils::StringInterner &, uint32_t, flat::Tree &tree)
+{
+  return tree.add<flat::Nil>(nil.id());
+}
+
+}
+
+inline Image
+Image::open(std::string_view bytes)
+{
+  if (bytes.size() < sizeof(Header)) {
+    throw std::runtime_error("Saved tree is too short to have a header");
+  }
+  Header header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw std::runtime_error("Not a saved tree");
+  }
+  if (header.version != VERSION || header.schema != SCHEMA) {
+    throw std::runtime_error("Tree was saved by a different version");
+  }
+  const auto recordBytes = uint64_t(header.nodeCount) * sizeof(Record);
+  if (header.nodeCount == 0 || header.stringBytes > bytes.size()
+      || bytes.size() != sizeof(Header) + recordBytes + header.stringBytes) {
+    throw std::runtime_error("Saved tree is the wrong size");
+  }
+  if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(Record) != 0) {
+    throw std::runtime_error("Saved tree is not aligned");
+  }
+  if (hashBytes(bytes.data() + sizeof(Header), bytes.size() - sizeof(Header)) != header.checksum) {
+    throw std::runtime_error("Saved tree is corrupted");
+  }
+
+  const auto records = reinterpret_cast<const Record *>(bytes.data() + sizeof(Header));
+  for (uint32_t index = 0; index < header.nodeCount; ++index) {
+    const auto &record = records[index];
+    const bool isWellFormed = static_cast<size_t>(record.kind()) < 8 && record.visit([&](const auto &node) {
+      return detail::isWellFormed(node, index, header.stringBytes);
+    });
+    if (!isWellFormed) {
+      throw std::runtime_error("Saved tree is malformed");
+    }
+  }
+  return Image(records, header.nodeCount, bytes.data() + sizeof(Header) + recordBytes);
+}
+
+// Saves the whole of `tree` as bytes, ready to be written to a file and opened with `Image::open`.
+inline std::string
+save(const flat::Tree &tree)
+{
+  ASSERT(tree.size() > 0 && "Can't save an empty tree");
+  std::string bytes(sizeof(Header) + tree.size() * sizeof(Record), '\0');
+  StringTable strings;
+  for (uint32_t index = 0; index < tree.size(); ++index) {
+    const auto record = bytes.data() + sizeof(Header) + index * sizeof(Record);
+    std::visit([&](const auto &node) { detail::save(node, strings, record); }, tree[flat::Expr{ index }]);
+  }
+  bytes += strings.bytes();
+
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.nodeCount = static_cast<uint32_t>(tree.size());
+  header.schema = SCHEMA;
+  header.stringBytes = strings.bytes().size();
+  header.checksum = hashBytes(bytes.data() + sizeof(Header), bytes.size() - sizeof(Header));
+  std::memcpy(bytes.data(), &header, sizeof(header));
+  return bytes;
+}
+
+// Adds the nodes of a saved tree to `tree`, for when it needs to be changed, and returns the
+// root. Each string is interned, so this is slower than reading the saved tree in place.
+inline flat::Expr
+load(const Image &image, utils::StringInterner &interner, flat::Tree &tree)
+{
+  const auto first = static_cast<uint32_t>(tree.size());
+  tree.reserve(tree.size() + image.size());
+  for (uint32_t index = 0; index < image.size(); ++index) {
+    image[Expr{ index }].visit([&](const auto &node) { detail::load(node, image, interner, first, tree); });
+  }
+  return tree.root();
+}
+
+}
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <memory>
-#include <string>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "utils/Counter.hpp"
+#include "utils/Hash.hpp"
+#include "utils/StringInterner.hpp"
 
 namespace ast {
 
@@ -42,173 +46,287 @@ using Expr = std::variant<
 
 class BinOp {
 public:
-  enum class Op { Mult, Div, Add, Sub, GtEq, Gt, LtEq, Lt, Eq, Neq };
+  enum class Op : uint8_t { Mult, Div, Add, Sub, GtEq, Gt, LtEq, Lt, Eq, Neq };
 
   BinOp(
     Expr lhs,
     Op operation,
     Expr rhs,
-    size_t id
+    uint32_t id
   ): lhs_(std::move(lhs)),
-    operation_(std::move(operation)),
     rhs_(std::move(rhs)),
-    id_(std::move(id)) { }
+    id_(std::move(id)),
+    operation_(std::move(operation)) { }
+  ~BinOp();
 
   Expr &lhs() { return lhs_; }
   Op &operation() { return operation_; }
   Expr &rhs() { return rhs_; }
-  size_t &id() { return id_; }
+  uint32_t &id() { return id_; }
 
   const Expr &lhs() const { return lhs_; }
   const Op &operation() const { return operation_; }
   const Expr &rhs() const { return rhs_; }
-  const size_t &id() const { return id_; }
+  const uint32_t &id() const { return id_; }
 
 private:
   Expr lhs_;
-  Op operation_;
   Expr rhs_;
-  size_t id_;
+  uint32_t id_;
+  Op operation_;
 };
 
+static_assert(sizeof(BinOp) <= 40, "BinOp is bigger than its fields packed together");
+
 
 class UnaryOp {
 public:
-  enum class Op { Negate, Nott };
+  enum class Op : uint8_t { Negate, Nott };
 
   UnaryOp(
     Op operation,
     Expr child,
-    size_t id
-  ): operation_(std::move(operation)),
-    child_(std::move(child)),
-    id_(std::move(id)) { }
+    uint32_t id
+  ): child_(std::move(child)),
+    id_(std::move(id)),
+    operation_(std::move(operation)) { }
+  ~UnaryOp();
 
   Op &operation() { return operation_; }
   Expr &child() { return child_; }
-  size_t &id() { return id_; }
+  uint32_t &id() { return id_; }
 
   const Op &operation() const { return operation_; }
   const Expr &child() const { return child_; }
-  const size_t &id() const { return id_; }
+  const uint32_t &id() const { return id_; }
 
 private:
-  Op operation_;
   Expr child_;
-  size_t id_;
+  uint32_t id_;
+  Op operation_;
 };
 
+static_assert(sizeof(UnaryOp) <= 24, "UnaryOp is bigger than its fields packed together");
+
 
 class String {
 public:
 
   String(
-    std::string value,
-    size_t id
+    utils::Symbol value,
+    uint32_t id
   ): value_(std::move(value)),
     id_(std::move(id)) { }
 
-  std::string &value() { return value_; }
-  size_t &id() { return id_; }
+  utils::Symbol &value() { return value_; }
+  uint32_t &id() { return id_; }
 
-  const std::string &value() const { return value_; }
-  const size_t &id() const { return id_; }
+  const utils::Symbol &value() const { return value_; }
+  const uint32_t &id() const { return id_; }
 
 private:
-  std::string value_;
-  size_t id_;
+  utils::Symbol value_;
+  uint32_t id_;
 };
 
+static_assert(sizeof(String) <= 16, "String is bigger than its fields packed together");
+
 
 class Num {
 public:
 
   Num(
     double value,
-    size_t id
+    uint32_t id
   ): value_(std::move(value)),
     id_(std::move(id)) { }
 
   double &value() { return value_; }
-  size_t &id() { return id_; }
+  uint32_t &id() { return id_; }
 
   const double &value() const { return value_; }
-  const size_t &id() const { return id_; }
+  const uint32_t &id() const { return id_; }
 
 private:
   double value_;
-  size_t id_;
+  uint32_t id_;
 };
 
+static_assert(sizeof(Num) <= 16, "Num is bigger than its fields packed together");
+
 
 class Grouping {
 public:
 
   Grouping(
     Expr child,
-    size_t id
+    uint32_t id
   ): child_(std::move(child)),
     id_(std::move(id)) { }
+  ~Grouping();
 
   Expr &child() { return child_; }
-  size_t &id() { return id_; }
+  uint32_t &id() { return id_; }
 
   const Expr &child() const { return child_; }
-  const size_t &id() const { return id_; }
+  const uint32_t &id() const { return id_; }
 
 private:
   Expr child_;
-  size_t id_;
+  uint32_t id_;
 };
 
+static_assert(sizeof(Grouping) <= 24, "Grouping is bigger than its fields packed together");
+
 
 class Truee {
 public:
 
   Truee(
-    size_t id
+    uint32_t id
   ): id_(std::move(id)) { }
 
-  size_t &id() { return id_; }
+  uint32_t &id() { return id_; }
 
-  const size_t &id() const { return id_; }
+  const uint32_t &id() const { return id_; }
 
 private:
-  size_t id_;
+  uint32_t id_;
 };
 
+static_assert(sizeof(Truee) <= 4, "Truee is bigger than its fields packed together");
+
 
 class Falsee {
 public:
 
   Falsee(
-    size_t id
+    uint32_t id
   ): id_(std::move(id)) { }
 
-  size_t &id() { return id_; }
+  uint32_t &id() { return id_; }
 
-  const size_t &id() const { return id_; }
+  const uint32_t &id() const { return id_; }
 
 private:
-  size_t id_;
+  uint32_t id_;
 };
 
+static_assert(sizeof(Falsee) <= 4, "Falsee is bigger than its fields packed together");
+
 
 class Nil {
 public:
 
   Nil(
-    size_t id
+    uint32_t id
   ): id_(std::move(id)) { }
 
-  size_t &id() { return id_; }
+  uint32_t &id() { return id_; }
 
-  const size_t &id() const { return id_; }
+  const uint32_t &id() const { return id_; }
 
 private:
-  size_t id_;
+  uint32_t id_;
 };
 
+static_assert(sizeof(Nil) <= 4, "Nil is bigger than its fields packed together");
+
+namespace detail {
+
+// Moves a node's children onto `worklist`, so destroying the node won't destroy them.
+inline void
+takeChildren(BinOp &node, std::vector<Expr> &worklist)
+{
+  worklist.push_back(std::move(node.lhs()));
+  worklist.push_back(std::move(node.rhs()));
+}
+inline void
+takeChildren(UnaryOp &node, std::vector<Expr> &worklist)
+{
+  worklist.push_back(std::move(node.child()));
+}
+inline void takeChildren(String &, std::vector<Expr> &) { }
+inline void takeChildren(Num &, std::vector<Expr> &) { }
+inline void
+takeChildren(Grouping &node, std::vector<Expr> &worklist)
+{
+  worklist.push_back(std::move(node.child()));
+}
+inline void takeChildren(Truee &, std::vector<Expr> &) { }
+inline void takeChildren(Falsee &, std::vector<Expr> &) { }
+inline void takeChildren(Nil &, std::vector<Expr> &) { }
+
+// Whether destroying the node would destroy any nodes under it.
+inline bool hasChildren(const BinOpPtr &node) { return node != nullptr; }
+inline bool hasChildren(const UnaryOpPtr &node) { return node != nullptr; }
+inline bool hasChildren(const StringPtr &) { return false; }
+inline bool hasChildren(const NumPtr &) { return false; }
+inline bool hasChildren(const GroupingPtr &node) { return node != nullptr; }
+inline bool hasChildren(const TrueePtr &) { return false; }
+inline bool hasChildren(const FalseePtr &) { return false; }
+inline bool hasChildren(const NilPtr &) { return false; }
+
+inline bool
+hasChildren(const Expr &expr)
+{
+  return std::visit([](const auto &node) { return hasChildren(node); }, expr);
+}
+
+// Destroys the trees on `worklist` one node at a time, pushing each node's children
+// onto `worklist` before it goes.
+inline void
+destroyAll(std::vector<Expr> &worklist)
+{
+  while (!worklist.empty()) {
+    auto expr = std::move(worklist.back());
+    worklist.pop_back();
+    std::visit([&worklist](auto &node) {
+      if (node) {
+        takeChildren(*node, worklist);
+      }
+    }, expr);
+  }
+}
+
+}
+
+inline
+BinOp::~BinOp()
+{
+  // Not worth a worklist if the children can't recurse any further anyway.
+  if (!(detail::hasChildren(lhs_) || detail::hasChildren(rhs_))) {
+    return;
+  }
+  std::vector<Expr> worklist;
+  detail::takeChildren(*this, worklist);
+  detail::destroyAll(worklist);
+}
+
+inline
+UnaryOp::~UnaryOp()
+{
+  // Not worth a worklist if the children can't recurse any further anyway.
+  if (!(detail::hasChildren(child_))) {
+    return;
+  }
+  std::vector<Expr> worklist;
+  detail::takeChildren(*this, worklist);
+  detail::destroyAll(worklist);
+}
+
+inline
+Grouping::~Grouping()
+{
+  // Not worth a worklist if the children can't recurse any further anyway.
+  if (!(detail::hasChildren(child_))) {
+    return;
+  }
+  std::vector<Expr> worklist;
+  detail::takeChildren(*this, worklist);
+  detail::destroyAll(worklist);
+}
+
 BinOpPtr
 inline mult(
   Expr &&lhs,
@@ -219,12 +337,12 @@ inline mult(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::Mult,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -239,12 +357,12 @@ inline div(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::Div,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -259,12 +377,12 @@ inline add(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::Add,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -279,12 +397,12 @@ inline sub(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::Sub,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -299,12 +417,12 @@ inline gtEq(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::GtEq,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -319,12 +437,12 @@ inline gt(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::Gt,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -339,12 +457,12 @@ inline ltEq(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::LtEq,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -359,12 +477,12 @@ inline lt(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::Lt,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -379,12 +497,12 @@ inline eq(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::Eq,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -399,12 +517,12 @@ inline neq(
     Expr,
     BinOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(lhs),
     BinOp::Op::Neq,
     std::move(rhs),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -417,11 +535,11 @@ inline negate(
     UnaryOp,
     UnaryOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     UnaryOp::Op::Negate,
     std::move(child),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -434,26 +552,26 @@ inline nott(
     UnaryOp,
     UnaryOp::Op,
     Expr,
-    size_t
+    uint32_t
   >(
     UnaryOp::Op::Nott,
     std::move(child),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
 
 StringPtr
 inline string(
-  std::string &&value
+  utils::Symbol &&value
 ) {
   return std::make_unique<
     String,
-    std::string,
-    size_t
+    utils::Symbol,
+    uint32_t
   >(
     std::move(value),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -465,10 +583,10 @@ inline num(
   return std::make_unique<
     Num,
     double,
-    size_t
+    uint32_t
   >(
     std::move(value),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -480,10 +598,10 @@ inline grouping(
   return std::make_unique<
     Grouping,
     Expr,
-    size_t
+    uint32_t
   >(
     std::move(child),
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -494,9 +612,9 @@ inline truee(
 ) {
   return std::make_unique<
     Truee,
-    size_t
+    uint32_t
   >(
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -507,9 +625,9 @@ inline falsee(
 ) {
   return std::make_unique<
     Falsee,
-    size_t
+    uint32_t
   >(
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
@@ -520,12 +638,259 @@ inline nil(
 ) {
   return std::make_unique<
     Nil,
-    size_t
+    uint32_t
   >(
-    Counter::next()
+    Counter::nextShared()
   );
 }
 
+class Factory {
+public:
+  using Expr = ::ast::Expr;
+
+  explicit Factory(Counter &ids)
+    : ids_(ids)
+    { }
+
+  BinOpPtr
+  binOp(Expr &&lhs, BinOp::Op &&operation, Expr &&rhs)
+  {
+    return std::make_unique<BinOp>(
+      std::move(lhs),
+      std::move(operation),
+      std::move(rhs),
+      ids_.next()
+    );
+  }
+
+  UnaryOpPtr
+  unaryOp(UnaryOp::Op &&operation, Expr &&child)
+  {
+    return std::make_unique<UnaryOp>(
+      std::move(operation),
+      std::move(child),
+      ids_.next()
+    );
+  }
+
+  StringPtr
+  string(utils::Symbol &&value)
+  {
+    return std::make_unique<String>(
+      std::move(value),
+      ids_.next()
+    );
+  }
+
+  NumPtr
+  num(double &&value)
+  {
+    return std::make_unique<Num>(
+      std::move(value),
+      ids_.next()
+    );
+  }
+
+  GroupingPtr
+  grouping(Expr &&child)
+  {
+    return std::make_unique<Grouping>(
+      std::move(child),
+      ids_.next()
+    );
+  }
+
+  TrueePtr
+  truee()
+  {
+    return std::make_unique<Truee>(
+      ids_.next()
+    );
+  }
+
+  FalseePtr
+  falsee()
+  {
+    return std::make_unique<Falsee>(
+      ids_.next()
+    );
+  }
+
+  NilPtr
+  nil()
+  {
+    return std::make_unique<Nil>(
+      ids_.next()
+    );
+  }
+
+private:
+  Counter &ids_;
+
+};
+
+namespace detail {
+
+// What a node adds to its tree's structural hash besides its children: its kind, and its
+// other fields.
+inline size_t
+structuralHashOf(const BinOp &binOp)
+{
+  size_t seed = 0;
+  seed = hashCombine(seed, std::hash<BinOp::Op>()(binOp.operation()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const UnaryOp &unaryOp)
+{
+  size_t seed = 1;
+  seed = hashCombine(seed, std::hash<UnaryOp::Op>()(unaryOp.operation()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const String &string)
+{
+  size_t seed = 2;
+  seed = hashCombine(seed, std::hash<utils::Symbol>()(string.value()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const Num &num)
+{
+  size_t seed = 3;
+  seed = hashCombine(seed, std::hash<uint64_t>()(bitPattern(num.value())));
+  return seed;
+}
+
+inline size_t structuralHashOf(const Grouping &) { return 4; }
+
+inline size_t structuralHashOf(const Truee &) { return 5; }
+
+inline size_t structuralHashOf(const Falsee &) { return 6; }
+
+inline size_t structuralHashOf(const Nil &) { return 7; }
+
+// Whether two nodes of the same kind have the same fields, leaving aside their children.
+inline bool
+sameFields(const BinOp &lhs, const BinOp &rhs)
+{
+  return lhs.operation() == rhs.operation();
+}
+
+inline bool
+sameFields(const UnaryOp &lhs, const UnaryOp &rhs)
+{
+  return lhs.operation() == rhs.operation();
+}
+
+inline bool
+sameFields(const String &lhs, const String &rhs)
+{
+  return lhs.value() == rhs.value();
+}
+
+inline bool
+sameFields(const Num &lhs, const Num &rhs)
+{
+  return bitPattern(lhs.value()) == bitPattern(rhs.value());
+}
+
+inline bool sameFields(const Grouping &, const Grouping &) { return true; }
+
+inline bool sameFields(const Truee &, const Truee &) { return true; }
+
+inline bool sameFields(const Falsee &, const Falsee &) { return true; }
+
+inline bool sameFields(const Nil &, const Nil &) { return true; }
+
+// Pushes a node's children onto `stack`, to be walked after it.
+inline void
+pushChildren(const BinOp &binOp, std::vector<const Expr *> &stack)
+{
+  stack.push_back(&binOp.rhs());
+  stack.push_back(&binOp.lhs());
+}
+
+inline void
+pushChildren(const UnaryOp &unaryOp, std::vector<const Expr *> &stack)
+{
+  stack.push_back(&unaryOp.child());
+}
+
+inline void pushChildren(const String &, std::vector<const Expr *> &) { }
+
+inline void pushChildren(const Num &, std::vector<const Expr *> &) { }
+
+inline void
+pushChildren(const Grouping &grouping, std::vector<const Expr *> &stack)
+{
+  stack.push_back(&grouping.child());
+}
+
+inline void pushChildren(const Truee &, std::vector<const Expr *> &) { }
+
+inline void pushChildren(const Falsee &, std::vector<const Expr *> &) { }
+
+inline void pushChildren(const Nil &, std::vector<const Expr *> &) { }
+
+}
+
+// Equal trees have equal hashes, and trees are equal if they have the same kinds of node
+// in the same places, with the same values in them. Ids don't count.
+inline size_t
+structuralHash(const Expr &expr)
+{
+  // The nodes come off the stack in preorder, and each kind of node always has the same
+  // number of children, so the order the nodes are hashed in is enough to tell shapes apart.
+  size_t seed = 0;
+  std::vector<const Expr *> stack{ &expr };
+  while (!stack.empty()) {
+    const Expr *next = stack.back();
+    stack.pop_back();
+    std::visit([&](const auto &node) {
+      seed = hashCombine(seed, detail::structuralHashOf(*node));
+      detail::pushChildren(*node, stack);
+    }, *next);
+  }
+  return seed;
+}
+
+inline bool
+structurallyEqual(const Expr &lhs, const Expr &rhs)
+{
+  // Children are only pushed once their parents are known to be the same kind, so the two
+  // stacks always hold the same number of nodes.
+  std::vector<const Expr *> lhsStack{ &lhs };
+  std::vector<const Expr *> rhsStack{ &rhs };
+  while (!lhsStack.empty()) {
+    const Expr *lhsNext = lhsStack.back();
+    const Expr *rhsNext = rhsStack.back();
+    lhsStack.pop_back();
+    rhsStack.pop_back();
+    const auto &lhsNode = *lhsNext;
+    const auto &rhsNode = *rhsNext;
+    if (lhsNode.index() != rhsNode.index()) {
+      return false;
+    }
+    const bool same = std::visit([&](const auto &node) {
+      const auto &other = *std::get<std::decay_t<decltype(node)>>(rhsNode);
+      if (!detail::sameFields(*node, other)) {
+        return false;
+      }
+      detail::pushChildren(*node, lhsStack);
+      detail::pushChildren(other, rhsStack);
+      return true;
+    }, lhsNode);
+    if (!same) {
+      return false;
+    }
+  }
+  return true;
+}
+
 template <class T>
 class Visitor {
 public:
@@ -586,5 +951,182 @@ public:
     return std::visit(*this, expr);
   }
 
+};
+
+// Derive from this as `class V : public StaticVisitor<V, T>`, and give `V` a `visitX` method for
+// each node. If `V` derives privately or the methods are private, it needs to be friends
+// with `StaticVisitor<V, T>`.
+template <class Derived, class T>
+class StaticVisitor {
+public:
+  T operator()(std::unique_ptr<BinOp> &binOp) { return derived().visitBinOp(*binOp); }
+  T operator()(std::unique_ptr<UnaryOp> &unaryOp) { return derived().visitUnaryOp(*unaryOp); }
+  T operator()(std::unique_ptr<String> &string) { return derived().visitString(*string); }
+  T operator()(std::unique_ptr<Num> &num) { return derived().visitNum(*num); }
+  T operator()(std::unique_ptr<Grouping> &grouping) { return derived().visitGrouping(*grouping); }
+  T operator()(std::unique_ptr<Truee> &truee) { return derived().visitTruee(*truee); }
+  T operator()(std::unique_ptr<Falsee> &falsee) { return derived().visitFalsee(*falsee); }
+  T operator()(std::unique_ptr<Nil> &nil) { return derived().visitNil(*nil); }
+
+  T
+  visit(Expr &expr)
+  {
+    return std::visit(*this, expr);
+  }
+
+private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+};
+
+// Derive from this as `class V : public StaticConstVisitor<V, T>`, and give `V` a `visitX` method for
+// each node. If `V` derives privately or the methods are private, it needs to be friends
+// with `StaticConstVisitor<V, T>`.
+template <class Derived, class T>
+class StaticConstVisitor {
+public:
+  T operator()(const std::unique_ptr<BinOp> &binOp) { return derived().visitBinOp(*binOp); }
+  T operator()(const std::unique_ptr<UnaryOp> &unaryOp) { return derived().visitUnaryOp(*unaryOp); }
+  T operator()(const std::unique_ptr<String> &string) { return derived().visitString(*string); }
+  T operator()(const std::unique_ptr<Num> &num) { return derived().visitNum(*num); }
+  T operator()(const std::unique_ptr<Grouping> &grouping) { return derived().visitGrouping(*grouping); }
+  T operator()(const std::unique_ptr<Truee> &truee) { return derived().visitTruee(*truee); }
+  T operator()(const std::unique_ptr<Falsee> &falsee) { return derived().visitFalsee(*falsee); }
+  T operator()(const std::unique_ptr<Nil> &nil) { return derived().visitNil(*nil); }
+
+  T
+  visit(const Expr &expr)
+  {
+    return std::visit(*this, expr);
+  }
+
+private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+};
+
+// Derive from this as `class T : public ConstTraversal<T>`, and give `T` the callbacks it
+// needs (the rest do nothing): `visitX` for each leaf node, and `enterX`, `betweenX` (between
+// children) and `leaveX` for each node with children. Like the static visitors, `T` needs to be
+// friends with `ConstTraversal<T>` if it derives privately or the callbacks are private.
+// The stack is kept between traversals, so reusing a traversal doesn't reallocate it.
+template <class Derived>
+class ConstTraversal {
+public:
+  void
+  traverse(const Expr &expr)
+  {
+    run(&expr);
+  }
+
+  void enterBinOp(const BinOp &) { }
+  void betweenBinOp(const BinOp &) { }
+  void leaveBinOp(const BinOp &) { }
+  void enterUnaryOp(const UnaryOp &) { }
+  void leaveUnaryOp(const UnaryOp &) { }
+  void visitString(const String &) { }
+  void visitNum(const Num &) { }
+  void enterGrouping(const Grouping &) { }
+  void leaveGrouping(const Grouping &) { }
+  void visitTruee(const Truee &) { }
+  void visitFalsee(const Falsee &) { }
+  void visitNil(const Nil &) { }
+
+private:
+  struct Entry {
+    const void *node;
+    // Which of the `Expr` alternatives the node is.
+    uint32_t kind;
+    // How many of its children have been started.
+    uint32_t phase;
+  };
+
+  std::vector<Entry> stack_;
+
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+  void
+  run(const Expr *expr)
+  {
+    // Left over if a callback threw partway through the last traversal.
+    stack_.clear();
+    descend(expr);
+    while (!stack_.empty()) {
+      const auto entry = stack_.back();
+      switch (entry.kind) {
+      case 0: resume(*static_cast<const BinOp *>(entry.node), entry.phase); break;
+      case 1: resume(*static_cast<const UnaryOp *>(entry.node), entry.phase); break;
+      case 4: resume(*static_cast<const Grouping *>(entry.node), entry.phase); break;
+      }
+    }
+  }
+
+  // Starts nodes down to the first leaf, leaving the ones with more children on the stack.
+  void
+  descend(const Expr *expr)
+  {
+    while (expr) {
+      expr = std::visit([this](const auto &node) { return start(*node); }, *expr);
+    }
+  }
+
+  const Expr *
+  start(const BinOp &binOp)
+  {
+    derived().enterBinOp(binOp);
+    stack_.push_back({ &binOp, 0, 1 });
+    return &binOp.lhs();
+  }
+
+  const Expr *
+  start(const UnaryOp &unaryOp)
+  {
+    derived().enterUnaryOp(unaryOp);
+    stack_.push_back({ &unaryOp, 1, 1 });
+    return &unaryOp.child();
+  }
+
+  const Expr *
+  start(const Grouping &grouping)
+  {
+    derived().enterGrouping(grouping);
+    stack_.push_back({ &grouping, 4, 1 });
+    return &grouping.child();
+  }
+
+  const Expr *start(const String &string) { derived().visitString(string); return nullptr; }
+  const Expr *start(const Num &num) { derived().visitNum(num); return nullptr; }
+  const Expr *start(const Truee &truee) { derived().visitTruee(truee); return nullptr; }
+  const Expr *start(const Falsee &falsee) { derived().visitFalsee(falsee); return nullptr; }
+  const Expr *start(const Nil &nil) { derived().visitNil(nil); return nullptr; }
+
+  void
+  resume(const BinOp &binOp, uint32_t phase)
+  {
+    switch (phase) {
+    case 1:
+      ++stack_.back().phase;
+      derived().betweenBinOp(binOp);
+      return descend(&binOp.rhs());
+    default:
+      stack_.pop_back();
+      derived().leaveBinOp(binOp);
+    }
+  }
+
+  void
+  resume(const UnaryOp &unaryOp, uint32_t)
+  {
+    stack_.pop_back();
+    derived().leaveUnaryOp(unaryOp);
+  }
+
+  void
+  resume(const Grouping &grouping, uint32_t)
+  {
+    stack_.pop_back();
+    derived().leaveGrouping(grouping);
+  }
+
 };
 }
@@ -0,0 +1,1231 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "ast/Expr.hpp"
+#include "utils/Counter.hpp"
+#include "utils/Hash.hpp"
+#include "utils/StringInterner.hpp"
+
+namespace ast::flat {
+
+// Forward declarations are needed because the superclass and subclasses mutually refer to each other.
+class BinOp;
+class UnaryOp;
+class String;
+class Num;
+class Grouping;
+class Truee;
+class Falsee;
+class Nil;
+
+// A node in a `Tree`, as its index in the tree's table of nodes.
+struct Expr {
+  uint32_t index;
+
+  bool operator==(Expr other) const { return index == other.index; }
+  bool operator!=(Expr other) const { return index != other.index; }
+};
+
+
+class BinOp {
+public:
+  using Op = ::ast::BinOp::Op;
+
+  BinOp(
+    Expr lhs,
+    Op operation,
+    Expr rhs,
+    uint32_t id
+  ): lhs_(std::move(lhs)),
+    rhs_(std::move(rhs)),
+    id_(std::move(id)),
+    operation_(std::move(operation)) { }
+
+  Expr &lhs() { return lhs_; }
+  Op &operation() { return operation_; }
+  Expr &rhs() { return rhs_; }
+  uint32_t &id() { return id_; }
+
+  const Expr &lhs() const { return lhs_; }
+  const Op &operation() const { return operation_; }
+  const Expr &rhs() const { return rhs_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr lhs_;
+  Expr rhs_;
+  uint32_t id_;
+  Op operation_;
+};
+
+static_assert(sizeof(BinOp) <= 16, "BinOp is bigger than its fields packed together");
+
+
+class UnaryOp {
+public:
+  using Op = ::ast::UnaryOp::Op;
+
+  UnaryOp(
+    Op operation,
+    Expr child,
+    uint32_t id
+  ): child_(std::move(child)),
+    id_(std::move(id)),
+    operation_(std::move(operation)) { }
+
+  Op &operation() { return operation_; }
+  Expr &child() { return child_; }
+  uint32_t &id() { return id_; }
+
+  const Op &operation() const { return operation_; }
+  const Expr &child() const { return child_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr child_;
+  uint32_t id_;
+  Op operation_;
+};
+
+static_assert(sizeof(UnaryOp) <= 12, "UnaryOp is bigger than its fields packed together");
+
+
+class String {
+public:
+
+  String(
+    utils::Symbol value,
+    uint32_t id
+  ): value_(std::move(value)),
+    id_(std::move(id)) { }
+
+  utils::Symbol &value() { return value_; }
+  uint32_t &id() { return id_; }
+
+  const utils::Symbol &value() const { return value_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  utils::Symbol value_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(String) <= 16, "String is bigger than its fields packed together");
+
+
+class Num {
+public:
+
+  Num(
+    double value,
+    uint32_t id
+  ): value_(std::move(value)),
+    id_(std::move(id)) { }
+
+  double &value() { return value_; }
+  uint32_t &id() { return id_; }
+
+  const double &value() const { return value_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  double value_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(Num) <= 16, "Num is bigger than its fields packed together");
+
+
+class Grouping {
+public:
+
+  Grouping(
+    Expr child,
+    uint32_t id
+  ): child_(std::move(child)),
+    id_(std::move(id)) { }
+
+  Expr &child() { return child_; }
+  uint32_t &id() { return id_; }
+
+  const Expr &child() const { return child_; }
+  const uint32_t &id() const { return id_; }
+
+private:
+  Expr child_;
+  uint32_t id_;
+};
+
+static_assert(sizeof(Grouping) <= 8, "Grouping is bigger than its fields packed together");
+
+
+class Truee {
+public:
+
+  Truee(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Truee) <= 4, "Truee is bigger than its fields packed together");
+
+
+class Falsee {
+public:
+
+  Falsee(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Falsee) <= 4, "Falsee is bigger than its fields packed together");
+
+
+class Nil {
+public:
+
+  Nil(
+    uint32_t id
+  ): id_(std::move(id)) { }
+
+  uint32_t &id() { return id_; }
+
+  const uint32_t &id() const { return id_; }
+
+private:
+  uint32_t id_;
+};
+
+static_assert(sizeof(Nil) <= 4, "Nil is bigger than its fields packed together");
+
+using Node = std::variant<
+  BinOp,
+  UnaryOp,
+  String,
+  Num,
+  Grouping,
+  Truee,
+  Falsee,
+  Nil
+>;
+
+// The biggest node plus the variant's index, rounded up to the alignment.
+static_assert(sizeof(Node) <= 24, "Flat tree nodes have grown");
+
+// Owns the nodes of a tree in one table, in the order they were made. Children have
+// to be made before their parents (so the nodes are in post-order), which means the
+// last node made is the root.
+class Tree {
+public:
+  template <class T, class... Args>
+  Expr
+  add(Args &&... args)
+  {
+    nodes_.emplace_back(std::in_place_type<T>, std::forward<Args>(args)...);
+    return { static_cast<uint32_t>(nodes_.size() - 1) };
+  }
+
+  Expr
+  add(Node &&node)
+  {
+    nodes_.push_back(std::move(node));
+    return { static_cast<uint32_t>(nodes_.size() - 1) };
+  }
+
+  Node &operator[](Expr expr) { return nodes_[expr.index]; }
+  const Node &operator[](Expr expr) const { return nodes_[expr.index]; }
+
+  Expr root() const { return { static_cast<uint32_t>(nodes_.size() - 1) }; }
+  size_t size() const { return nodes_.size(); }
+  void reserve(size_t nodeCount) { nodes_.reserve(nodeCount); }
+  // Bytes of memory allocated to hold the nodes.
+  size_t memoryUsage() const { return nodes_.capacity() * sizeof(Node); }
+
+private:
+  std::vector<Node> nodes_;
+
+};
+
+Expr
+inline mult(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Mult,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline div(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Div,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline add(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Add,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline sub(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Sub,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline gtEq(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::GtEq,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline gt(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Gt,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline ltEq(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::LtEq,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline lt(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Lt,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline eq(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Eq,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline neq(
+  Tree &tree,
+  Expr &&lhs,
+  Expr &&rhs
+) {
+  return tree.add<BinOp>(
+    std::move(lhs),
+    BinOp::Op::Neq,
+    std::move(rhs),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline negate(
+  Tree &tree,
+  Expr &&child
+) {
+  return tree.add<UnaryOp>(
+    UnaryOp::Op::Negate,
+    std::move(child),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline nott(
+  Tree &tree,
+  Expr &&child
+) {
+  return tree.add<UnaryOp>(
+    UnaryOp::Op::Nott,
+    std::move(child),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline string(
+  Tree &tree,
+  utils::Symbol &&value
+) {
+  return tree.add<String>(
+    std::move(value),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline num(
+  Tree &tree,
+  double &&value
+) {
+  return tree.add<Num>(
+    std::move(value),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline grouping(
+  Tree &tree,
+  Expr &&child
+) {
+  return tree.add<Grouping>(
+    std::move(child),
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline truee(
+  Tree &tree
+) {
+  return tree.add<Truee>(
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline falsee(
+  Tree &tree
+) {
+  return tree.add<Falsee>(
+    Counter::nextShared()
+  );
+}
+
+
+Expr
+inline nil(
+  Tree &tree
+) {
+  return tree.add<Nil>(
+    Counter::nextShared()
+  );
+}
+
+class Factory {
+public:
+  using Expr = ::ast::flat::Expr;
+
+  Factory(Tree &tree, Counter &ids)
+    : tree_(tree)
+    , ids_(ids)
+    { }
+
+  Expr
+  binOp(Expr &&lhs, BinOp::Op &&operation, Expr &&rhs)
+  {
+    return tree_.add<BinOp>(
+      std::move(lhs),
+      std::move(operation),
+      std::move(rhs),
+      ids_.next()
+    );
+  }
+
+  Expr
+  unaryOp(UnaryOp::Op &&operation, Expr &&child)
+  {
+    return tree_.add<UnaryOp>(
+      std::move(operation),
+      std::move(child),
+      ids_.next()
+    );
+  }
+
+  Expr
+  string(utils::Symbol &&value)
+  {
+    return tree_.add<String>(
+      std::move(value),
+      ids_.next()
+    );
+  }
+
+  Expr
+  num(double &&value)
+  {
+    return tree_.add<Num>(
+      std::move(value),
+      ids_.next()
+    );
+  }
+
+  Expr
+  grouping(Expr &&child)
+  {
+    return tree_.add<Grouping>(
+      std::move(child),
+      ids_.next()
+    );
+  }
+
+  Expr
+  truee()
+  {
+    return tree_.add<Truee>(
+      ids_.next()
+    );
+  }
+
+  Expr
+  falsee()
+  {
+    return tree_.add<Falsee>(
+      ids_.next()
+    );
+  }
+
+  Expr
+  nil()
+  {
+    return tree_.add<Nil>(
+      ids_.next()
+    );
+  }
+
+private:
+  Tree &tree_;
+  Counter &ids_;
+
+};
+
+namespace detail {
+
+// What a node adds to its tree's structural hash besides its children: its kind, and its
+// other fields.
+inline size_t
+structuralHashOf(const BinOp &binOp)
+{
+  size_t seed = 0;
+  seed = hashCombine(seed, std::hash<BinOp::Op>()(binOp.operation()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const UnaryOp &unaryOp)
+{
+  size_t seed = 1;
+  seed = hashCombine(seed, std::hash<UnaryOp::Op>()(unaryOp.operation()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const String &string)
+{
+  size_t seed = 2;
+  seed = hashCombine(seed, std::hash<utils::Symbol>()(string.value()));
+  return seed;
+}
+
+inline size_t
+structuralHashOf(const Num &num)
+{
+  size_t seed = 3;
+  seed = hashCombine(seed, std::hash<uint64_t>()(bitPattern(num.value())));
+  return seed;
+}
+
+inline size_t structuralHashOf(const Grouping &) { return 4; }
+
+inline size_t structuralHashOf(const Truee &) { return 5; }
+
+inline size_t structuralHashOf(const Falsee &) { return 6; }
+
+inline size_t structuralHashOf(const Nil &) { return 7; }
+
+// Whether two nodes of the same kind have the same fields, leaving aside their children.
+inline bool
+sameFields(const BinOp &lhs, const BinOp &rhs)
+{
+  return lhs.operation() == rhs.operation();
+}
+
+inline bool
+sameFields(const UnaryOp &lhs, const UnaryOp &rhs)
+{
+  return lhs.operation() == rhs.operation();
+}
+
+inline bool
+sameFields(const String &lhs, const String &rhs)
+{
+  return lhs.value() == rhs.value();
+}
+
+inline bool
+sameFields(const Num &lhs, const Num &rhs)
+{
+  return bitPattern(lhs.value()) == bitPattern(rhs.value());
+}
+
+inline bool sameFields(const Grouping &, const Grouping &) { return true; }
+
+inline bool sameFields(const Truee &, const Truee &) { return true; }
+
+inline bool sameFields(const Falsee &, const Falsee &) { return true; }
+
+inline bool sameFields(const Nil &, const Nil &) { return true; }
+
+// Pushes a node's children onto `stack`, to be walked after it.
+inline void
+pushChildren(const BinOp &binOp, std::vector<Expr> &stack)
+{
+  stack.push_back(binOp.rhs());
+  stack.push_back(binOp.lhs());
+}
+
+inline void
+pushChildren(const UnaryOp &unaryOp, std::vector<Expr> &stack)
+{
+  stack.push_back(unaryOp.child());
+}
+
+inline void pushChildren(const String &, std::vector<Expr> &) { }
+
+inline void pushChildren(const Num &, std::vector<Expr> &) { }
+
+inline void
+pushChildren(const Grouping &grouping, std::vector<Expr> &stack)
+{
+  stack.push_back(grouping.child());
+}
+
+inline void pushChildren(const Truee &, std::vector<Expr> &) { }
+
+inline void pushChildren(const Falsee &, std::vector<Expr> &) { }
+
+inline void pushChildren(const Nil &, std::vector<Expr> &) { }
+
+}
+
+// Equal trees have equal hashes, and trees are equal if they have the same kinds of node
+// in the same places, with the same values in them. Ids don't count.
+inline size_t
+structuralHash(const Tree &tree, Expr expr)
+{
+  // The nodes come off the stack in preorder, and each kind of node always has the same
+  // number of children, so the order the nodes are hashed in is enough to tell shapes apart.
+  size_t seed = 0;
+  std::vector<Expr> stack{ expr };
+  while (!stack.empty()) {
+    const Expr next = stack.back();
+    stack.pop_back();
+    std::visit([&](const auto &node) {
+      seed = hashCombine(seed, detail::structuralHashOf(node));
+      detail::pushChildren(node, stack);
+    }, tree[next]);
+  }
+  return seed;
+}
+
+inline bool
+structurallyEqual(const Tree &lhsTree, Expr lhs, const Tree &rhsTree, Expr rhs)
+{
+  // Children are only pushed once their parents are known to be the same kind, so the two
+  // stacks always hold the same number of nodes.
+  std::vector<Expr> lhsStack{ lhs };
+  std::vector<Expr> rhsStack{ rhs };
+  while (!lhsStack.empty()) {
+    const Expr lhsNext = lhsStack.back();
+    const Expr rhsNext = rhsStack.back();
+    lhsStack.pop_back();
+    rhsStack.pop_back();
+    const auto &lhsNode = lhsTree[lhsNext];
+    const auto &rhsNode = rhsTree[rhsNext];
+    if (lhsNode.index() != rhsNode.index()) {
+      return false;
+    }
+    const bool same = std::visit([&](const auto &node) {
+      const auto &other = std::get<std::decay_t<decltype(node)>>(rhsNode);
+      if (!detail::sameFields(node, other)) {
+        return false;
+      }
+      detail::pushChildren(node, lhsStack);
+      detail::pushChildren(other, rhsStack);
+      return true;
+    }, lhsNode);
+    if (!same) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Hashes and compares nodes by their own fields and their children's indices, but not by
+// automatically provided fields (ids). See `SharingFactory`.
+struct ShallowHash {
+  size_t
+  operator()(const Node &node) const
+  {
+    return hashCombine(node.index(), std::visit(*this, node));
+  }
+
+  size_t
+  operator()(const BinOp &node) const
+  {
+    size_t seed = 0;
+    seed = hashCombine(seed, node.lhs().index);
+    seed = hashCombine(seed, std::hash<BinOp::Op>()(node.operation()));
+    seed = hashCombine(seed, node.rhs().index);
+    return seed;
+  }
+
+  size_t
+  operator()(const UnaryOp &node) const
+  {
+    size_t seed = 0;
+    seed = hashCombine(seed, std::hash<UnaryOp::Op>()(node.operation()));
+    seed = hashCombine(seed, node.child().index);
+    return seed;
+  }
+
+  size_t
+  operator()(const String &node) const
+  {
+    size_t seed = 0;
+    seed = hashCombine(seed, std::hash<utils::Symbol>()(node.value()));
+    return seed;
+  }
+
+  size_t
+  operator()(const Num &node) const
+  {
+    size_t seed = 0;
+    seed = hashCombine(seed, std::hash<uint64_t>()(bitPattern(node.value())));
+    return seed;
+  }
+
+  size_t
+  operator()(const Grouping &node) const
+  {
+    size_t seed = 0;
+    seed = hashCombine(seed, node.child().index);
+    return seed;
+  }
+
+  size_t operator()(const Truee &) const { return 0; }
+
+  size_t operator()(const Falsee &) const { return 0; }
+
+  size_t operator()(const Nil &) const { return 0; }
+
+};
+
+struct ShallowEqual {
+  bool
+  operator()(const Node &lhs, const Node &rhs) const
+  {
+    if (lhs.index() != rhs.index()) {
+      return false;
+    }
+    return std::visit([&](const auto &node) {
+      return (*this)(node, std::get<std::decay_t<decltype(node)>>(rhs));
+    }, lhs);
+  }
+
+
+  bool
+  operator()(const BinOp &lhs, const BinOp &rhs) const
+  {
+    return lhs.lhs() == rhs.lhs()
+      && lhs.operation() == rhs.operation()
+      && lhs.rhs() == rhs.rhs();
+  }
+
+  bool
+  operator()(const UnaryOp &lhs, const UnaryOp &rhs) const
+  {
+    return lhs.operation() == rhs.operation()
+      && lhs.child() == rhs.child();
+  }
+
+  bool
+  operator()(const String &lhs, const String &rhs) const
+  {
+    return lhs.value() == rhs.value();
+  }
+
+  bool
+  operator()(const Num &lhs, const Num &rhs) const
+  {
+    return bitPattern(lhs.value()) == bitPattern(rhs.value());
+  }
+
+  bool
+  operator()(const Grouping &lhs, const Grouping &rhs) const
+  {
+    return lhs.child() == rhs.child();
+  }
+
+  bool operator()(const Truee &, const Truee &) const { return true; }
+
+  bool operator()(const Falsee &, const Falsee &) const { return true; }
+
+  bool operator()(const Nil &, const Nil &) const { return true; }
+
+};
+
+// Like `Factory`, but shares identical subtrees (hash-consing), which turns the tree into a
+// DAG. Only nodes made by the same factory are shared.
+class SharingFactory {
+public:
+  using Expr = ::ast::flat::Expr;
+
+  SharingFactory(Tree &tree, Counter &ids)
+    : tree_(tree)
+    , ids_(ids)
+    { }
+
+  Expr
+  binOp(Expr &&lhs, BinOp::Op &&operation, Expr &&rhs)
+  {
+    return share(BinOp(std::move(lhs), std::move(operation), std::move(rhs), {}));
+  }
+
+  Expr
+  unaryOp(UnaryOp::Op &&operation, Expr &&child)
+  {
+    return share(UnaryOp(std::move(operation), std::move(child), {}));
+  }
+
+  Expr
+  string(utils::Symbol &&value)
+  {
+    return share(String(std::move(value), {}));
+  }
+
+  Expr
+  num(double &&value)
+  {
+    return share(Num(std::move(value), {}));
+  }
+
+  Expr
+  grouping(Expr &&child)
+  {
+    return share(Grouping(std::move(child), {}));
+  }
+
+  Expr
+  truee()
+  {
+    return share(Truee({}));
+  }
+
+  Expr
+  falsee()
+  {
+    return share(Falsee({}));
+  }
+
+  Expr
+  nil()
+  {
+    return share(Nil({}));
+  }
+
+private:
+  Tree &tree_;
+  Counter &ids_;
+  std::unordered_map<Node, Expr, ShallowHash, ShallowEqual> shared_;
+
+  Expr
+  share(Node &&candidate)
+  {
+    const auto [existing, isNew] = shared_.try_emplace(std::move(candidate), Expr{ static_cast<uint32_t>(tree_.size()) });
+    if (isNew) {
+      Node node = existing->first;
+      std::visit([this](auto &node) {
+          node.id() = ids_.next();
+        }, node);
+      tree_.add(std::move(node));
+    }
+    return existing->second;
+  }
+
+};
+
+template <class T>
+class Visitor {
+public:
+  virtual ~Visitor() =default;
+
+  virtual T visitBinOp(BinOp &binOp) =0;
+  virtual T visitUnaryOp(UnaryOp &unaryOp) =0;
+  virtual T visitString(String &string) =0;
+  virtual T visitNum(Num &num) =0;
+  virtual T visitGrouping(Grouping &grouping) =0;
+  virtual T visitTruee(Truee &truee) =0;
+  virtual T visitFalsee(Falsee &falsee) =0;
+  virtual T visitNil(Nil &nil) =0;
+
+  T operator()(BinOp &binOp) { return visitBinOp(binOp); }
+  T operator()(UnaryOp &unaryOp) { return visitUnaryOp(unaryOp); }
+  T operator()(String &string) { return visitString(string); }
+  T operator()(Num &num) { return visitNum(num); }
+  T operator()(Grouping &grouping) { return visitGrouping(grouping); }
+  T operator()(Truee &truee) { return visitTruee(truee); }
+  T operator()(Falsee &falsee) { return visitFalsee(falsee); }
+  T operator()(Nil &nil) { return visitNil(nil); }
+
+  T
+  visit(Tree &tree, Expr expr)
+  {
+    tree_ = &tree;
+    return visit(expr);
+  }
+
+  T
+  visit(Expr expr)
+  {
+    return std::visit(*this, (*tree_)[expr]);
+  }
+
+private:
+  Tree *tree_ = nullptr;
+
+};
+
+template <class T>
+class ConstVisitor {
+public:
+  virtual ~ConstVisitor() =default;
+
+  virtual T visitBinOp(const BinOp &binOp) =0;
+  virtual T visitUnaryOp(const UnaryOp &unaryOp) =0;
+  virtual T visitString(const String &string) =0;
+  virtual T visitNum(const Num &num) =0;
+  virtual T visitGrouping(const Grouping &grouping) =0;
+  virtual T visitTruee(const Truee &truee) =0;
+  virtual T visitFalsee(const Falsee &falsee) =0;
+  virtual T visitNil(const Nil &nil) =0;
+
+  T operator()(const BinOp &binOp) { return visitBinOp(binOp); }
+  T operator()(const UnaryOp &unaryOp) { return visitUnaryOp(unaryOp); }
+  T operator()(const String &string) { return visitString(string); }
+  T operator()(const Num &num) { return visitNum(num); }
+  T operator()(const Grouping &grouping) { return visitGrouping(grouping); }
+  T operator()(const Truee &truee) { return visitTruee(truee); }
+  T operator()(const Falsee &falsee) { return visitFalsee(falsee); }
+  T operator()(const Nil &nil) { return visitNil(nil); }
+
+  T
+  visit(const Tree &tree, Expr expr)
+  {
+    tree_ = &tree;
+    return visit(expr);
+  }
+
+  T
+  visit(Expr expr)
+  {
+    return std::visit(*this, (*tree_)[expr]);
+  }
+
+private:
+  const Tree *tree_ = nullptr;
+
+};
+
+// Derive from this as `class V : public StaticVisitor<V, T>`, and give `V` a `visitX` method for
+// each node. If `V` derives privately or the methods are private, it needs to be friends
+// with `StaticVisitor<V, T>`.
+template <class Derived, class T>
+class StaticVisitor {
+public:
+  T operator()(BinOp &binOp) { return derived().visitBinOp(binOp); }
+  T operator()(UnaryOp &unaryOp) { return derived().visitUnaryOp(unaryOp); }
+  T operator()(String &string) { return derived().visitString(string); }
+  T operator()(Num &num) { return derived().visitNum(num); }
+  T operator()(Grouping &grouping) { return derived().visitGrouping(grouping); }
+  T operator()(Truee &truee) { return derived().visitTruee(truee); }
+  T operator()(Falsee &falsee) { return derived().visitFalsee(falsee); }
+  T operator()(Nil &nil) { return derived().visitNil(nil); }
+
+  T
+  visit(Tree &tree, Expr expr)
+  {
+    tree_ = &tree;
+    return visit(expr);
+  }
+
+  T
+  visit(Expr expr)
+  {
+    return std::visit(*this, (*tree_)[expr]);
+  }
+
+private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+  Tree *tree_ = nullptr;
+
+};
+
+// Derive from this as `class V : public StaticConstVisitor<V, T>`, and give `V` a `visitX` method for
+// each node. If `V` derives privately or the methods are private, it needs to be friends
+// with `StaticConstVisitor<V, T>`.
+template <class Derived, class T>
+class StaticConstVisitor {
+public:
+  T operator()(const BinOp &binOp) { return derived().visitBinOp(binOp); }
+  T operator()(const UnaryOp &unaryOp) { return derived().visitUnaryOp(unaryOp); }
+  T operator()(const String &string) { return derived().visitString(string); }
+  T operator()(const Num &num) { return derived().visitNum(num); }
+  T operator()(const Grouping &grouping) { return derived().visitGrouping(grouping); }
+  T operator()(const Truee &truee) { return derived().visitTruee(truee); }
+  T operator()(const Falsee &falsee) { return derived().visitFalsee(falsee); }
+  T operator()(const Nil &nil) { return derived().visitNil(nil); }
+
+  T
+  visit(const Tree &tree, Expr expr)
+  {
+    tree_ = &tree;
+    return visit(expr);
+  }
+
+  T
+  visit(Expr expr)
+  {
+    return std::visit(*this, (*tree_)[expr]);
+  }
+
+private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+  const Tree *tree_ = nullptr;
+
+};
+
+// Derive from this as `class T : public ConstTraversal<T>`, and give `T` the callbacks it
+// needs (the rest do nothing): `visitX` for each leaf node, and `enterX`, `betweenX` (between
+// children) and `leaveX` for each node with children. Like the static visitors, `T` needs to be
+// friends with `ConstTraversal<T>` if it derives privately or the callbacks are private.
+// The stack is kept between traversals, so reusing a traversal doesn't reallocate it.
+template <class Derived>
+class ConstTraversal {
+public:
+  void
+  traverse(const Tree &tree, Expr expr)
+  {
+    tree_ = &tree;
+    run(&expr);
+  }
+
+  void enterBinOp(const BinOp &) { }
+  void betweenBinOp(const BinOp &) { }
+  void leaveBinOp(const BinOp &) { }
+  void enterUnaryOp(const UnaryOp &) { }
+  void leaveUnaryOp(const UnaryOp &) { }
+  void visitString(const String &) { }
+  void visitNum(const Num &) { }
+  void enterGrouping(const Grouping &) { }
+  void leaveGrouping(const Grouping &) { }
+  void visitTruee(const Truee &) { }
+  void visitFalsee(const Falsee &) { }
+  void visitNil(const Nil &) { }
+
+private:
+  struct Entry {
+    const void *node;
+    // Which of the `Expr` alternatives the node is.
+    uint32_t kind;
+    // How many of its children have been started.
+    uint32_t phase;
+  };
+
+  std::vector<Entry> stack_;
+  const Tree *tree_ = nullptr;
+
+  Derived &derived() { return static_cast<Derived &>(*this); }
+
+  void
+  run(const Expr *expr)
+  {
+    // Left over if a callback threw partway through the last traversal.
+    stack_.clear();
+    descend(expr);
+    while (!stack_.empty()) {
+      const auto entry = stack_.back();
+      switch (entry.kind) {
+      case 0: resume(*static_cast<const BinOp *>(entry.node), entry.phase); break;
+      case 1: resume(*static_cast<const UnaryOp *>(entry.node), entry.phase); break;
+      case 4: resume(*static_cast<const Grouping *>(entry.node), entry.phase); break;
+      }
+    }
+  }
+
+  // Starts nodes down to the first leaf, leaving the ones with more children on the stack.
+  void
+  descend(const Expr *expr)
+  {
+    while (expr) {
+      expr = std::visit([this](const auto &node) { return start(node); }, (*tree_)[*expr]);
+    }
+  }
+
+  const Expr *
+  start(const BinOp &binOp)
+  {
+    derived().enterBinOp(binOp);
+    stack_.push_back({ &binOp, 0, 1 });
+    return &binOp.lhs();
+  }
+
+  const Expr *
+  start(const UnaryOp &unaryOp)
+  {
+    derived().enterUnaryOp(unaryOp);
+    stack_.push_back({ &unaryOp, 1, 1 });
+    return &unaryOp.child();
+  }
+
+  const Expr *
+  start(const Grouping &grouping)
+  {
+    derived().enterGrouping(grouping);
+    stack_.push_back({ &grouping, 4, 1 });
+    return &grouping.child();
+  }
+
+  const Expr *start(const String &string) { derived().visitString(string); return nullptr; }
+  const Expr *start(const Num &num) { derived().visitNum(num); return nullptr; }
+  const Expr *start(const Truee &truee) { derived().visitTruee(truee); return nullptr; }
+  const Expr *start(const Falsee &falsee) { derived().visitFalsee(falsee); return nullptr; }
+  const Expr *start(const Nil &nil) { derived().visitNil(nil); return nullptr; }
+
+  void
+  resume(const BinOp &binOp, uint32_t phase)
+  {
+    switch (phase) {
+    case 1:
+      ++stack_.back().phase;
+      derived().betweenBinOp(binOp);
+      return descend(&binOp.rhs());
+    default:
+      stack_.pop_back();
+      derived().leaveBinOp(binOp);
+    }
+  }
+
+  void
+  resume(const UnaryOp &unaryOp, uint32_t)
+  {
+    stack_.pop_back();
+    derived().leaveUnaryOp(unaryOp);
+  }
+
+  void
+  resume(const Grouping &grouping, uint32_t)
+  {
+    stack_.pop_back();
+    derived().leaveGrouping(grouping);
+  }
+
+};
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "lexer/Lexer.h"
+
+// Everything the lexer needs to know about a character, looked up with a single
+// index into a 256-entry table instead of a chain of comparisons.
+
+namespace lexer {
+
+// Bit flags, so that a character can be in more than one class.
+enum CharClass : uint8_t {
+  WHITESPACE = 1 << 0,
+  DIGIT = 1 << 1,
+  LETTER = 1 << 2, // includes '_'
+};
+
+// What to do with a character that starts a lex.
+enum class LexAction : uint8_t {
+  Unrecognized,
+  Whitespace,
+  SingleCharToken, // always `token`
+  MaybeEqualsToken, // `token`, or `longToken` if followed by '='
+  Slash, // a comment, or `token`
+  String,
+  Number,
+  IdentifierOrReservedWord,
+};
+
+struct CharInfo {
+  uint8_t classes = 0;
+  LexAction action = LexAction::Unrecognized;
+  Token::Type token = Token::Type::EOFF;
+  Token::Type longToken = Token::Type::EOFF;
+};
+
+namespace detail {
+
+constexpr std::array<CharInfo, 256>
+makeCharTable()
+{
+  std::array<CharInfo, 256> table {};
+  const auto at = [&table](char c) -> CharInfo & { return table[static_cast<unsigned char>(c)]; };
+
+  for (const char c : { ' ', '\n', '\r', '\t' }) {
+    at(c).classes |= WHITESPACE;
+    at(c).action = LexAction::Whitespace;
+  }
+  for (char c = '0'; c <= '9'; ++c) {
+    at(c).classes |= DIGIT;
+    at(c).action = LexAction::Number;
+  }
+  for (char c = 'a'; c <= 'z'; ++c) {
+    at(c).classes |= LETTER;
+    at(c).action = LexAction::IdentifierOrReservedWord;
+  }
+  for (char c = 'A'; c <= 'Z'; ++c) {
+    at(c).classes |= LETTER;
+    at(c).action = LexAction::IdentifierOrReservedWord;
+  }
+  at('_').classes |= LETTER;
+  at('_').action = LexAction::IdentifierOrReservedWord;
+
+  const auto single = [&at](char c, Token::Type token) {
+    at(c).action = LexAction::SingleCharToken;
+    at(c).token = token;
+  };
+  single('(', Token::Type::LPEREN);
+  single(')', Token::Type::RPEREN);
+  single('{', Token::Type::LBRACE);
+  single('}', Token::Type::RBRACE);
+  single(',', Token::Type::COMMA);
+  single('.', Token::Type::DOT);
+  single('-', Token::Type::MINUS);
+  single('+', Token::Type::PLUS);
+  single(';', Token::Type::SEMICOLON);
+  single('*', Token::Type::STAR);
+
+  const auto maybeEquals = [&at](char c, Token::Type token, Token::Type longToken) {
+    at(c).action = LexAction::MaybeEqualsToken;
+    at(c).token = token;
+    at(c).longToken = longToken;
+  };
+  maybeEquals('!', Token::Type::BANG, Token::Type::BANG_EQ);
+  maybeEquals('=', Token::Type::EQ, Token::Type::EQ_EQ);
+  maybeEquals('<', Token::Type::LT, Token::Type::LT_EQ);
+  maybeEquals('>', Token::Type::GT, Token::Type::GT_EQ);
+
+  at('/').action = LexAction::Slash;
+  at('/').token = Token::Type::SLASH;
+  at('"').action = LexAction::String;
+
+  return table;
+}
+
+}
+
+inline constexpr std::array<CharInfo, 256> CHAR_TABLE = detail::makeCharTable();
+
+constexpr const CharInfo &
+charInfo(char c)
+{
+  return CHAR_TABLE[static_cast<unsigned char>(c)];
+}
+
+// Whether `c` (a character, or EOF from peeking) is in any of `classes`.
+constexpr bool
+isInClass(int c, uint8_t classes)
+{
+  return c >= 0 && c < 256 && (CHAR_TABLE[c].classes & classes) != 0;
+}
+
+static_assert(charInfo('!').longToken == Token::Type::BANG_EQ);
+static_assert(isInClass('_', LETTER) && isInClass('7', DIGIT | LETTER) && !isInClass('@', DIGIT | LETTER));
+static_assert(!isInClass(std::char_traits<char>::eof(), WHITESPACE));
+
+}
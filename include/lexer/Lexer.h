@@ -1,15 +1,35 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <sstream>
 #include <ostream>
-#include <functional>
+#include <cstdint>
+#include <optional>
+#include <utility>
 
 #include "utils/Error.hpp"
+#include "utils/StringInterner.hpp"
 
 namespace lexer {
 
+class TokenStream;
+
+// Range of the source buffer covered by a lex, e.g. a string token's span
+// includes its quotes even though its contents don't.
+struct SourceSpan {
+  uint32_t offset = 0;
+  uint32_t length = 0;
+};
+
+// A change to a source buffer: `removedLength` characters starting at `offset`
+// were replaced with `insertedText`.
+struct TextEdit {
+  uint32_t offset = 0;
+  uint32_t removedLength = 0;
+  std::string_view insertedText;
+};
+
 class Token {
 public:
   enum class Type {
@@ -26,19 +46,42 @@ public:
     EOFF // "EOF" is already used, as a macro.
   };
 
-  Token(Type tokenType, unsigned lineNunber, std::string contents);
+  // Tokens don't own their contents: they are views onto the buffer that was lexed,
+  // so that buffer needs to outlive them.
+  // Where a token is in the source is just its span's offset; a `LineIndex` over the
+  // source gives the line and column when they're needed.
+  // Identifiers and strings may also carry their contents as an interned symbol,
+  // and numbers made by the lexer carry their value.
+  // None of that owns any memory, so tokens are cheap to copy, and can be handed on
+  // (lexer to token source to parser) by assignment.
+  Token(
+    Type tokenType,
+    std::string_view contents,
+    SourceSpan span = {},
+    utils::Symbol symbol = {},
+    std::optional<double> number = std::nullopt
+  );
 
   Type getType() const;
-  const std::string &getContents() const;
-  unsigned getLineNumber() const;
+  std::string_view getContents() const;
+  SourceSpan getSpan() const;
+  utils::Symbol getSymbol() const;
+  std::optional<double> getNumber() const;
 
   friend std::ostream& operator<<(std::ostream&, const Token &);
   friend std::ostream& operator<<(std::ostream&, const Token::Type &);
 
 private:
-  const Type type_;
-  const std::string contents_;
-  const unsigned lineNumber_;
+  Type type_;
+  bool hasNumber_;
+  SourceSpan span_;
+  std::string_view contents_;
+  // Only identifiers and strings have symbols, and only numbers have values, so they
+  // share the space, and `hasNumber_` says which one is there.
+  union {
+    utils::Symbol symbol_;
+    double number_;
+  };
 
 };
 
@@ -46,27 +89,71 @@ class Lexer {
 public:
 
   Lexer();
-
-  std::vector<Token> lex(const std::string &sourceCode);
+  // Interns the contents of identifier and string tokens into `strings`.
+  explicit Lexer(utils::StringInterner &strings);
+
+  // The source is scanned in place, and the returned tokens refer back into it.
+  std::vector<Token> lex(std::string_view sourceCode);
+  std::vector<Token> lex(const char *begin, const char *end);
+  // Same as `lex`, but stores the tokens compactly.
+  TokenStream lexToStream(std::string_view sourceCode);
+
+  // Streaming interface: `reset` onto a source, then pull tokens out one at a time
+  // instead of lexing the whole source up front. Once the source runs out, `nextToken`
+  // throws if there were any errors, and otherwise returns EOF (on every call).
+  void reset(std::string_view sourceCode);
+  Token nextToken();
+
+  // Incremental interface: given the tokens from lexing a source, and the same
+  // source after `edit` was applied to it, returns the tokens for the edited source.
+  // Only the text around the edit is re-lexed; the tokens after it are shifted
+  // into place rather than being lexed again.
+  std::vector<Token> relex(const std::vector<Token> &previousTokens, std::string_view sourceCode, const TextEdit &edit);
+
+  // Parallel interface: splits the source into chunks and lexes them on separate
+  // threads. Gives the same tokens and errors as `lex`.
+  std::vector<Token> lexParallel(std::string_view sourceCode, unsigned threadCount);
 
 private:
-  std::stringstream sourceCode_;
-  std::vector<Token> tokens_;
-  unsigned currentLine_ = 1;
-  std::string currentLex_;
+  utils::StringInterner *strings_ = nullptr;
+
+  // The result of lexing part of a source on its own.
+  struct Chunk {
+    size_t start = 0; // where lexing began
+    size_t stop = 0; // no lexes were started at or after here
+    size_t end = 0; // where lexing actually finished, which is past `stop` if the last lex straddled it
+    std::vector<Token> tokens;
+    std::vector<CompileError> errors;
+  };
+
+  std::string_view sourceCode_;
+  size_t current_ = 0; // index of the next character to be read
+  size_t lexStart_ = 0; // index of the first character of the current lex
+  std::optional<Token> token_; // made by the last character, if any
   std::vector<CompileError> errors_;
 
+  std::optional<Token> lexNext();
+  Token intern(const Token &token);
+  void lexChunk(Chunk &chunk);
   void lex(char c);
   void addToken(Token::Type tokenType, bool includeContents = false);
+  void addToken(Token::Type tokenType, std::string_view contents, std::optional<double> number = std::nullopt);
+  std::string_view currentLex() const;
   bool match(char d);
-  bool match(const std::function<bool(char)> &predicate);
-  int peekNext();
+  bool matchClass(uint8_t classes); // any of `lexer::CharClass`
+  int peek() const;
+  int peekNext() const;
   void lexComment();
   void lexString();
   void lexNumber();
   void lexIdentifierOrReservedWord();
   void consume();
 
+  // Helpers for jumping over runs of characters with `lexer::scan`.
+  const char *position() const;
+  const char *sourceEnd() const;
+  void seek(const char *newPosition);
+
 };
 
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "utils/Error.hpp"
+
+namespace lexer {
+
+// Lines and columns both count from 1. Columns count bytes, not characters.
+struct SourcePosition {
+  unsigned line = 1;
+  unsigned column = 1;
+};
+
+// Tokens and errors only record where they are as an offset into the source,
+// which is all the lexer and parser need. This turns offsets into lines and
+// columns for showing to people, so it only needs to be built once something
+// (usually an error) is actually going to be reported.
+class LineIndex {
+public:
+  explicit LineIndex(std::string_view sourceCode);
+
+  SourcePosition position(uint32_t offset) const;
+  size_t lineCount() const;
+
+private:
+  std::vector<uint32_t> lineStarts_; // offset of the first character of each line
+
+};
+
+// Describe errors with the line and column they happened at, rather than their offset.
+std::string describe(const CompileError &error, const LineIndex &lines);
+std::string describe(const ErrorCollection &errors, const LineIndex &lines);
+
+}
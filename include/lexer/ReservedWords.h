@@ -0,0 +1,78 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include "lexer/Lexer.h"
+
+namespace lexer {
+
+// Maps a lexed word onto the reserved word token it spells, if any.
+// Switching on the length and then the first character narrows each word
+// down to at most one or two candidates, so this needs no hashing and no
+// allocation, and can be checked at compile time.
+constexpr std::optional<Token::Type>
+reservedWordType(std::string_view word)
+{
+  using Type = Token::Type;
+
+  const auto is = [word](std::string_view reservedWord, Type type) -> std::optional<Type> {
+    if (word == reservedWord) {
+      return type;
+    }
+    return std::nullopt;
+  };
+
+  switch (word.size()) {
+    case 2:
+      switch (word[0]) {
+        case 'i': return is("if", Type::IF);
+        case 'o': return is("or", Type::OR);
+      }
+      break;
+    case 3:
+      switch (word[0]) {
+        case 'a': return is("and", Type::AND);
+        case 'f':
+          if (auto type = is("for", Type::FOR)) {
+            return type;
+          }
+          return is("fun", Type::FUN);
+        case 'n': return is("nil", Type::NIL);
+        case 'v': return is("var", Type::VAR);
+      }
+      break;
+    case 4:
+      switch (word[0]) {
+        case 'e': return is("else", Type::ELSE);
+        case 't':
+          if (auto type = is("this", Type::THIS)) {
+            return type;
+          }
+          return is("true", Type::TRUE);
+      }
+      break;
+    case 5:
+      switch (word[0]) {
+        case 'c': return is("class", Type::CLASS);
+        case 'f': return is("false", Type::FALSE);
+        case 'p': return is("print", Type::PRINT);
+        case 's': return is("super", Type::SUPER);
+        case 'w': return is("while", Type::WHILE);
+      }
+      break;
+    case 6:
+      return is("return", Type::RETURN);
+  }
+
+  return std::nullopt;
+}
+
+static_assert(reservedWordType("while") == Token::Type::WHILE);
+static_assert(reservedWordType("fun") == Token::Type::FUN);
+static_assert(reservedWordType("this") == Token::Type::THIS);
+static_assert(!reservedWordType("fur"));
+static_assert(!reservedWordType("whilst"));
+static_assert(!reservedWordType(""));
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+// Helpers for skipping over long runs of characters that the lexer doesn't
+// care about (comment bodies, string contents, whitespace). These look at
+// 16 or 32 bytes at a time with SSE2 or AVX2, depending on what the compiler
+// is allowed to target (AVX2 needs the LOX1_AVX2 build option), and fall back to scanning one character at a time
+// for the remainder (or on platforms without either).
+
+namespace lexer::scan {
+
+// Bytes looked at in each step: 32 with AVX2, 16 with SSE2, or 1 with neither.
+size_t blockSize();
+
+// First occurrence of `c` in [begin, end), or `end` if there isn't one.
+const char *find(const char *begin, const char *end, char c);
+
+// Number of newlines in [begin, end).
+size_t countNewlines(const char *begin, const char *end);
+
+// First non-whitespace character in [begin, end), or `end` if there isn't one.
+const char *skipWhitespace(const char *begin, const char *end);
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+namespace lexer {
+
+// Read-only source code for the lexer to scan in place. Regular files are
+// memory-mapped rather than read, so loading one doesn't copy it (or even read
+// it all) up front. Anything that can't be mapped, like a pipe, is read into a
+// buffer instead.
+class SourceBuffer {
+public:
+  // Throws `std::runtime_error` if the file can't be opened or read.
+  static SourceBuffer fromFile(const std::string &path);
+
+  // Source that's already in memory, e.g. a line typed at the prompt.
+  explicit SourceBuffer(std::string contents);
+
+  SourceBuffer(SourceBuffer &&other) noexcept;
+  SourceBuffer &operator=(SourceBuffer &&other) noexcept;
+  SourceBuffer(const SourceBuffer &) =delete;
+  SourceBuffer &operator=(const SourceBuffer &) =delete;
+  ~SourceBuffer();
+
+  // Valid for as long as the buffer is alive (tokens lexed from it point into it).
+  std::string_view view() const;
+  bool isMapped() const;
+
+private:
+  SourceBuffer() =default;
+
+  void *mapping_ = nullptr;
+  size_t mappingSize_ = 0;
+  std::string contents_; // used if the source isn't mapped
+
+};
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <string_view>
+
+#include "lexer/Lexer.h"
+#include "lexer/TokenStream.h"
+
+namespace lexer {
+
+// Something the parser can pull tokens from one at a time, so that it
+// doesn't have to care whether they were all lexed up front or are being
+// lexed on demand.
+class TokenSource {
+public:
+  virtual ~TokenSource() =default;
+
+  // The next token, or nothing once the source has run out.
+  virtual std::optional<Token> next() =0;
+
+  // Called when parsing fails, before the parser throws its own error. Sources that
+  // lex as they go throw the lexer's errors here if there are any, since they're
+  // usually the cause, and would otherwise be lost.
+  virtual void throwPendingErrors() { }
+};
+
+// Hands out tokens that have already been lexed.
+class VectorTokenSource final : public TokenSource {
+public:
+  explicit VectorTokenSource(std::vector<Token> tokens);
+
+  std::optional<Token> next() override;
+
+private:
+  std::vector<Token> tokens_;
+  size_t next_ = 0;
+};
+
+// Hands out tokens from a `TokenStream`, in order.
+class TokenStreamSource final : public TokenSource {
+public:
+  explicit TokenStreamSource(const TokenStream &tokens);
+
+  std::optional<Token> next() override;
+
+private:
+  const TokenStream &tokens_;
+  size_t next_ = 0;
+  size_t nextPayload_ = 0;
+};
+
+// Lexes tokens as they are asked for. Runs out after the EOF token.
+class LexerTokenSource final : public TokenSource {
+public:
+  LexerTokenSource(Lexer &lexer, std::string_view sourceCode);
+
+  std::optional<Token> next() override;
+  // Lexes the rest of the source, so the lexer reports every error it finds, as `lex` would.
+  void throwPendingErrors() override;
+
+private:
+  Lexer &lexer_;
+  bool isFinished_ = false;
+};
+
+}
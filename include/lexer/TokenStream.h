@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+#include <optional>
+
+#include "lexer/Lexer.h"
+#include "utils/StringInterner.hpp"
+
+namespace lexer {
+
+// A compact, append-only alternative to `std::vector<Token>`. Each field of the
+// tokens is kept in its own array, so scanning through e.g. the token types only
+// touches one byte per token. Most tokens are punctuation or reserved words, so
+// contents (and symbols, and numbers' values) are kept in a side table which only has entries for
+// identifiers, strings and numbers, in the order those tokens appear.
+// Span lengths aren't stored at all: they follow from the type and contents.
+class TokenStream {
+public:
+  void push_back(const Token &token);
+  void reserve(size_t tokenCount);
+
+  size_t size() const;
+  bool empty() const;
+
+  Token::Type type(size_t index) const;
+  uint32_t offset(size_t index) const;
+
+  // Rebuilds the token at `index`. `payloadIndex` is its entry in the side table,
+  // i.e. the number of tokens before it that have contents. Reading the tokens in order
+  // with a `TokenStreamSource` keeps track of this for you.
+  Token token(size_t index, size_t payloadIndex) const;
+
+  // The contents, symbol and number of the token with entry `payloadIndex` in the side
+  // table, without rebuilding the whole token.
+  std::string_view contents(size_t payloadIndex) const;
+  utils::Symbol symbol(size_t payloadIndex) const;
+  std::optional<double> number(size_t payloadIndex) const;
+
+  // Whether tokens of this type have an entry in the side table.
+  static bool hasPayload(Token::Type type);
+
+  // Bytes of memory allocated to hold the tokens.
+  size_t memoryUsage() const;
+
+private:
+  // As in `Token`, the symbol and the number share the space.
+  struct Payload {
+    explicit Payload(const Token &token);
+
+    const char *contents;
+    uint32_t length; // spans' lengths are 32 bits too
+    bool hasNumber;
+    union {
+      utils::Symbol symbol;
+      double number;
+    };
+  };
+  static_assert(sizeof(Payload) == 24);
+
+  std::vector<uint8_t> types_;
+  std::vector<uint32_t> offsets_;
+  std::vector<Payload> payloads_;
+
+};
+
+}
@@ -1,46 +1,86 @@
 #pragma once
 
 #include <vector>
-#include <optional>
-#include <functional>
+#include <string_view>
+#include <cstdint>
 
+#include "ast/ArenaExpr.hpp"
 #include "ast/Expr.hpp"
+#include "ast/FlatExpr.hpp"
 #include "lexer/Lexer.h"
+#include "lexer/TokenSource.h"
+#include "utils/Arena.hpp"
+#include "utils/Counter.hpp"
+#include "utils/StringInterner.hpp"
 
 namespace parser {
 
 class Parser {
 public:
 
+  // Strings in the tree are interned into `strings`, which needs to outlive the trees.
+  // Tokens that were already interned (e.g. by a lexer sharing the same interner) are
+  // used as they are.
+  explicit Parser(utils::StringInterner &strings);
+
   ast::Expr parse(std::vector<lexer::Token> tokens);
+  // Only ever holds on to the current token and the one after it, so
+  // tokens can be lexed as they are parsed.
+  ast::Expr parse(lexer::TokenSource &tokens);
+  // Reads the tokens where they are, rather than copying each one out. Only the
+  // token types are looked at to decide what to parse next.
+  ast::Expr parse(const lexer::TokenStream &tokens);
+  // Builds the tree in `arena` rather than allocating each node on its own. The
+  // arena frees the whole tree at once, so it needs to outlive the tree.
+  ast::arena::Expr parse(lexer::TokenSource &tokens, Arena &arena);
+  ast::arena::Expr parse(const lexer::TokenStream &tokens, Arena &arena);
+  // Whether identical subtrees are parsed into separate nodes, or share the same
+  // nodes (hash-consing), which saves memory on repetitive code but makes the tree a DAG.
+  enum class Subtrees { Separate, Shared };
+
+  // Adds the nodes to `tree`, children first, and returns the root.
+  ast::flat::Expr parse(
+    lexer::TokenSource &tokens, ast::flat::Tree &tree, Subtrees subtrees = Subtrees::Separate
+  );
+  ast::flat::Expr parse(
+    const lexer::TokenStream &tokens, ast::flat::Tree &tree, Subtrees subtrees = Subtrees::Separate
+  );
+
+  // Nodes are numbered as they're made, from 0 in each tree, so the ids in the tree
+  // from the last parse run from 0 to `nodeCount() - 1`. Parsers don't share ids, so
+  // different parsers can be used on different threads.
+  size_t nodeCount() const;
 
 private:
 
-  size_t current_;
-  std::vector<lexer::Token> tokens_;
+  utils::StringInterner *strings_;
+  Counter ids_;
 
-  // Helpers for scanning through tokens.
-  const lexer::Token &current() const;
-  const lexer::Token &advance();
-  template <class... T> bool peek(T &&...);
-  template <class... T> std::optional<std::reference_wrapper<const lexer::Token>> match(T &&...);
-  template <class... T> const lexer::Token &expect(T &&...);
+  // Where the tokens come from. `Tokens` is a cursor over them (see Parser.cpp),
+  // holding the token most recently consumed and one token of lookahead.
+  template <class Tokens, class Factory> typename Factory::Expr parseWith(Tokens &tokens, Factory &factory);
+  template <class Tokens> ast::flat::Expr parseFlat(Tokens &tokens, ast::flat::Tree &tree, Subtrees subtrees);
 
-  // Helpers for parsing grammar structures into specific AST nodes.
-  template <class BinOpMapFunc, class SubExprFunc, class... Ts>
-  ast::Expr createBinOp(const BinOpMapFunc &, const SubExprFunc &, Ts &&...);
+  // Helpers for scanning through tokens.
+  // Where in the source to report an error: the token most recently consumed, or the
+  // next one if nothing has been consumed yet.
+  template <class Tokens> static uint32_t errorOffset(const Tokens &tokens);
+  template <class Tokens, class... T> static bool peek(const Tokens &tokens, T &&...);
+  template <class Tokens, class... T> static bool match(Tokens &tokens, T &&...);
+  template <class Tokens, class... T> static void expect(Tokens &tokens, T &&...);
 
   // Helpers for error reporting.
-  double textToDouble(const std::string &);
-
-  // Methods for non-terminals in the grammar.
-  ast::Expr expression();
-  ast::Expr equality();
-  ast::Expr comparison();
-  ast::Expr term();
-  ast::Expr factor();
-  ast::Expr unary();
-  ast::Expr primary();
+  static double textToDouble(std::string_view, uint32_t offset);
+
+  // Methods for non-terminals in the grammar. The nodes are made by `factory`, so the
+  // same grammar can build any layout of tree (see `ast::Factory`).
+  // All the binary operator levels (equality, comparison, term and factor) are parsed
+  // by this one method, using the binding powers in the operator table. It only takes
+  // operators that bind at least as tightly as `minBindingPower`.
+  template <class Tokens, class Factory>
+  typename Factory::Expr expression(Tokens &tokens, Factory &factory, uint8_t minBindingPower = 1);
+  template <class Tokens, class Factory> typename Factory::Expr unary(Tokens &tokens, Factory &factory);
+  template <class Tokens, class Factory> typename Factory::Expr primary(Tokens &tokens, Factory &factory);
 
 };
 
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts what the process allocates on the heap, so tests and benchmarks can check what
+// the code under test allocates. This only works in binaries that link the
+// `AllocationCounter` target (see CMakeLists.txt), which replaces the global allocation
+// functions; the compiler itself doesn't.
+
+namespace utils {
+
+// Number of heap allocations the process has made so far. Take the difference either
+// side of the code being checked.
+size_t allocationCount();
+
+// Highest number of bytes on the heap at once since the last `resetPeakHeap`, which
+// returns how many were on the heap when it was called (to take off the peak).
+size_t resetPeakHeap();
+size_t peakHeap();
+
+}
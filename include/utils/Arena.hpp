@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator for objects that all die together, e.g. the nodes of one tree.
+// Creating an object just moves a pointer along (until the current block runs out),
+// and nothing is freed until the arena itself is, which frees everything in one go
+// without visiting the objects. So only trivially destructible objects can go in it.
+class Arena {
+public:
+  explicit Arena(size_t initialBlockSize = 4096)
+    : resource_(initialBlockSize)
+    { }
+
+  Arena(const Arena &) =delete;
+  Arena &operator=(const Arena &) =delete;
+
+  template <class T, class... Args>
+  T *
+  create(Args &&... args)
+  {
+    static_assert(std::is_trivially_destructible_v<T>, "Objects in an arena are never destroyed");
+    ++objectCount_;
+    void *memory = resource_.allocate(sizeof(T), alignof(T));
+    return new (memory) T(std::forward<Args>(args)...);
+  }
+
+  // Number of objects created in the arena so far.
+  size_t
+  objectCount() const
+  {
+    return objectCount_;
+  }
+
+private:
+  std::pmr::monotonic_buffer_resource resource_;
+  size_t objectCount_ = 0;
+
+};
@@ -1,14 +1,32 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 
+// Hands out ids 0, 1, 2, ... in order. Not thread-safe, and doesn't need to be: each
+// parse has its own counter (see `Parser::nodeCount`), so the ids in a tree are dense,
+// and parsers on different threads never share one.
+// Ids are 32-bit to keep nodes small. That's plenty, because every node takes at least
+// one character of source, and the lexer only takes sources of up to 4GB.
 class Counter {
 public:
-  static size_t next() { return counter_++; }
+  uint32_t next() { return static_cast<uint32_t>(count_++); }
+
+  // How many ids have been handed out, which is also one more than the largest.
+  size_t count() const { return count_; }
+
+  // For nodes made without a counter of their own, like trees built by hand with the
+  // factory functions. Safe to call from any thread, but the ids are only unique, not
+  // dense, and wrap around after 2^32 of them.
+  static uint32_t
+  nextShared()
+  {
+    static std::atomic<uint32_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed);
+  }
 
 private:
-  // This is ok because counter_ will be initialized
-  // as zero across all translation units where it's used.
-  static inline size_t counter_{0};
+  size_t count_ = 0;
 
 };
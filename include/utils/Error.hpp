@@ -5,32 +5,50 @@
 #include <utility>
 #include <sstream>
 #include <vector>
+#include <cstdint>
 
 #include "utils/Assert.hpp"
 
+// Errors only record where they happened as an offset into the source. Turning that
+// into a line and column needs the whole source, so it's left until the error is shown.
 class CompileError {
 public:
   CompileError(
-    unsigned lineNumber,
+    uint32_t offset,
     std::string errorType,
     std::string errorMessage,
     std::string sourceSnippet
   )
-    : lineNumber_(lineNumber)
+    : offset_(offset)
     , errorType_(std::move(errorType))
     , errorMessage_(std::move(errorMessage))
     , sourceSnippet_(std::move(sourceSnippet))
   { }
 
+  uint32_t
+  offset() const
+  {
+    return offset_;
+  }
+
+  // Describes the error with its offset, for when the source isn't available
+  // (`lexer::describe` gives the line and column instead).
   std::string
   what() const
+  {
+    return describeAt("Offset " + std::to_string(offset_));
+  }
+
+  // Describes the error with `location` as where it happened.
+  std::string
+  describeAt(const std::string &location) const
   {
     std::stringstream stream;
 
     stream << "[";
     stream << errorType_;
-    stream << " | Line ";
-    stream << lineNumber_;
+    stream << " | ";
+    stream << location;
     stream << "] ";
     stream << errorMessage_;
     stream << std::endl;
@@ -42,7 +60,7 @@ public:
   }
 
 private:
-  const unsigned lineNumber_;
+  const uint32_t offset_;
   const std::string errorType_;
   const std::string errorMessage_;
   const std::string sourceSnippet_;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Mixes `value` into `seed`, so that hashes of several things can be combined into one
+// (the same way as `boost::hash_combine`).
+inline size_t
+hashCombine(size_t seed, size_t value)
+{
+  return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+}
+
+// The bits of a double, for hashing and comparing it as a value rather than as a number:
+// `==` would have NaN unequal to itself, and 0.0 equal to -0.0.
+inline uint64_t
+bitPattern(double value)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// A checksum of a block of memory, for noticing when it's been corrupted (not for hash tables,
+// or against anyone changing it on purpose). Goes through it eight bytes at a time, and each
+// step can be undone, so changing any one word always changes the result.
+inline uint64_t
+hashBytes(const void *data, size_t size)
+{
+  const auto bytes = static_cast<const unsigned char *>(data);
+  uint64_t hash = 0xcbf29ce484222325 ^ size;
+  const auto mix = [&hash](uint64_t word) {
+    hash ^= word;
+    hash = ((hash << 29) | (hash >> 35)) * 0x9e3779b97f4a7c15;
+  };
+
+  size_t offset = 0;
+  for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + offset, sizeof(word));
+    mix(word);
+  }
+  if (offset < size) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + offset, size - offset);
+    mix(word);
+  }
+  return hash;
+}
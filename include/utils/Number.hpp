@@ -0,0 +1,35 @@
+#pragma once
+
+#include <charconv>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+// Converts the text of a number literal to a double. Unlike `std::stod` this doesn't
+// need a null-terminated copy of the text, doesn't depend on the locale and doesn't
+// throw: if the text isn't entirely a number, or the number can't be represented,
+// nothing is returned and `error` says why.
+inline std::optional<double>
+parseNumber(std::string_view text, std::errc &error)
+{
+  const auto end = text.data() + text.size();
+  double value = 0;
+  const auto result = std::from_chars(text.data(), end, value);
+  error = result.ec;
+  if (error == std::errc() && result.ptr != end) {
+    error = std::errc::invalid_argument;
+  }
+  if (error != std::errc()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+inline const char *
+describeNumberError(std::errc error)
+{
+  if (error == std::errc::result_out_of_range) {
+    return "Number is out of range of double-precision floating point, so cannot be represented.";
+  }
+  return "Unable to parse number into double-precision floating point.";
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <cstddef>
+
+namespace utils {
+
+// A handle onto a string that has been interned by a `StringInterner`. Each distinct
+// string is only stored once, so symbols are equal exactly when their strings are,
+// and comparing them is just comparing two pointers.
+class Symbol {
+public:
+  // A symbol that doesn't refer to any string.
+  Symbol() =default;
+
+  std::string_view str() const { return entry_ ? std::string_view(*entry_) : std::string_view(); }
+  bool isValid() const { return entry_ != nullptr; }
+
+  // The symbol as an opaque pointer, for storing it somewhere more compact (such as a
+  // NaN-boxed value), and the symbol back again from one. `fromRaw` only takes what `raw`
+  // gave, while the interner is still alive.
+  const void *raw() const { return entry_; }
+  static Symbol fromRaw(const void *raw) { return Symbol(static_cast<const std::string *>(raw)); }
+
+  friend bool operator==(Symbol lhs, Symbol rhs) { return lhs.entry_ == rhs.entry_; }
+  friend bool operator!=(Symbol lhs, Symbol rhs) { return lhs.entry_ != rhs.entry_; }
+
+private:
+  friend class StringInterner;
+  friend struct std::hash<Symbol>;
+
+  explicit Symbol(const std::string *entry) : entry_(entry) { }
+
+  const std::string *entry_ = nullptr;
+
+};
+
+}
+
+namespace std {
+
+template <>
+struct hash<utils::Symbol> {
+  size_t operator()(utils::Symbol symbol) const noexcept { return hash<const string *>()(symbol.entry_); }
+};
+
+}
+
+namespace utils {
+
+// Owns the strings that symbols refer to, so it needs to outlive all of them.
+// Typically there is one per compilation, shared by the lexer and the AST.
+class StringInterner {
+public:
+  StringInterner() =default;
+  // Symbols point into the interner, so copies would be no use.
+  StringInterner(const StringInterner &) =delete;
+  StringInterner &operator=(const StringInterner &) =delete;
+
+  Symbol
+  intern(std::string_view string)
+  {
+    if (const auto it = symbols_.find(string); it != symbols_.end()) {
+      return it->second;
+    }
+
+    // Deques never move their elements when growing at the end, so the
+    // string (and the view of it used as a key) stays put.
+    const auto &entry = strings_.emplace_back(string);
+    const Symbol symbol(&entry);
+    symbols_.emplace(entry, symbol);
+    return symbol;
+  }
+
+  // Number of distinct strings interned.
+  size_t
+  size() const
+  {
+    return strings_.size();
+  }
+
+private:
+  std::deque<std::string> strings_;
+  std::unordered_map<std::string_view, Symbol> symbols_;
+
+};
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "ast/Expr.hpp"
+#include "utils/StringInterner.hpp"
+#include "visit/Value.hpp"
+
+namespace visit {
+
+// Works out the value of an expression. The values of subexpressions are kept on a stack
+// of the evaluator's own rather than returned from recursive calls (see `ast::ConstTraversal`),
+// so expressions of any depth can be evaluated. Once the stacks have grown to fit, nothing is
+// allocated apart from the strings that `+` makes.
+class Evaluator final : ast::ConstTraversal<Evaluator> {
+public:
+  // Strings made by `+` are interned in `strings`, which should be the interner the
+  // expression's strings are in, so that equal strings compare equal.
+  explicit Evaluator(utils::StringInterner &strings);
+
+  // Throws `std::runtime_error` if an operator is given values it doesn't work on.
+  Value evaluate(const ast::Expr &expr);
+
+private:
+  friend ast::ConstTraversal<Evaluator>;
+
+  utils::StringInterner &strings_;
+  std::vector<Value> values_;
+
+  // Each operator replaces its operands on the stack with its result. Groupings leave the
+  // value of what's in them where it is, so they don't need anything.
+  void leaveBinOp(const ast::BinOp &binOp);
+  void leaveUnaryOp(const ast::UnaryOp &unaryOp);
+  void visitString(const ast::String &string);
+  void visitNum(const ast::Num &num);
+  void visitTruee(const ast::Truee &);
+  void visitFalsee(const ast::Falsee &);
+  void visitNil(const ast::Nil &);
+
+};
+
+}
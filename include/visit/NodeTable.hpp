@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+#include "ast/Expr.hpp"
+#include "utils/Assert.hpp"
+#include "visit/SmallVisitors.hpp"
+
+namespace visit {
+
+// Something to remember about each node of a tree (a type, a constant value, a count...),
+// kept outside the tree in a vector indexed by node id. Looking a node up is just an
+// index into the vector, so passes can annotate the tree without a hash map, and
+// without a field in every node that most passes don't use.
+// Only works for trees whose ids are dense, i.e. ones made by a `parser::Parser`:
+//   visit::NodeTable<Type> types(parser.nodeCount());
+template <class T>
+class NodeTable {
+public:
+  // `std::vector<bool>` can't hand out references to its elements.
+  static_assert(!std::is_same_v<T, bool>, "Use a NodeTable<char> (or similar) for flags");
+
+  // Room for nodes with ids from 0 to `nodeCount - 1`, all set to `initial`.
+  explicit NodeTable(size_t nodeCount, const T &initial = T())
+    : values_(nodeCount, initial)
+    { }
+
+  T &
+  operator[](size_t id)
+  {
+    ASSERT(id < values_.size() && "Node id is outside the table; was it made by a different parse?");
+    return values_[id];
+  }
+
+  const T &
+  operator[](size_t id) const
+  {
+    ASSERT(id < values_.size() && "Node id is outside the table; was it made by a different parse?");
+    return values_[id];
+  }
+
+  // Any node, from any layout of tree.
+  template <class Node, class = decltype(std::declval<const Node &>().id())>
+  T &operator[](const Node &node) { return (*this)[node.id()]; }
+  template <class Node, class = decltype(std::declval<const Node &>().id())>
+  const T &operator[](const Node &node) const { return (*this)[node.id()]; }
+
+  T &operator[](const ast::Expr &expr) { return (*this)[id(expr)]; }
+  const T &operator[](const ast::Expr &expr) const { return (*this)[id(expr)]; }
+
+  size_t size() const { return values_.size(); }
+
+private:
+  std::vector<T> values_;
+
+};
+
+}
@@ -5,21 +5,44 @@
 #include <sstream>
 
 #include "ast/Expr.hpp"
+#include "ast/FlatExpr.hpp"
 
 namespace visit {
 
-class PrettyPrinter final : ast::ConstVisitor<void> {
+// Prints either the default tree or a flat one. Both have the same nodes, so each
+// node is printed by one template which is used by the traversals for both.
+// The traversals keep their own stack rather than recursing, so trees of any depth
+// can be printed.
+class PrettyPrinter final
+  : ast::ConstTraversal<PrettyPrinter>
+  , ast::flat::ConstTraversal<PrettyPrinter> {
 public:
 
   std::string
   print(const ast::Expr &expression)
   {
     output.clear();
-    visit(expression);
+    ast::ConstTraversal<PrettyPrinter>::traverse(expression);
     return std::move(output);
   }
 
-  virtual void visitBinOp(const ast::BinOp &binOp) override
+  std::string
+  print(const ast::flat::Tree &tree, ast::flat::Expr expression)
+  {
+    output.clear();
+    ast::flat::ConstTraversal<PrettyPrinter>::traverse(tree, expression);
+    return std::move(output);
+  }
+
+private:
+  friend ast::ConstTraversal<PrettyPrinter>;
+  friend ast::flat::ConstTraversal<PrettyPrinter>;
+
+  std::string output{};
+
+  template <class BinOp>
+  void
+  enterBinOp(const BinOp &binOp)
   {
     output.append("(");
     switch(binOp.operation()) {
@@ -45,13 +68,14 @@ public:
         output.append("-"); break;
     }
     output.append(" ");
-    visit(binOp.lhs());
-    output.append(" ");
-    visit(binOp.rhs());
-    output.append(")");
   }
 
-  virtual void visitUnaryOp(const ast::UnaryOp &unaryOp) override
+  template <class BinOp> void betweenBinOp(const BinOp &) { output.append(" "); }
+  template <class BinOp> void leaveBinOp(const BinOp &) { output.append(")"); }
+
+  template <class UnaryOp>
+  void
+  enterUnaryOp(const UnaryOp &unaryOp)
   {
     output.append("(");
     switch(unaryOp.operation()) {
@@ -60,18 +84,22 @@ public:
       case ast::UnaryOp::Op::Nott:
       output.append("¬ "); break;
     }
-    visit(unaryOp.child());
-    output.append(")");
   }
 
-  virtual void visitString(const ast::String &string) override
+  template <class UnaryOp> void leaveUnaryOp(const UnaryOp &) { output.append(")"); }
+
+  template <class String>
+  void
+  visitString(const String &string)
   {
     output.append("\"");
-    output.append(string.value());
+    output.append(string.value().str());
     output.append("\"");
   }
 
-  virtual void visitNum(const ast::Num &num) override
+  template <class Num>
+  void
+  visitNum(const Num &num)
   {
     std::stringstream stream;
     stream.precision(3);
@@ -87,30 +115,12 @@ public:
     output.append(numString);
   }
 
-  virtual void visitGrouping(const ast::Grouping &grouping) override
-  {
-    output.append("(group ");
-    visit(grouping.child());
-    output.append(")");
-  }
+  template <class Falsee> void visitFalsee(const Falsee &) { output.append("false"); }
+  template <class Truee> void visitTruee(const Truee &) { output.append("true"); }
+  template <class Nil> void visitNil(const Nil &) { output.append("nil"); }
 
-  virtual void visitFalsee(const ast::Falsee &f) override
-  {
-    output.append("false");
-  }
-
-  virtual void visitTruee(const ast::Truee &t) override
-  {
-    output.append("true");
-  }
-
-  virtual void visitNil(const ast::Nil &nil) override
-  {
-    output.append("nil");
-  }
-
-private:
-  std::string output{};
+  template <class Grouping> void enterGrouping(const Grouping &) { output.append("(group "); }
+  template <class Grouping> void leaveGrouping(const Grouping &) { output.append(")"); }
 
 };
 
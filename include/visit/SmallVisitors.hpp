@@ -1,14 +1,21 @@
 #pragma once
 
 #include "ast/Expr.hpp"
+#include "ast/FlatExpr.hpp"
 #include <variant>
 
 namespace visit {
 
-auto
+inline auto
 id(const ast::Expr &expr)
 {
   return std::visit([](auto &node) { return node->id(); }, expr);
 }
 
+inline auto
+id(const ast::flat::Tree &tree, ast::flat::Expr expr)
+{
+  return std::visit([](auto &node) { return node.id(); }, tree[expr]);
+}
+
 }
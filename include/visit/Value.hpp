@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+
+#include "utils/Assert.hpp"
+#include "utils/StringInterner.hpp"
+
+namespace visit {
+
+// A Lox value at runtime: a number, a boolean, nil or a string, in one 64-bit word (NaN
+// boxing). Numbers are stored as they are. Everything else is hidden in the bits of a quiet
+// NaN that arithmetic never produces: the other kinds set the bits in `QUIET_NAN`, and then
+// either a small tag, or the sign bit and a pointer to an interned string (pointers only use
+// the low 48 bits on the 64-bit platforms we build for). Nothing is allocated, and copying a
+// value is copying a word.
+class Value {
+public:
+  static Value nil() { return Value(QUIET_NAN | NIL_TAG); }
+  static Value boolean(bool value) { return Value(QUIET_NAN | (value ? TRUE_TAG : FALSE_TAG)); }
+
+  static Value
+  number(double value)
+  {
+    // Any NaN with those bits set would be mistaken for something else, so all NaNs
+    // are stored as the one the hardware produces.
+    if (value != value) {
+      return Value(CANONICAL_NAN);
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return Value(bits);
+  }
+
+  static Value
+  string(utils::Symbol symbol)
+  {
+    ASSERT(symbol.isValid() && "Strings need to be interned");
+    const auto pointer = reinterpret_cast<uintptr_t>(symbol.raw());
+    ASSERT((pointer & ~POINTER_MASK) == 0 && "Pointer doesn't fit in a NaN");
+    return Value(SIGN_BIT | QUIET_NAN | pointer);
+  }
+
+  bool isNumber() const { return (bits_ & QUIET_NAN) != QUIET_NAN; }
+  bool isNil() const { return bits_ == (QUIET_NAN | NIL_TAG); }
+  bool isBool() const { return (bits_ | 1) == (QUIET_NAN | TRUE_TAG); }
+  bool isString() const { return (bits_ & (SIGN_BIT | QUIET_NAN)) == (SIGN_BIT | QUIET_NAN); }
+
+  double
+  asNumber() const
+  {
+    ASSERT(isNumber());
+    double value;
+    std::memcpy(&value, &bits_, sizeof(value));
+    return value;
+  }
+
+  bool
+  asBool() const
+  {
+    ASSERT(isBool());
+    return bits_ == (QUIET_NAN | TRUE_TAG);
+  }
+
+  utils::Symbol
+  asString() const
+  {
+    ASSERT(isString());
+    return utils::Symbol::fromRaw(reinterpret_cast<const void *>(bits_ & POINTER_MASK));
+  }
+
+  // Only nil and false are false in a condition.
+  bool isTruthy() const { return bits_ != (QUIET_NAN | NIL_TAG) && bits_ != (QUIET_NAN | FALSE_TAG); }
+
+  // Lox's `==`: values of different kinds are never equal, and numbers are compared as
+  // numbers (so NaN isn't equal to itself). Strings are interned, so comparing the words
+  // compares the strings.
+  friend bool
+  operator==(Value lhs, Value rhs)
+  {
+    if (lhs.isNumber() && rhs.isNumber()) {
+      return lhs.asNumber() == rhs.asNumber();
+    }
+    return lhs.bits_ == rhs.bits_;
+  }
+
+  friend bool operator!=(Value lhs, Value rhs) { return !(lhs == rhs); }
+
+  // As Lox prints it: numbers with up to six significant digits, and strings without quotes.
+  std::string
+  toString() const
+  {
+    if (isNumber()) {
+      char buffer[32];
+      std::snprintf(buffer, sizeof(buffer), "%g", asNumber());
+      return buffer;
+    }
+    if (isString()) {
+      return std::string(asString().str());
+    }
+    if (isBool()) {
+      return asBool() ? "true" : "false";
+    }
+    return "nil";
+  }
+
+private:
+  static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+  // The exponent, the quiet bit and the bit after it, which the hardware's NaN leaves clear.
+  static constexpr uint64_t QUIET_NAN = 0x7ffc000000000000;
+  static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+  static constexpr uint64_t POINTER_MASK = 0x0000ffffffffffff;
+  static constexpr uint64_t NIL_TAG = 1;
+  // These two only differ in the lowest bit (see `isBool`).
+  static constexpr uint64_t FALSE_TAG = 2;
+  static constexpr uint64_t TRUE_TAG = 3;
+
+  explicit Value(uint64_t bits) : bits_(bits) { }
+
+  uint64_t bits_;
+
+};
+
+static_assert(sizeof(Value) == sizeof(uint64_t), "Values should fit in a register");
+static_assert(sizeof(void *) == sizeof(uint64_t), "NaN boxing needs 64-bit pointers");
+
+}
@@ -5,8 +5,10 @@
 clean=
 run=
 test=
+bench=
+avx2=
 
-while getopts "crt" opt; do
+while getopts "crtba" opt; do
   case "$opt" in
     c)  clean="true"
       ;;
@@ -14,9 +16,24 @@ while getopts "crt" opt; do
       ;;
     t)  test="true"
       ;;
+    b)  bench="true"
+      ;;
+    a)  avx2="true"
+      ;;
   esac
 done
 
+# The AVX2 build (which needs a CPU with AVX2 to run) goes in a directory of its own,
+# and only the tests that go through the lexer's scanning are run against it.
+if [[ "$avx2" == "true" ]]; then
+  mkdir -p build-avx2 &&
+  cd build-avx2 &&
+  CXX=/usr/bin/clang++ cmake -DCMAKE_BUILD_TYPE=RelWithDebInfo -DLOX1_AVX2=ON -G"Unix Makefiles" ../ &&
+  make tests &&
+  ./tests --gtest_filter='Scan*:Lexer*:TokenStream*:Parser*'
+  exit $?
+fi
+
 mkdir -p build &&
 cd build &&
 CXX=/usr/bin/clang++ cmake -DCMAKE_BUILD_TYPE=RelWithDebInfo -G"Unix Makefiles"   ../ || exit -1
@@ -26,10 +43,13 @@ make_flags=""
 make_flags+=" Lox1 "
 [[ "$run" == "true" ]] && make_flags+=" main "
 [[ "$test" == "true" ]] && make_flags+=" tests "
+[[ "$bench" == "true" ]] && make_flags+=" benchmarks "
 make $make_flags || exit -1
 
 [[ "$test" == "true" ]] && ./tests
 
+[[ "$bench" == "true" ]] && ./benchmarks
+
 [[ "$run" == "true" ]] &&
 echo "" &&
 echo "=== RUNNING MAIN ===" &&
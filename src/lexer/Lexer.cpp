@@ -2,41 +2,31 @@
 
 #include <utility>
 #include <stdexcept>
-#include <unordered_map>
-
+#include <limits>
+#include <algorithm>
+#include <future>
+#include <iterator>
+
+#include "lexer/CharTable.h"
+#include "lexer/ReservedWords.h"
+#include "lexer/TokenStream.h"
+#include "lexer/Scan.h"
 #include "utils/Error.hpp"
 #include "utils/Assert.hpp"
+#include "utils/Number.hpp"
 
 namespace {
 
 constexpr auto ERROR_TAG = "Lexer";
 
-bool
-isWhitespace(char c)
-{
-  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
-}
-
 bool
 isEof(int peekResult)
 {
   return peekResult == std::char_traits<char>::eof();
 }
 
-bool
-isNumber(char c)
-{
-  return c >= '0' && c <= '9';
-}
-
-bool
-isIdentifierChar(char c)
-{
-  return c == '_' || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
-}
-
 void
-printContents(std::ostream &os, const std::string &contents, bool useDoubleQuotes)
+printContents(std::ostream &os, std::string_view contents, bool useDoubleQuotes)
 {
   os << "(";
   if (useDoubleQuotes) {
@@ -62,19 +52,60 @@ printContents(std::ostream &os, const std::string &contents, bool useDoubleQuote
   os << ")";
 }
 
+// Copies a token from an earlier lex, moved along by the given number of characters.
+// Its contents are taken from the new source because the buffer the old
+// token pointed into may not exist anymore.
+lexer::Token
+shiftToken(const lexer::Token &token, std::string_view sourceCode, int64_t offsetDelta)
+{
+  const auto span = token.getSpan();
+  const lexer::SourceSpan shiftedSpan { static_cast<uint32_t>(span.offset + offsetDelta), span.length };
+
+  std::string_view contents;
+  if (!token.getContents().empty()) {
+    // The contents are the whole lex, except for strings where they don't include the quotes.
+    const auto contentsOffset = shiftedSpan.offset + (token.getType() == lexer::Token::Type::STR ? 1 : 0);
+    contents = sourceCode.substr(contentsOffset, token.getContents().size());
+  }
+
+  return lexer::Token(
+    token.getType(),
+    contents,
+    shiftedSpan,
+    token.getSymbol(),
+    token.getNumber()
+  );
+}
+
 }
 
 namespace lexer {
 
 /// Token
 
-Token::Token(Type tokenType, unsigned lineNumber, std::string contents)
+Token::Token(
+  Type tokenType,
+  std::string_view contents,
+  SourceSpan span,
+  utils::Symbol symbol,
+  std::optional<double> number
+)
   : type_(tokenType)
-  , contents_(std::move(contents))
-  , lineNumber_(lineNumber)
-  { }
+  , hasNumber_(number.has_value())
+  , span_(span)
+  , contents_(contents)
+  , symbol_(symbol)
+{
+  ASSERT(!(number && symbol.isValid()) && "A token has a symbol or a number, not both");
+  if (number) {
+    number_ = *number;
+  }
+}
 
-const std::string &
+// Tokens are copied around a lot, and are kept in vectors of them.
+static_assert(sizeof(Token) <= 40);
+
+std::string_view
 Token::getContents() const
 {
   return contents_;
@@ -86,21 +117,28 @@ Token::getType() const
   return type_;
 }
 
-unsigned
-Token::getLineNumber() const
+SourceSpan
+Token::getSpan() const
 {
-  return lineNumber_;
+  return span_;
 }
 
-// These methods basically invert what the lexer does. It's kind of
-// silly in a way because when lexing we could just store the entire
-// string corrresponding to each lex, then we could get the contents of that
-// rather than having to do this. But that would be a waste of memory for
-// almost all token types. Probably the best way to do it would be to
-// make token effectively a range onto the input program (by storing
-// starting and ending line & column for each token), which we
-// could then go and re-read to recover the input. I think that's what
-// proper compilers do but I didn't think it was necessary at the time...
+utils::Symbol
+Token::getSymbol() const
+{
+  return hasNumber_ ? utils::Symbol() : symbol_;
+}
+
+std::optional<double>
+Token::getNumber() const
+{
+  return hasNumber_ ? std::optional<double>(number_) : std::nullopt;
+}
+
+// These methods basically invert what the lexer does. Tokens are now ranges
+// onto the input program (see `getSpan`), so the original text could be
+// recovered by re-reading the source buffer, but these don't need it: the
+// token type plus the captured contents are enough to print something useful.
 
 std::ostream &
 operator<<(std::ostream &os, const Token &token)
@@ -222,27 +260,63 @@ operator<<(std::ostream &os, const Token::Type &tokenType)
 
 Lexer::Lexer() =default;
 
+Lexer::Lexer(utils::StringInterner &strings)
+  : strings_(&strings)
+  { }
+
 std::vector<Token>
-Lexer::lex(const std::string &sourceCode)
+Lexer::lex(std::string_view sourceCode)
 {
-  sourceCode_ = std::stringstream(sourceCode);
-  // Reset state from last call (if any).
-  tokens_.clear();
-  currentLine_ = 1;
-  currentLex_.clear();
-  errors_.clear();
+  reset(sourceCode);
+
+  std::vector<Token> tokens;
+  do {
+    tokens.push_back(nextToken());
+  } while (tokens.back().getType() != Token::Type::EOFF);
+
+  return tokens;
+}
 
-  // Extract using `get` instead of streaming, because the format is for "unformatted"
-  // extraction e.g. doesn't strip whitespace (we don't want that because we're going
-  // to do it ourselves).
-  for (char c; sourceCode_.get(c); ) {
-    currentLex_.push_back(c);
-    lex(c);
+TokenStream
+Lexer::lexToStream(std::string_view sourceCode)
+{
+  reset(sourceCode);
+
+  TokenStream tokens;
+  while (true) {
+    const auto token = nextToken();
+    tokens.push_back(token);
+    if (token.getType() == Token::Type::EOFF) {
+      return tokens;
+    }
   }
+}
+
+void
+Lexer::reset(std::string_view sourceCode)
+{
+  // Spans are 32-bit to keep tokens small.
+  if (sourceCode.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Source code is too large to be lexed.");
+  }
+
+  sourceCode_ = sourceCode;
+  // Reset state from last source (if any).
+  current_ = 0;
+  lexStart_ = 0;
+  token_.reset();
+  errors_.clear();
+}
 
-  if (!sourceCode_.eof()) {
-    // Must have had an error with the stream. Can't do any more lexing, so fail.
-    throw std::runtime_error("Unable to read from source code input stream.");
+Token
+Lexer::nextToken()
+{
+  while (current_ < sourceCode_.size()) {
+    // Not every character makes a token (e.g. whitespace, comments, errors),
+    // so keep going until one does.
+    if (auto token = lexNext()) {
+      return *token;
+    }
   }
 
   if (!errors_.empty()) {
@@ -251,76 +325,282 @@ Lexer::lex(const std::string &sourceCode)
     throw ErrorCollection(std::move(errors_));
   }
 
+  lexStart_ = current_;
   addToken(Token::Type::EOFF);
-  // TODO: I think move is correct here because tokens_ isn't a local var -- check effective cpp book.
-  return std::move(tokens_);
+  return *std::exchange(token_, std::nullopt);
 }
 
-void
-Lexer::lex(char c)
+std::vector<Token>
+Lexer::lex(const char *begin, const char *end)
 {
-  // Whitespace.
-  if (isWhitespace(c)) {
-    if (c == '\n') {
-      ++currentLine_;
+  ASSERT(begin <= end);
+  return lex(std::string_view(begin, end - begin));
+}
+
+std::vector<Token>
+Lexer::relex(const std::vector<Token> &previousTokens, std::string_view sourceCode, const TextEdit &edit)
+{
+  ASSERT(!previousTokens.empty() && previousTokens.back().getType() == Token::Type::EOFF);
+  ASSERT(edit.offset + edit.insertedText.size() <= sourceCode.size());
+
+  const int64_t offsetDelta = static_cast<int64_t>(edit.insertedText.size()) - edit.removedLength;
+  const int64_t editEnd = edit.offset + edit.insertedText.size(); // in the edited source
+
+  // Find the first token that reaches the edit, then back up one more. Lexing a token
+  // can look a couple of characters past its end (e.g. whether `1.` continues as `1.5`),
+  // so the token just before the edit may have changed too, but nothing before that can have.
+  const auto firstAffected = std::partition_point(
+    previousTokens.cbegin(),
+    previousTokens.cend(),
+    [&edit](const Token &token) { return token.getSpan().offset + token.getSpan().length < edit.offset; }
+  );
+  const auto restart = firstAffected == previousTokens.cbegin() ? firstAffected : firstAffected - 1;
+
+  std::vector<Token> tokens;
+  tokens.reserve(previousTokens.size());
+  for (auto it = previousTokens.cbegin(); it != restart; ++it) {
+    tokens.push_back(shiftToken(*it, sourceCode, 0));
+  }
+
+  reset(sourceCode);
+  if (restart != previousTokens.cbegin()) {
+    current_ = restart->getSpan().offset;
+  }
+
+  // Lexing only depends on the text from the start of a token onwards. So once we're
+  // past the edit and lex a token that starts where one of the previous tokens did,
+  // the rest of the tokens will be the same as before, just shifted along.
+  auto previous = firstAffected;
+  while (true) {
+    auto token = nextToken();
+    const int64_t start = token.getSpan().offset;
+
+    if (start >= editEnd) {
+      while (previous != previousTokens.cend() && previous->getSpan().offset + offsetDelta < start) {
+        ++previous;
+      }
+
+      if (previous != previousTokens.cend() && previous->getSpan().offset + offsetDelta == start) {
+        ASSERT(previous->getType() == token.getType());
+
+        // The previous tokens were lexed without errors, so any errors must have come from the edit.
+        if (!errors_.empty()) {
+          throw ErrorCollection(std::move(errors_));
+        }
+
+        for (; previous != previousTokens.cend(); ++previous) {
+          tokens.push_back(shiftToken(*previous, sourceCode, offsetDelta));
+        }
+        return tokens;
+      }
+    }
+
+    tokens.push_back(token);
+    if (token.getType() == Token::Type::EOFF) {
+      return tokens;
     }
-    // Ignore it.
-    currentLex_.clear();
-    return;
   }
+}
 
-  // Single-character tokens.
-  switch (c) {
-    case '(': addToken(Token::Type::LPEREN); return;
-    case ')': addToken(Token::Type::RPEREN); return;
-    case '{': addToken(Token::Type::LBRACE); return;
-    case '}': addToken(Token::Type::RBRACE); return;
-    case ',': addToken(Token::Type::COMMA); return;
-    case '.': addToken(Token::Type::DOT); return;
-    case '-': addToken(Token::Type::MINUS); return;
-    case '+': addToken(Token::Type::PLUS); return;
-    case ';': addToken(Token::Type::SEMICOLON); return;
-    case '*': addToken(Token::Type::STAR); return;
-  }
-
-  // Single- or multi-character tokens.
-  switch (c) {
-    case '!': addToken(match('=') ? Token::Type::BANG_EQ : Token::Type::BANG); return;
-    case '=': addToken(match('=') ? Token::Type::EQ_EQ : Token::Type::EQ); return;
-    case '<': addToken(match('=') ? Token::Type::LT_EQ : Token::Type::LT); return;
-    case '>': addToken(match('=') ? Token::Type::GT_EQ : Token::Type::GT); return;
-  }
-
-  // Comments
-  if (c == '/') {
-    if (match('/')) lexComment();
-    else addToken(Token::Type::SLASH);
-    return;
+std::vector<Token>
+Lexer::lexParallel(std::string_view sourceCode, unsigned threadCount)
+{
+  if (threadCount <= 1) {
+    return lex(sourceCode);
+  }
+  reset(sourceCode);
+
+  // Split the source into roughly equal chunks, each starting at the beginning of a line.
+  // Comments always finish before there, so a chunk only starts lexing in the wrong place
+  // if a string spans its start (or the whitespace run before it).
+  std::vector<Chunk> chunks(threadCount);
+  for (unsigned i = 1; i < threadCount; ++i) {
+    const auto guess = std::max(sourceCode.size() * i / threadCount, chunks[i - 1].start);
+    const auto newline = scan::find(sourceCode.data() + guess, sourceEnd(), '\n');
+    chunks[i].start = newline == sourceEnd() ? sourceCode.size() : newline - sourceCode.data() + 1;
+    chunks[i - 1].stop = chunks[i].start;
+  }
+  chunks.back().stop = sourceCode.size();
+
+  std::vector<std::future<void>> lexes;
+  for (auto &chunk : chunks) {
+    lexes.push_back(std::async(std::launch::async, [&chunk, sourceCode] {
+      Lexer lexer;
+      lexer.reset(sourceCode);
+      lexer.current_ = chunk.start;
+      lexer.lexChunk(chunk);
+    }));
+  }
+  for (auto &lex : lexes) {
+    lex.get();
   }
 
-  // Strings
-  if (c == '"') {
-    lexString();
-    return;
+  // Stitch the chunks together. If the last lex of one chunk ran past the start of
+  // the next (e.g. a string straddled them) then the next chunk started lexing in
+  // the wrong place, so lex on from where the first chunk really finished until we
+  // make a token that a later chunk also made. Lexing only depends on the text from
+  // the start of a token onwards, so the chunks agree from there on.
+  std::vector<Token> tokens;
+  std::vector<CompileError> errors;
+  size_t position = 0;
+  for (size_t i = 0; i < chunks.size(); ) {
+    size_t resyncPosition = chunks[i].start;
+    size_t firstToken = 0;
+
+    if (position != chunks[i].start) {
+      ASSERT(position > chunks[i].start);
+      current_ = position;
+      bool isResynced = false;
+
+      while (current_ < sourceCode_.size()) {
+        const auto errorCount = errors_.size();
+        auto token = lexNext();
+        for (auto it = errors_.begin() + errorCount; it != errors_.end(); ++it) {
+          errors.push_back(*it);
+        }
+        if (!token) {
+          continue;
+        }
+
+        const size_t tokenStart = token->getSpan().offset;
+        while (i < chunks.size() && chunks[i].stop <= tokenStart) {
+          ++i;
+        }
+        if (i < chunks.size()) {
+          const auto &chunkTokens = chunks[i].tokens;
+          const auto it = std::partition_point(
+            chunkTokens.cbegin(),
+            chunkTokens.cend(),
+            [tokenStart](const Token &t) { return t.getSpan().offset < tokenStart; }
+          );
+          if (it != chunkTokens.cend() && it->getSpan().offset == tokenStart) {
+            isResynced = true;
+            resyncPosition = tokenStart;
+            firstToken = it - chunkTokens.cbegin();
+            break;
+          }
+        }
+        tokens.push_back(*token);
+      }
+
+      if (!isResynced) {
+        // Lexed all the way to the end without the chunks lining up again.
+        position = current_;
+        break;
+      }
+    }
+
+    auto &chunk = chunks[i];
+    if (tokens.empty() && firstToken == 0) {
+      tokens = std::move(chunk.tokens);
+    } else {
+      std::copy(chunk.tokens.cbegin() + firstToken, chunk.tokens.cend(), std::back_inserter(tokens));
+    }
+    for (const auto &error : chunk.errors) {
+      if (error.offset() >= resyncPosition) {
+        errors.push_back(error);
+      }
+    }
+    position = chunk.end;
+    ++i;
   }
 
-  // Numbers: we allow integers and decimals, but no leading or trailing decimal points.
-  if (isNumber(c)) {
-    lexNumber();
-    return;
+  if (!errors.empty()) {
+    throw ErrorCollection(std::move(errors));
   }
 
-  // Identifiers and reserved words
-  if (isIdentifierChar(c)) {
-    lexIdentifierOrReservedWord();
-    return;
+  if (strings_) {
+    // The chunks were lexed without interning because the interner isn't thread-safe.
+    std::vector<Token> internedTokens;
+    internedTokens.reserve(tokens.size() + 1);
+    for (const auto &token : tokens) {
+      internedTokens.push_back(intern(token));
+    }
+    tokens = std::move(internedTokens);
+  }
+
+  tokens.emplace_back(Token::Type::EOFF, std::string_view(), SourceSpan{ static_cast<uint32_t>(position), 0 });
+  return tokens;
+}
+
+void
+Lexer::lexChunk(Chunk &chunk)
+{
+  while (current_ < chunk.stop) {
+    if (auto token = lexNext()) {
+      chunk.tokens.push_back(*token);
+    }
+  }
+  chunk.end = current_;
+  chunk.errors = std::move(errors_);
+}
+
+Token
+Lexer::intern(const Token &token)
+{
+  ASSERT(strings_);
+  const auto type = token.getType();
+  if ((type != Token::Type::ID && type != Token::Type::STR) || token.getSymbol().isValid()) {
+    return token;
+  }
+  return Token(type, token.getContents(), token.getSpan(), strings_->intern(token.getContents()));
+}
+
+std::optional<Token>
+Lexer::lexNext()
+{
+  ASSERT(current_ < sourceCode_.size());
+  lexStart_ = current_;
+  lex(sourceCode_[current_++]);
+
+  return std::exchange(token_, std::nullopt);
+}
+
+void
+Lexer::lex(char c)
+{
+  const auto &info = charInfo(c);
+  switch (info.action) {
+    case LexAction::Whitespace:
+      // Ignore it, along with the rest of the run it starts.
+      seek(scan::skipWhitespace(position(), sourceEnd()));
+      return;
+
+    case LexAction::SingleCharToken:
+      addToken(info.token);
+      return;
+
+    case LexAction::MaybeEqualsToken:
+      addToken(match('=') ? info.longToken : info.token);
+      return;
+
+    case LexAction::Slash:
+      if (match('/')) lexComment();
+      else addToken(info.token);
+      return;
+
+    case LexAction::String:
+      lexString();
+      return;
+
+    // Numbers: we allow integers and decimals, but no leading or trailing decimal points.
+    case LexAction::Number:
+      lexNumber();
+      return;
+
+    case LexAction::IdentifierOrReservedWord:
+      lexIdentifierOrReservedWord();
+      return;
+
+    case LexAction::Unrecognized:
+      break;
   }
 
   // Unrecognised character.
   // TODO: better source snippet for this.
   errors_.push_back(
     CompileError(
-      currentLine_,
+      lexStart_,
       ERROR_TAG,
       std::string("Unrecognized character: '") + c + "'; ASCII: " + std::to_string(static_cast<int>(c)),
       ""
@@ -331,130 +611,136 @@ Lexer::lex(char c)
 void
 Lexer::addToken(Token::Type tokenType, bool includeContents)
 {
-  // TODO: should you always use emplace instead of move?
-  tokens_.push_back(Token(tokenType, currentLine_, includeContents ? std::move(currentLex_) : ""));
-  currentLex_.clear();
+  addToken(tokenType, includeContents ? currentLex() : std::string_view());
+}
+
+void
+Lexer::addToken(Token::Type tokenType, std::string_view contents, std::optional<double> number)
+{
+  const SourceSpan span {
+    static_cast<uint32_t>(lexStart_),
+    static_cast<uint32_t>(current_ - lexStart_)
+  };
+  ASSERT(!token_ && "Each character should produce at most one token");
+  const auto hasSymbol = strings_ && (tokenType == Token::Type::ID || tokenType == Token::Type::STR);
+  token_.emplace(tokenType, contents, span, hasSymbol ? strings_->intern(contents) : utils::Symbol(), number);
+}
+
+std::string_view
+Lexer::currentLex() const
+{
+  return sourceCode_.substr(lexStart_, current_ - lexStart_);
 }
 
 bool
 Lexer::match(char d)
 {
-  ASSERT(d != '\n' && "Trying to match newline, which won't increment line counter");
-  return match(
-    [d](char c) { return c == d; }
-  );
+  ASSERT(d != '\n' && "Newlines should only be skipped over as whitespace");
+  if (peek() == std::char_traits<char>::to_int_type(d)) {
+    consume();
+    return true;
+  }
+  // If the character doesn't match, nothing is consumed.
+  return false;
 }
 
 bool
-Lexer::match(const std::function<bool(char)> &predicate)
+Lexer::matchClass(uint8_t classes)
 {
-  char c2 = sourceCode_.peek();
-  if (isEof(c2)) {
-    return false;
-  } else if (predicate(c2)) {
-    // Extract c2 so it is consumed from the stream.
+  ASSERT(!(classes & WHITESPACE) && "Whitespace should only be skipped over in runs");
+  if (isInClass(peek(), classes)) {
     consume();
     return true;
-  } else {
-    // If the character doesn't match, the stream is unchanged.
-    return false;
   }
+  return false;
 }
 
 int
-Lexer::peekNext()
+Lexer::peek() const
 {
-  // We need a lookahead of two for lexing numbers but c++'s streams don't
-  // have that functionality. Instead, read two characters from the stream and
-  // put them back afterwards.
-  const int c1 = sourceCode_.peek();
-  if (isEof(c1)) {
-    return c1;
+  if (current_ >= sourceCode_.size()) {
+    return std::char_traits<char>::eof();
   }
+  return std::char_traits<char>::to_int_type(sourceCode_[current_]);
+}
 
-  const char c11 = sourceCode_.get(); // progress the stream
-  ASSERT(c11 == c1);
-
-  const int c2 = sourceCode_.peek();
-  sourceCode_.unget();
-  return c2;
-
+int
+Lexer::peekNext() const
+{
+  // We need a lookahead of two for lexing numbers.
+  if (current_ + 1 >= sourceCode_.size()) {
+    return std::char_traits<char>::eof();
+  }
+  return std::char_traits<char>::to_int_type(sourceCode_[current_ + 1]);
 }
 
 void
 Lexer::lexComment()
 {
-  ASSERT(currentLex_ == "//" && "Should only be called when '//' of comment has been lexed");
+  ASSERT(currentLex() == "//" && "Should only be called when '//' of comment has been lexed");
 
-  // Keep discarding characters until the line ends.
-  // Don't grab newlines because we only want to handle
+  // Discard characters until the line ends.
+  // Don't grab the newline because we only want to handle
   // them in one place in the lexer.
-  for ( int next = sourceCode_.peek();
-        !isEof(next) && next != '\n';
-        next = sourceCode_.peek()
-  ) {
-    sourceCode_.get(); // don't add to current lex since we don't want to keep it
-  }
-
-  // Discard all the characters in the comment. They are not useful to the compiler.
-  currentLex_.clear();
+  // The characters in the comment are not useful to the compiler, so no token is made.
+  seek(scan::find(position(), sourceEnd(), '\n'));
 }
 
 void
 Lexer::lexString()
 {
-  ASSERT(currentLex_ == "\"" && "should only be called when '\"' has been lexed");
+  ASSERT(currentLex() == "\"" && "should only be called when '\"' has been lexed");
 
-  int next;
-  for (
-    next = sourceCode_.peek();
-    !isEof(next) && next != '"';
-    next = sourceCode_.peek()
-  ) {
-    consume();
-  }
-  ASSERT(isEof(next) || next == '"');
+  // Strings can span lines, but nothing needs to keep track of them.
+  seek(scan::find(position(), sourceEnd(), '"'));
 
-  if (isEof(next)) {
+  if (isEof(peek())) {
     // Note down this error and let the lexing continue. It will
     // fail straight away and report the error along with any others
     // from earlier.
     errors_.push_back(
       CompileError(
-        currentLine_,
+        lexStart_,
         ERROR_TAG,
         "Unterminated string at end of file",
-        currentLex_
+        std::string(currentLex())
       )
     );
   } else {
-    const char c = sourceCode_.get(); // discard the '"'
-    ASSERT(c == '"');
-
-    // Make the token. It currently starts with a '"'; we
-    // don't want that in the input so we have to remove it.
-    currentLex_.erase(currentLex_.begin());
-    addToken(Token::Type::STR, true);
+    // The contents are everything between the quotes; we don't want
+    // the quotes themselves in the token.
+    const auto contents = currentLex().substr(1);
+    consume(); // the closing '"'
+    addToken(Token::Type::STR, contents);
   }
 }
 
 void
 Lexer::lexNumber()
 {
-  while (match(isNumber)) {
+  while (matchClass(DIGIT)) {
     // Keep collecting the numbers.
   }
 
   // We support decimal points but only if they're followed by more numbers.
   // e.g. 2.3 is allowed but 2. is not.
-  if (sourceCode_.peek() == '.' && isNumber(peekNext())) {
+  if (peek() == '.' && isInClass(peekNext(), DIGIT)) {
     consume(); // take the decimal point
-    while (match(isNumber)) {
+    while (matchClass(DIGIT)) {
       // Keep collecting the numbers.
     }
   }
 
-  addToken(Token::Type::NUM, true);
+  // Convert the number now, while its digits are still in cache, so that the parser
+  // doesn't need to go back to the text.
+  std::errc error;
+  const auto number = parseNumber(currentLex(), error);
+  if (!number) {
+    // Same as other lexing errors: note it down and carry on.
+    errors_.push_back(CompileError(lexStart_, ERROR_TAG, describeNumberError(error), std::string(currentLex())));
+    return;
+  }
+  addToken(Token::Type::NUM, currentLex(), number);
 }
 
 void
@@ -462,42 +748,42 @@ Lexer::lexIdentifierOrReservedWord()
 {
   // We have already consumed the first character. Subsequent ones can either be indentifier
   // characters or numbers.
-  while (match([](char c) { return isIdentifierChar(c) || isNumber(c); })) {
+  while (matchClass(LETTER | DIGIT)) {
     // Keep consuming.
   }
 
   // We have consumed the entire identifier. Check if it's a reserved word.
-  static const std::unordered_map<std::string, Token::Type> reservedWordMap {
-    { "for", Token::Type::FOR },
-    { "if", Token::Type::IF },
-    { "and", Token::Type::AND },
-    { "class", Token::Type::CLASS },
-    { "else", Token::Type::ELSE },
-    { "false", Token::Type::FALSE },
-    { "fun", Token::Type::FUN },
-    { "nil", Token::Type::NIL },
-    { "or", Token::Type::OR },
-    { "print", Token::Type::PRINT },
-    { "return", Token::Type::RETURN },
-    { "super", Token::Type::SUPER },
-    { "this", Token::Type::THIS },
-    { "true", Token::Type::TRUE },
-    { "var", Token::Type::VAR },
-    { "while", Token::Type::WHILE },
-  };
-
-  const auto reservedWordTokenIt = reservedWordMap.find(currentLex_.c_str());
-  if (reservedWordTokenIt == reservedWordMap.cend()) {
-    addToken(Token::Type::ID, true);
+  if (const auto reservedWord = reservedWordType(currentLex())) {
+    addToken(*reservedWord, false);
   } else {
-    addToken(reservedWordTokenIt->second, false);
+    addToken(Token::Type::ID, true);
   }
 }
 
 void
 Lexer::consume()
 {
-  currentLex_.push_back(sourceCode_.get());
+  ASSERT(current_ < sourceCode_.size());
+  ++current_;
+}
+
+const char *
+Lexer::position() const
+{
+  return sourceCode_.data() + current_;
+}
+
+const char *
+Lexer::sourceEnd() const
+{
+  return sourceCode_.data() + sourceCode_.size();
+}
+
+void
+Lexer::seek(const char *newPosition)
+{
+  ASSERT(newPosition >= position() && newPosition <= sourceEnd());
+  current_ = newPosition - sourceCode_.data();
 }
 
 }
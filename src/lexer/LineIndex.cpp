@@ -0,0 +1,62 @@
+#include "lexer/LineIndex.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "lexer/Scan.h"
+#include "utils/Assert.hpp"
+
+namespace lexer {
+
+LineIndex::LineIndex(std::string_view sourceCode)
+{
+  const auto begin = sourceCode.data();
+  const auto end = begin + sourceCode.size();
+
+  // Counting first is cheap next to finding them one by one, and saves regrowing the table.
+  lineStarts_.reserve(scan::countNewlines(begin, end) + 1);
+  lineStarts_.push_back(0);
+  for (auto newline = scan::find(begin, end, '\n'); newline != end; newline = scan::find(newline + 1, end, '\n')) {
+    lineStarts_.push_back(static_cast<uint32_t>(newline - begin + 1));
+  }
+}
+
+SourcePosition
+LineIndex::position(uint32_t offset) const
+{
+  // The line is the last one that starts at or before the offset.
+  const auto next = std::upper_bound(lineStarts_.cbegin(), lineStarts_.cend(), offset);
+  ASSERT(next != lineStarts_.cbegin());
+  const auto line = next - 1;
+  return {
+    static_cast<unsigned>(line - lineStarts_.cbegin() + 1),
+    static_cast<unsigned>(offset - *line + 1)
+  };
+}
+
+size_t
+LineIndex::lineCount() const
+{
+  return lineStarts_.size();
+}
+
+std::string
+describe(const CompileError &error, const LineIndex &lines)
+{
+  const auto position = lines.position(error.offset());
+  return error.describeAt("Line " + std::to_string(position.line) + ", column " + std::to_string(position.column));
+}
+
+std::string
+describe(const ErrorCollection &errors, const LineIndex &lines)
+{
+  std::stringstream stream;
+
+  for (auto &error : errors.errors()) {
+    stream << describe(error, lines) << std::endl;
+  }
+
+  return stream.str();
+}
+
+}
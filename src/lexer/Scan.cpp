@@ -0,0 +1,167 @@
+#include "lexer/Scan.h"
+
+#include <cstdint>
+
+#include "lexer/CharTable.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// The vector code compares against each whitespace character in turn, so it has its
+// own list of them, which needs to match the lexer's character table.
+constexpr char WHITESPACE_CHARS[] = { ' ', '\n', '\r', '\t' };
+
+constexpr bool
+matchesCharTable()
+{
+  int count = 0;
+  for (int c = 0; c < 256; ++c) {
+    count += lexer::isInClass(c, lexer::WHITESPACE);
+  }
+  for (const char c : WHITESPACE_CHARS) {
+    if (!lexer::isInClass(c, lexer::WHITESPACE)) {
+      return false;
+    }
+  }
+  return count == sizeof(WHITESPACE_CHARS);
+}
+
+static_assert(matchesCharTable());
+
+#if defined(__AVX2__)
+
+constexpr size_t BLOCK_SIZE = 32;
+using Mask = uint32_t;
+using Block = __m256i;
+
+Block
+load(const char *p)
+{
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+// One bit per byte of the block, set where that byte equals `c`.
+Mask
+equalMask(Block block, char c)
+{
+  return static_cast<Mask>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c))));
+}
+
+#elif defined(__SSE2__)
+
+constexpr size_t BLOCK_SIZE = 16;
+using Mask = uint32_t;
+using Block = __m128i;
+
+Block
+load(const char *p)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+Mask
+equalMask(Block block, char c)
+{
+  return static_cast<Mask>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c))));
+}
+
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+constexpr Mask FULL_MASK = BLOCK_SIZE == 32 ? ~Mask{0} : (Mask{1} << BLOCK_SIZE) - 1;
+
+Mask
+whitespaceMask(Block block)
+{
+  return equalMask(block, WHITESPACE_CHARS[0]) | equalMask(block, WHITESPACE_CHARS[1])
+    | equalMask(block, WHITESPACE_CHARS[2]) | equalMask(block, WHITESPACE_CHARS[3]);
+}
+
+#endif
+
+}
+
+namespace lexer::scan {
+
+size_t
+blockSize()
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+  return BLOCK_SIZE;
+#else
+  return 1;
+#endif
+}
+
+const char *
+find(const char *begin, const char *end, char c)
+{
+  auto p = begin;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  for (; static_cast<size_t>(end - p) >= BLOCK_SIZE; p += BLOCK_SIZE) {
+    if (const auto mask = equalMask(load(p), c)) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+
+  for (; p != end; ++p) {
+    if (*p == c) {
+      return p;
+    }
+  }
+  return end;
+}
+
+size_t
+countNewlines(const char *begin, const char *end)
+{
+  auto p = begin;
+  size_t count = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  for (; static_cast<size_t>(end - p) >= BLOCK_SIZE; p += BLOCK_SIZE) {
+    count += __builtin_popcount(equalMask(load(p), '\n'));
+  }
+#endif
+
+  for (; p != end; ++p) {
+    count += *p == '\n';
+  }
+  return count;
+}
+
+const char *
+skipWhitespace(const char *begin, const char *end)
+{
+  auto p = begin;
+
+  // Most runs are a single space between tokens, so it isn't worth
+  // loading a whole block to find out that there's nothing to skip.
+  if (p == end || !isInClass(*p, WHITESPACE)) {
+    return p;
+  }
+
+#if defined(__AVX2__) || defined(__SSE2__)
+  for (; static_cast<size_t>(end - p) >= BLOCK_SIZE; p += BLOCK_SIZE) {
+    const auto nonWhitespaceMask = ~whitespaceMask(load(p)) & FULL_MASK;
+    if (nonWhitespaceMask) {
+      return p + __builtin_ctz(nonWhitespaceMask);
+    }
+  }
+#endif
+
+  while (p != end && isInClass(*p, WHITESPACE)) {
+    ++p;
+  }
+  return p;
+}
+
+}
@@ -0,0 +1,138 @@
+#include "lexer/SourceBuffer.h"
+
+#include <stdexcept>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+[[noreturn]] void
+throwSystemError(const std::string &what, const std::string &path)
+{
+  throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+// Closes the file on the way out, however we leave.
+class FileDescriptor {
+public:
+  explicit FileDescriptor(int fd) : fd_(fd) { }
+  FileDescriptor(const FileDescriptor &) =delete;
+  FileDescriptor &operator=(const FileDescriptor &) =delete;
+  ~FileDescriptor() { if (fd_ >= 0) ::close(fd_); }
+
+  int get() const { return fd_; }
+
+private:
+  const int fd_;
+
+};
+
+// Fallback for files we can't get the size of up front.
+std::string
+readAll(int fd, const std::string &path)
+{
+  std::string contents;
+  char block[1 << 16];
+  while (true) {
+    const auto count = ::read(fd, block, sizeof(block));
+    if (count == 0) {
+      return contents;
+    }
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throwSystemError("Could not read", path);
+    }
+    contents.append(block, static_cast<size_t>(count));
+  }
+}
+
+}
+
+namespace lexer {
+
+SourceBuffer
+SourceBuffer::fromFile(const std::string &path)
+{
+  const FileDescriptor file(::open(path.c_str(), O_RDONLY));
+  if (file.get() < 0) {
+    throwSystemError("Could not open", path);
+  }
+
+  struct stat status;
+  if (::fstat(file.get(), &status) != 0) {
+    throwSystemError("Could not stat", path);
+  }
+
+  SourceBuffer buffer;
+  // Empty files can't be mapped, but there's nothing to read from them either.
+  if (S_ISREG(status.st_mode) && status.st_size > 0) {
+    const auto size = static_cast<size_t>(status.st_size);
+    const auto mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.get(), 0);
+    if (mapping != MAP_FAILED) {
+      // The lexer reads straight through the source, so let the kernel read ahead.
+      ::madvise(mapping, size, MADV_SEQUENTIAL);
+      buffer.mapping_ = mapping;
+      buffer.mappingSize_ = size;
+      return buffer;
+    }
+  }
+
+  buffer.contents_ = readAll(file.get(), path);
+  return buffer;
+}
+
+SourceBuffer::SourceBuffer(std::string contents)
+  : contents_(std::move(contents))
+  { }
+
+SourceBuffer::SourceBuffer(SourceBuffer &&other) noexcept
+  : mapping_(std::exchange(other.mapping_, nullptr))
+  , mappingSize_(std::exchange(other.mappingSize_, 0))
+  , contents_(std::move(other.contents_))
+  { }
+
+SourceBuffer &
+SourceBuffer::operator=(SourceBuffer &&other) noexcept
+{
+  if (this != &other) {
+    if (mapping_) {
+      ::munmap(mapping_, mappingSize_);
+    }
+    mapping_ = std::exchange(other.mapping_, nullptr);
+    mappingSize_ = std::exchange(other.mappingSize_, 0);
+    contents_ = std::move(other.contents_);
+  }
+  return *this;
+}
+
+SourceBuffer::~SourceBuffer()
+{
+  if (mapping_) {
+    ::munmap(mapping_, mappingSize_);
+  }
+}
+
+std::string_view
+SourceBuffer::view() const
+{
+  if (mapping_) {
+    return std::string_view(static_cast<const char *>(mapping_), mappingSize_);
+  }
+  return contents_;
+}
+
+bool
+SourceBuffer::isMapped() const
+{
+  return mapping_ != nullptr;
+}
+
+}
@@ -0,0 +1,70 @@
+#include "lexer/TokenSource.h"
+
+#include <utility>
+
+namespace lexer {
+
+/// VectorTokenSource
+
+VectorTokenSource::VectorTokenSource(std::vector<Token> tokens)
+  : tokens_(std::move(tokens))
+  { }
+
+std::optional<Token>
+VectorTokenSource::next()
+{
+  if (next_ >= tokens_.size()) {
+    return std::nullopt;
+  }
+  // Each token is only handed out once, so it can be moved out.
+  return std::move(tokens_[next_++]);
+}
+
+/// TokenStreamSource
+
+TokenStreamSource::TokenStreamSource(const TokenStream &tokens)
+  : tokens_(tokens)
+  { }
+
+std::optional<Token>
+TokenStreamSource::next()
+{
+  if (next_ >= tokens_.size()) {
+    return std::nullopt;
+  }
+
+  const auto payloadIndex = nextPayload_;
+  if (TokenStream::hasPayload(tokens_.type(next_))) {
+    ++nextPayload_;
+  }
+  return tokens_.token(next_++, payloadIndex);
+}
+
+/// LexerTokenSource
+
+LexerTokenSource::LexerTokenSource(Lexer &lexer, std::string_view sourceCode)
+  : lexer_(lexer)
+{
+  lexer_.reset(sourceCode);
+}
+
+std::optional<Token>
+LexerTokenSource::next()
+{
+  if (isFinished_) {
+    return std::nullopt;
+  }
+
+  auto token = lexer_.nextToken();
+  isFinished_ = token.getType() == Token::Type::EOFF;
+  return token;
+}
+
+void
+LexerTokenSource::throwPendingErrors()
+{
+  // The lexer throws once it reaches the end, if it found any errors on the way.
+  while (next()) { }
+}
+
+}
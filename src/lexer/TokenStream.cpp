@@ -0,0 +1,157 @@
+#include "lexer/TokenStream.h"
+
+#include "utils/Assert.hpp"
+
+namespace {
+
+using lexer::Token;
+
+// Length of the source text for tokens that are always spelled the same way.
+uint32_t
+fixedLength(Token::Type type)
+{
+  switch (type) {
+    case Token::Type::BANG_EQ:
+    case Token::Type::EQ_EQ:
+    case Token::Type::GT_EQ:
+    case Token::Type::LT_EQ:
+    case Token::Type::IF:
+    case Token::Type::OR:
+      return 2;
+    case Token::Type::AND:
+    case Token::Type::FUN:
+    case Token::Type::FOR:
+    case Token::Type::NIL:
+    case Token::Type::VAR:
+      return 3;
+    case Token::Type::ELSE:
+    case Token::Type::TRUE:
+    case Token::Type::THIS:
+      return 4;
+    case Token::Type::CLASS:
+    case Token::Type::FALSE:
+    case Token::Type::PRINT:
+    case Token::Type::SUPER:
+    case Token::Type::WHILE:
+      return 5;
+    case Token::Type::RETURN:
+      return 6;
+    case Token::Type::EOFF:
+      return 0;
+    default:
+      // The rest of the fixed tokens are single characters. Tokens with contents
+      // shouldn't get here.
+      ASSERT(!lexer::TokenStream::hasPayload(type));
+      return 1;
+  }
+}
+
+}
+
+namespace lexer {
+
+TokenStream::Payload::Payload(const Token &token)
+  : contents(token.getContents().data())
+  , length(static_cast<uint32_t>(token.getContents().size()))
+  , hasNumber(token.getNumber().has_value())
+  , symbol(token.getSymbol())
+{
+  if (hasNumber) {
+    number = *token.getNumber();
+  }
+}
+
+void
+TokenStream::push_back(const Token &token)
+{
+  types_.push_back(static_cast<uint8_t>(token.getType()));
+  offsets_.push_back(token.getSpan().offset);
+  if (hasPayload(token.getType())) {
+    payloads_.emplace_back(token);
+  }
+}
+
+void
+TokenStream::reserve(size_t tokenCount)
+{
+  types_.reserve(tokenCount);
+  offsets_.reserve(tokenCount);
+}
+
+size_t
+TokenStream::size() const
+{
+  return types_.size();
+}
+
+bool
+TokenStream::empty() const
+{
+  return types_.empty();
+}
+
+Token::Type
+TokenStream::type(size_t index) const
+{
+  return static_cast<Token::Type>(types_[index]);
+}
+
+uint32_t
+TokenStream::offset(size_t index) const
+{
+  return offsets_[index];
+}
+
+Token
+TokenStream::token(size_t index, size_t payloadIndex) const
+{
+  const auto tokenType = type(index);
+  if (!hasPayload(tokenType)) {
+    return Token(tokenType, std::string_view(), { offset(index), fixedLength(tokenType) });
+  }
+
+  // Strings' spans include their quotes but their contents don't.
+  const auto contents = this->contents(payloadIndex);
+  const auto length = static_cast<uint32_t>(contents.size()) + (tokenType == Token::Type::STR ? 2 : 0);
+  return Token(tokenType, contents, { offset(index), length }, symbol(payloadIndex), number(payloadIndex));
+}
+
+std::string_view
+TokenStream::contents(size_t payloadIndex) const
+{
+  ASSERT(payloadIndex < payloads_.size());
+  const auto &payload = payloads_[payloadIndex];
+  return std::string_view(payload.contents, payload.length);
+}
+
+utils::Symbol
+TokenStream::symbol(size_t payloadIndex) const
+{
+  ASSERT(payloadIndex < payloads_.size());
+  const auto &payload = payloads_[payloadIndex];
+  return payload.hasNumber ? utils::Symbol() : payload.symbol;
+}
+
+std::optional<double>
+TokenStream::number(size_t payloadIndex) const
+{
+  ASSERT(payloadIndex < payloads_.size());
+  const auto &payload = payloads_[payloadIndex];
+  return payload.hasNumber ? std::optional<double>(payload.number) : std::nullopt;
+}
+
+bool
+TokenStream::hasPayload(Token::Type type)
+{
+  return type == Token::Type::ID || type == Token::Type::STR || type == Token::Type::NUM;
+}
+
+size_t
+TokenStream::memoryUsage() const
+{
+  return types_.capacity() * sizeof(uint8_t)
+    + offsets_.capacity() * sizeof(uint32_t)
+    + payloads_.capacity() * sizeof(Payload);
+}
+
+}
@@ -1,16 +1,53 @@
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <filesystem>
-#include <fstream>
+#include <stdexcept>
+#include <optional>
 
+#include "lexer/Lexer.h"
+#include "lexer/LineIndex.h"
+#include "lexer/SourceBuffer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+#include "utils/Error.hpp"
 #include "utils/Logging.hpp"
+#include "utils/StringInterner.hpp"
+#include "visit/Evaluator.hpp"
 
 namespace fs = std::filesystem;
 
 void
-run(const std::string &program)
+run(std::string_view program)
 {
-  LOGD("The input is ", program);
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto tokens = lexer.lexToStream(program);
+  parser::Parser parser(strings);
+  const auto expr = parser.parse(tokens);
+
+  visit::Evaluator evaluator(strings);
+  std::cout << evaluator.evaluate(expr).toString() << std::endl;
+}
+
+// Runs `program`, and reports what went wrong if it fails. Errors in the source are shown
+// with their line and column. Returns whether it ran to the end.
+bool
+runAndReport(std::string_view program, std::string_view name)
+{
+  try {
+    run(program);
+    return true;
+  } catch (const ErrorCollection &errors) {
+    LOGE(lexer::describe(errors, lexer::LineIndex(program)));
+  } catch (const CompileError &error) {
+    LOGE(lexer::describe(error, lexer::LineIndex(program)));
+  } catch (const std::runtime_error &e) {
+    LOGE("Error in ", name, ": ", e.what());
+  } catch (...) {
+    LOGE("Error in ", name);
+  }
+  return false;
 }
 
 void
@@ -18,33 +55,24 @@ runPrompt()
 {
   std::string input;
   while (std::cout << "> ", getline(std::cin, input)) {
-    try {
-      run(input);
-    } catch (...) {
-      // TODO: actual error reporting.
-      LOGE("Error with input: ", input);
-    }
+    runAndReport(input, "input");
   }
 }
 
 void
 runFile(const char *fileName)
 {
-  std::ifstream fileStream(fileName);
-  if (!fileStream.good()) {
-    LOGE("Could not open for I/O: ", fileName);
+  // The file is mapped rather than copied into memory, so the buffer has to
+  // stay alive for as long as anything refers into the source.
+  std::optional<lexer::SourceBuffer> source;
+  try {
+    source.emplace(lexer::SourceBuffer::fromFile(fileName));
+  } catch (const std::runtime_error &e) {
+    LOGE("Could not open for I/O: ", e.what());
     return;
   }
 
-  std::stringstream stringStream;
-  stringStream << fileStream.rdbuf();
-
-  try {
-    run(stringStream.str());
-  } catch (...) {
-    // TODO: actual error reporting.
-    LOGE("Error in file: ", fileName);
-    // Should use non-zero exit code in this case.
+  if (!runAndReport(source->view(), fileName)) {
     exit(-1);
   }
 }
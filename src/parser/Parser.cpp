@@ -1,6 +1,9 @@
 #include "parser/Parser.h"
 
+#include <array>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <exception>
 #include <string>
 #include <sstream>
@@ -8,6 +11,7 @@
 #include "utils/Error.hpp"
 #include "utils/Counter.hpp"
 #include "utils/Assert.hpp"
+#include "utils/Number.hpp"
 
 // TODO: add source snippets to CompileErrors
 
@@ -23,173 +27,325 @@ namespace {
 
 constexpr auto ERROR_TAG = "Parser";
 
+struct BinaryOperator {
+  uint8_t bindingPower = 0; // higher binds more tightly; 0 for tokens that aren't binary operators
+  BinOp::Op operation = BinOp::Op::Eq;
+};
+
+constexpr size_t TOKEN_TYPE_COUNT = static_cast<size_t>(Token::Type::EOFF) + 1;
+
+// Every binary operator's precedence and the node it makes, indexed by token type.
+constexpr std::array<BinaryOperator, TOKEN_TYPE_COUNT>
+makeOperatorTable()
+{
+  std::array<BinaryOperator, TOKEN_TYPE_COUNT> table {};
+  const auto add = [&table](Token::Type token, uint8_t bindingPower, BinOp::Op operation) {
+    table[static_cast<size_t>(token)] = { bindingPower, operation };
+  };
+
+  add(Token::Type::EQ_EQ, 1, BinOp::Op::Eq);
+  add(Token::Type::BANG_EQ, 1, BinOp::Op::Neq);
+
+  add(Token::Type::GT, 2, BinOp::Op::Gt);
+  add(Token::Type::GT_EQ, 2, BinOp::Op::GtEq);
+  add(Token::Type::LT, 2, BinOp::Op::Lt);
+  add(Token::Type::LT_EQ, 2, BinOp::Op::LtEq);
+
+  add(Token::Type::MINUS, 3, BinOp::Op::Sub);
+  add(Token::Type::PLUS, 3, BinOp::Op::Add);
+
+  add(Token::Type::SLASH, 4, BinOp::Op::Div);
+  add(Token::Type::STAR, 4, BinOp::Op::Mult);
+
+  return table;
+}
+
+constexpr std::array<BinaryOperator, TOKEN_TYPE_COUNT> OPERATOR_TABLE = makeOperatorTable();
+
+constexpr const BinaryOperator &
+binaryOperator(Token::Type token)
+{
+  return OPERATOR_TABLE[static_cast<size_t>(token)];
+}
+
+static_assert(binaryOperator(Token::Type::STAR).bindingPower > binaryOperator(Token::Type::PLUS).bindingPower);
+static_assert(binaryOperator(Token::Type::LPEREN).bindingPower == 0);
+
+// The parser reads tokens through a cursor, which holds the token most recently consumed
+// (the current token) and one token of lookahead (the next token). Both cursors have the
+// same members, and the parser is instantiated for each, so there are no virtual calls
+// per token on either.
+
+// Copies tokens out of a `TokenSource` one at a time, as it hands them out.
+class SourceCursor {
+public:
+  explicit SourceCursor(lexer::TokenSource &tokens)
+    : tokens_(tokens)
+    , next_(tokens.next())
+    { }
+
+  bool hasNext() const { return next_.has_value(); }
+  Token::Type nextType() const { return next_->getType(); }
+  uint32_t nextOffset() const { return next_->getSpan().offset; }
+  Token nextToken() const { return *next_; }
+  // Only asked once parsing is done, since the source has to give up the token after
+  // the next one to answer.
+  bool nextIsLast() { return !tokens_.next(); }
+
+  void
+  advance()
+  {
+    ASSERT(hasNext() && "Advancing past the end of the tokens");
+    // Hand the lookahead over rather than copying it, and take the next one straight
+    // from the source.
+    current_ = std::move(next_);
+    next_ = tokens_.next();
+  }
+
+  bool hasCurrent() const { return current_.has_value(); }
+  Token::Type currentType() const { return current_->getType(); }
+  uint32_t currentOffset() const { return current_->getSpan().offset; }
+  std::string_view currentContents() const { return current_->getContents(); }
+  utils::Symbol currentSymbol() const { return current_->getSymbol(); }
+  std::optional<double> currentNumber() const { return current_->getNumber(); }
+
+  void throwPendingErrors() { tokens_.throwPendingErrors(); }
+
+private:
+  lexer::TokenSource &tokens_;
+  std::optional<Token> current_;
+  std::optional<Token> next_;
+};
+
+// Reads a `TokenStream` where it is. Deciding what to parse only looks at the array of
+// token types, and the side table is only read for the contents of the current token.
+class StreamCursor {
+public:
+  explicit StreamCursor(const lexer::TokenStream &tokens)
+    : tokens_(tokens)
+    { }
+
+  bool hasNext() const { return next_ < tokens_.size(); }
+  Token::Type nextType() const { return tokens_.type(next_); }
+  uint32_t nextOffset() const { return tokens_.offset(next_); }
+  Token nextToken() const { return tokens_.token(next_, nextPayload_); }
+  bool nextIsLast() const { return next_ + 1 == tokens_.size(); }
+
+  void
+  advance()
+  {
+    ASSERT(hasNext() && "Advancing past the end of the tokens");
+    currentPayload_ = nextPayload_;
+    nextPayload_ += lexer::TokenStream::hasPayload(nextType());
+    ++next_;
+  }
+
+  // The current token is always the one before the next.
+  bool hasCurrent() const { return next_ > 0; }
+  Token::Type currentType() const { return tokens_.type(next_ - 1); }
+  uint32_t currentOffset() const { return tokens_.offset(next_ - 1); }
+
+  std::string_view
+  currentContents() const
+  {
+    return lexer::TokenStream::hasPayload(currentType()) ? tokens_.contents(currentPayload_) : std::string_view();
+  }
+
+  utils::Symbol currentSymbol() const { return tokens_.symbol(currentPayload_); }
+  std::optional<double> currentNumber() const { return tokens_.number(currentPayload_); }
+
+  // The tokens were all lexed before parsing started, so any errors have been thrown already.
+  void throwPendingErrors() { }
+
+private:
+  const lexer::TokenStream &tokens_;
+  size_t next_ = 0;
+  size_t nextPayload_ = 0; // the next token's entry in the side table, if it has one
+  size_t currentPayload_ = 0; // likewise for the current token
+};
+
 }
 
 namespace parser {
 
+Parser::Parser(utils::StringInterner &strings)
+  : strings_(&strings)
+  { }
+
 Expr
 Parser::parse(std::vector<Token> tokens)
 {
-  current_ = -1;
-  tokens_ = std::move(tokens);
- 
-  // Exceptions flow out of here if parsing fails. Once we add statements, there will be
-  // some kind of error recovery & error accumulation here, like in the lexer.
-  auto expr = expression();
-
-  // Expect that we are pointing at the last non-eof token, and the next (and last)
-  // token is eof.
-  const auto isParsingSuccessful =
-    current_ == tokens_.size() - 2 && tokens_[tokens_.size() - 1].getType() == Token::Type::EOFF;
-  if (!isParsingSuccessful) {
-    std::optional<Token> currentOrNull = current_ < tokens_.size() ? std::optional(current()) : std::nullopt;
-    throw CompileError(
-      (currentOrNull ? currentOrNull->getLineNumber() : -1),
-      ERROR_TAG,
-      "Expected end of program but there were more tokens remaining.",
-      (currentOrNull ? currentOrNull->getContents() : "")
-    );
-  }
-
-  return expr;
+  lexer::VectorTokenSource source(std::move(tokens));
+  return parse(source);
 }
 
 Expr
-Parser::expression()
+Parser::parse(lexer::TokenSource &tokens)
 {
-  return equality();
+  SourceCursor cursor(tokens);
+  ast::Factory factory(ids_);
+  return parseWith(cursor, factory);
 }
 
 Expr
-Parser::equality()
+Parser::parse(const lexer::TokenStream &tokens)
 {
-  // Instead of defining these mapping functions everywhere, it would probably be better to have one mapping function
-  // per ast enum that converts all valid lexer tokens to their respective value of that enum or throws if that's not possible.
-  const auto mappingFunc = [](Token::Type lexerToken) {
-    switch (lexerToken) {
-      case Token::Type::EQ_EQ: return BinOp::Op::Eq;
-      case Token::Type::BANG_EQ: return BinOp::Op::Neq;
-      DEFAULT_SWITCH_CASE
-    }
-  };
+  StreamCursor cursor(tokens);
+  ast::Factory factory(ids_);
+  return parseWith(cursor, factory);
+}
 
-  return createBinOp(mappingFunc, [this] { return comparison(); }, Token::Type::EQ_EQ, Token::Type::BANG_EQ);
+ast::arena::Expr
+Parser::parse(lexer::TokenSource &tokens, Arena &arena)
+{
+  SourceCursor cursor(tokens);
+  ast::arena::Factory factory(arena, ids_);
+  return parseWith(cursor, factory);
 }
 
-Expr
-Parser::comparison()
+ast::arena::Expr
+Parser::parse(const lexer::TokenStream &tokens, Arena &arena)
 {
-  const auto mappingFunc = [](Token::Type lexerToken) {
-    switch (lexerToken) {
-      case Token::Type::GT: return BinOp::Op::Gt;
-      case Token::Type::GT_EQ: return BinOp::Op::GtEq;
-      case Token::Type::LT: return BinOp::Op::Lt;
-      case Token::Type::LT_EQ: return BinOp::Op::LtEq;
-      DEFAULT_SWITCH_CASE
-    }
-  };
+  StreamCursor cursor(tokens);
+  ast::arena::Factory factory(arena, ids_);
+  return parseWith(cursor, factory);
+}
 
-  return createBinOp(
-    mappingFunc,
-    [this] { return term(); },
-    Token::Type::GT,
-    Token::Type::GT_EQ,
-    Token::Type::LT,
-    Token::Type::LT_EQ
-  );
+ast::flat::Expr
+Parser::parse(lexer::TokenSource &tokens, ast::flat::Tree &tree, Subtrees subtrees)
+{
+  SourceCursor cursor(tokens);
+  return parseFlat(cursor, tree, subtrees);
 }
 
-Expr
-Parser::term()
+ast::flat::Expr
+Parser::parse(const lexer::TokenStream &tokens, ast::flat::Tree &tree, Subtrees subtrees)
 {
-  const auto mappingFunc = [](Token::Type lexerToken) {
-    switch (lexerToken) {
-      case Token::Type::MINUS: return BinOp::Op::Sub;
-      case Token::Type::PLUS: return BinOp::Op::Add;
-      DEFAULT_SWITCH_CASE
-    }
-  };
+  StreamCursor cursor(tokens);
+  return parseFlat(cursor, tree, subtrees);
+}
 
-  return createBinOp(mappingFunc, [this] { return factor(); }, Token::Type::MINUS, Token::Type::PLUS);
+template <class Tokens>
+ast::flat::Expr
+Parser::parseFlat(Tokens &tokens, ast::flat::Tree &tree, Subtrees subtrees)
+{
+  if (subtrees == Subtrees::Shared) {
+    ast::flat::SharingFactory factory(tree, ids_);
+    return parseWith(tokens, factory);
+  }
+  ast::flat::Factory factory(tree, ids_);
+  return parseWith(tokens, factory);
 }
 
-Expr
-Parser::factor()
+template <class Tokens, class Factory>
+typename Factory::Expr
+Parser::parseWith(Tokens &tokens, Factory &factory)
 {
-  const auto mappingFunc = [](Token::Type lexerToken) {
-    switch (lexerToken) {
-      case Token::Type::SLASH: return BinOp::Op::Div;
-      case Token::Type::STAR: return BinOp::Op::Mult;
-      DEFAULT_SWITCH_CASE
+  // Every tree gets its own ids, starting from 0.
+  ids_ = Counter();
+
+  // Exceptions flow out of here if parsing fails. Once we add statements, there will be
+  // some kind of error recovery & error accumulation here, like in the lexer.
+  try {
+    auto expr = expression(tokens, factory);
+
+    // Expect that the next token is eof, and that it is the last one.
+    const auto isParsingSuccessful = peek(tokens, Token::Type::EOFF) && tokens.nextIsLast();
+    if (!isParsingSuccessful) {
+      throw CompileError(
+        errorOffset(tokens),
+        ERROR_TAG,
+        "Expected end of program but there were more tokens remaining.",
+        std::string(tokens.hasCurrent() ? tokens.currentContents() : "")
+      );
     }
-  };
 
-  return createBinOp(mappingFunc, [this] { return unary(); }, Token::Type::SLASH, Token::Type::STAR);
+    return expr;
+  } catch (const CompileError &) {
+    // The tokens may have gone wrong because the source did, so its errors come first.
+    tokens.throwPendingErrors();
+    throw;
+  }
 }
 
-Expr
-Parser::unary()
+template <class Tokens, class Factory>
+typename Factory::Expr
+Parser::expression(Tokens &tokens, Factory &factory, uint8_t minBindingPower)
 {
-  if (auto op = match(Token::Type::BANG, Token::Type::MINUS)) {
-    auto child = unary();
+  // Precedence climbing: operands are unary expressions, and each operator's rhs
+  // only takes operators that bind more tightly than it does. So `a - b - c` is
+  // `(a - b) - c`, and `a + b * c` is `a + (b * c)`.
+  auto lhs = unary(tokens, factory);
+  while (tokens.hasNext()) {
+    const auto &op = binaryOperator(tokens.nextType());
+    // Tokens that aren't binary operators have a binding power of 0, so they end the loop.
+    if (op.bindingPower < minBindingPower) {
+      break;
+    }
+    tokens.advance();
+    auto rhs = expression(tokens, factory, op.bindingPower + 1);
+    // The op is only known at runtime, so this uses the factory that takes it as an
+    // argument rather than the factory functions for each op.
+    auto operation = op.operation;
+    lhs = factory.binOp(std::move(lhs), std::move(operation), std::move(rhs));
+  }
+  return lhs;
+}
+
+template <class Tokens, class Factory>
+typename Factory::Expr
+Parser::unary(Tokens &tokens, Factory &factory)
+{
+  if (match(tokens, Token::Type::BANG, Token::Type::MINUS)) {
+    // Only the current token is kept around, so take what we need from it
+    // before parsing any further.
+    const auto opType = tokens.currentType();
+    auto child = unary(tokens, factory);
 
     UnaryOp::Op op2;
-    switch (op->get().getType()) {
+    switch (opType) {
       case Token::Type::BANG: op2 = UnaryOp::Op::Nott; break;
       case Token::Type::MINUS: op2 = UnaryOp::Op::Negate; break;
       DEFAULT_SWITCH_CASE
     }
 
-    return std::make_unique<
-      UnaryOp,
-      UnaryOp::Op,
-      Expr,
-      size_t
-    >(
-      std::move(op2),
-      std::move(child),
-      Counter::next()
-    );
+    return factory.unaryOp(std::move(op2), std::move(child));
   } else {
-    return primary();
+    return primary(tokens, factory);
   }
 }
 
-Expr
-Parser::primary()
+template <class Tokens, class Factory>
+typename Factory::Expr
+Parser::primary(Tokens &tokens, Factory &factory)
 {
-  if (auto op = match(Token::Type::NUM)) {
-    auto numText = op->get().getContents();
-    auto numDouble = textToDouble(numText);
-    return ast::num(std::move(numDouble));
-  } else if (auto op = match(Token::Type::STR)) {
-    // Unfortunately we need to copy this string because Tokens are immutable so we can't move
-    // from them. It's kind of silly because we won't need the tokens after parsing is done
-    // (in fact they are copied when we enter the parser, and it's expected that users will
-    // move their vector of tokens in). We could have something more similar to value semantics
-    // by popping tokens off of the token list when they are being consumed. Then we would
-    // have ownership of them and could genuinely move from them (e.g. could have an overload
-    // on getContents for rvalues that moves its string out by value, avoiding the copy).
-    // However it's nice that progressing the tokens is just done with an index because it's so
-    // easy to refer to the current token, because it's alive in the list. I wonder if that is
-    // even needed though -- is it sufficient just to return the string?
-    // Another point is that progressing with an index lets us easily rewind during "panic mode".
-    auto string = op->get().getContents();
-    return ast::string(std::move(string));
-  } else if (auto op = match(Token::Type::TRUE)) {
-    return ast::truee();
-  } else if (auto op = match(Token::Type::FALSE)) {
-    return ast::falsee();
-  } else if (auto op = match(Token::Type::NIL)) {
-    return ast::nil();
-  } else if (auto op = match(Token::Type::LPEREN)) {
-    auto child = expression();
-    expect(Token::Type::RPEREN);
-    return ast::grouping(std::move(child));
+  if (match(tokens, Token::Type::NUM)) {
+    // The lexer converts numbers as it goes, but tokens made some other way might
+    // only have the text.
+    const auto number = tokens.currentNumber();
+    auto numDouble = number ? *number : textToDouble(tokens.currentContents(), tokens.currentOffset());
+    return factory.num(std::move(numDouble));
+  } else if (match(tokens, Token::Type::STR)) {
+    // Tokens are only views onto the source buffer, and the AST outlives the source, so
+    // the string needs to be interned (unless the lexer already did it).
+    const auto symbol = tokens.currentSymbol();
+    auto value = symbol.isValid() ? symbol : strings_->intern(tokens.currentContents());
+    return factory.string(std::move(value));
+  } else if (match(tokens, Token::Type::TRUE)) {
+    return factory.truee();
+  } else if (match(tokens, Token::Type::FALSE)) {
+    return factory.falsee();
+  } else if (match(tokens, Token::Type::NIL)) {
+    return factory.nil();
+  } else if (match(tokens, Token::Type::LPEREN)) {
+    auto child = expression(tokens, factory);
+    expect(tokens, Token::Type::RPEREN);
+    return factory.grouping(std::move(child));
   } else {
     // Since none of the above cases matched, this should fail with a nice
     // error message.
     expect(
+      tokens,
       Token::Type::NUM, Token::Type::STR, Token::Type::TRUE, Token::Type::FALSE, Token::Type::NIL, Token::Type::LPEREN
     );
     // Just to make it compile -- the call above should throw anyway.
@@ -199,117 +355,84 @@ Parser::primary()
   }
 }
 
-const lexer::Token &
-Parser::current() const
+size_t
+Parser::nodeCount() const
 {
-  return tokens_.at(current_);
+  return ids_.count();
 }
 
-const lexer::Token &
-Parser::advance()
+template <class Tokens>
+uint32_t
+Parser::errorOffset(const Tokens &tokens)
 {
-  ++current_;
-  return current();
+  if (tokens.hasCurrent()) {
+    return tokens.currentOffset();
+  }
+  // Without even an EOF token to go by, there's nowhere better than the start.
+  return tokens.hasNext() ? tokens.nextOffset() : 0;
 }
 
-template <class... T>
+template <class Tokens, class... T>
 bool
-Parser::peek(T &&... tokenTypes)
+Parser::peek(const Tokens &tokens, T &&... tokenTypes)
 {
-  if (current_ + 1 >= tokens_.size()) {
+  if (!tokens.hasNext()) {
     return false;
   }
 
-  const auto &nextToken = tokens_[current_ + 1];
   // True if the next token matches any of the parameters.
-  return ((nextToken.getType() == std::forward<T>(tokenTypes)) || ...);
+  const auto nextType = tokens.nextType();
+  return ((nextType == std::forward<T>(tokenTypes)) || ...);
 }
 
-template <class... T>
-std::optional<std::reference_wrapper<const Token>>
-Parser::match(T &&... tokenTypes)
+template <class Tokens, class... T>
+bool
+Parser::match(Tokens &tokens, T &&... tokenTypes)
 {
-  if (peek(std::forward<T>(tokenTypes)...)) {
-    return advance();
+  if (peek(tokens, std::forward<T>(tokenTypes)...)) {
+    tokens.advance();
+    return true;
   } else {
-    return std::nullopt;
+    return false;
   }
 }
 
-template <class... T>
-const lexer::Token &
-Parser::expect(T &&... tokenTypes)
+template <class Tokens, class... T>
+void
+Parser::expect(Tokens &tokens, T &&... tokenTypes)
 {
-  if (current_ + 1 >= tokens_.size() || peek(Token::Type::EOFF)) {
+  if (!tokens.hasNext() || peek(tokens, Token::Type::EOFF)) {
     std::stringstream message;
     message << "Unexpected end of file during parsing. Expected one of: ";
     ((message << std::forward<T>(tokenTypes) << ", "), ...);
-    throw CompileError(current().getLineNumber(), ERROR_TAG, message.str(), "");
+    throw CompileError(errorOffset(tokens), ERROR_TAG, message.str(), "");
   }
 
-  const auto &nextToken = tokens_[current_ + 1];
   // True if the next token matches any of the parameters.
-  if (((nextToken.getType() == tokenTypes) || ...)) {
-    advance();
-    return nextToken;
+  if (peek(tokens, tokenTypes...)) {
+    tokens.advance();
+    return;
   }
 
   std::stringstream message;
   message << "Unexpected token ";
-  message << nextToken;
+  message << tokens.nextToken();
   message << ". Expected one of: ";
   // I think this leaves a trailing comma on the end.
   // Not ideal but I'm not sure how else to do it.
   ((message << std::forward<T>(tokenTypes) << ", "), ...);
-  throw CompileError(nextToken.getLineNumber(), ERROR_TAG, message.str(), "");
-}
-
-template <class BinOpMapFunc, class SubExprFunc, class... Ts>
-Expr
-Parser::createBinOp(const BinOpMapFunc &map, const SubExprFunc &subExpr, Ts &&... tokenTypes)
-{
-  Expr lhs = subExpr();
-  while (auto op = match(std::forward<Ts>(tokenTypes)...)) {
-    Expr rhs = subExpr();
-    ast::BinOp::Op op2 = map(op->get().getType());
-    // Unfortunately we can't use the factory functions easily here because a different
-    // function needs to be called depending on the op of the lexer token, which we must
-    // map to a BinOp op.
-    // This could have been avoided by also adding factory functions that taken in the
-    // BinOp::Op argument to decide which type of BinOp to make (then the existing factory
-    // functions could call those).
-    lhs = std::make_unique<
-      ast::BinOp,
-      Expr,
-      ast::BinOp::Op,
-      Expr,
-      size_t
-    >(
-      std::move(lhs),
-      std::move(op2),
-      std::move(rhs),
-      Counter::next()
-    );
-  }
-  return lhs;
+  throw CompileError(tokens.nextOffset(), ERROR_TAG, message.str(), "");
 }
 
 double
-Parser::textToDouble(const std::string &text)
+Parser::textToDouble(std::string_view text, uint32_t offset)
 {
-  try {
-    return std::stod(text);
-  } catch (const std::invalid_argument &e) {
-    const auto &currentToken = current();
-    std::stringstream stream;
-    stream << "Unable to parse number into double-precision floating point. ";
-    stream << "Internal error: " << e.what();
-    throw CompileError(currentToken.getLineNumber(), ERROR_TAG, stream.str(), text);
-  } catch (const std::out_of_range &e) {
-    const auto &currentToken = current();
-    constexpr auto message = "Number is out of range of double-precision floating point, so cannot be represented.";
-    throw CompileError(currentToken.getLineNumber(), ERROR_TAG, message, text);
+  std::errc error;
+  const auto number = parseNumber(text, error);
+  if (!number) {
+    throw CompileError(offset, ERROR_TAG, describeNumberError(error), std::string(text));
   }
+  return *number;
 }
 
 }
@@ -0,0 +1,105 @@
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+#include "utils/AllocationCounter.hpp"
+
+// Replaces the global allocation functions for the whole binary it's linked into.
+
+namespace {
+
+std::atomic<size_t> allocations { 0 };
+// Bytes the allocator actually handed out, i.e. including any rounding up.
+std::atomic<size_t> liveBytes { 0 };
+std::atomic<size_t> peakBytes { 0 };
+
+void *
+recordAllocation(void *memory)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  const auto size = malloc_usable_size(memory);
+  const auto live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  auto peak = peakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) { }
+  return memory;
+}
+
+void
+freeAllocation(void *memory)
+{
+  if (memory) {
+    liveBytes.fetch_sub(malloc_usable_size(memory), std::memory_order_relaxed);
+  }
+  std::free(memory);
+}
+
+}
+
+size_t
+utils::allocationCount()
+{
+  return allocations.load(std::memory_order_relaxed);
+}
+
+size_t
+utils::resetPeakHeap()
+{
+  const auto live = liveBytes.load(std::memory_order_relaxed);
+  peakBytes.store(live, std::memory_order_relaxed);
+  return live;
+}
+
+size_t
+utils::peakHeap()
+{
+  return peakBytes.load(std::memory_order_relaxed);
+}
+
+void *
+operator new(size_t size)
+{
+  if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+    return recordAllocation(memory);
+  }
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void *memory) noexcept
+{
+  freeAllocation(memory);
+}
+
+void
+operator delete(void *memory, size_t) noexcept
+{
+  freeAllocation(memory);
+}
+
+// Over-aligned allocations (e.g. from memory resources) come through here instead.
+void *
+operator new(size_t size, std::align_val_t alignment)
+{
+  const auto align = static_cast<size_t>(alignment);
+  // `aligned_alloc` needs the size to be a multiple of the alignment.
+  const auto roundedSize = (std::max<size_t>(size, 1) + align - 1) / align * align;
+  if (void *memory = std::aligned_alloc(align, roundedSize)) {
+    return recordAllocation(memory);
+  }
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void *memory, std::align_val_t) noexcept
+{
+  freeAllocation(memory);
+}
+
+void
+operator delete(void *memory, size_t, std::align_val_t) noexcept
+{
+  freeAllocation(memory);
+}
@@ -0,0 +1,138 @@
+#include "visit/Evaluator.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "utils/Assert.hpp"
+
+namespace {
+
+void
+checkNumbers(visit::Value lhs, visit::Value rhs, const char *message = "Operands must be numbers.")
+{
+  if (!lhs.isNumber() || !rhs.isNumber()) {
+    throw std::runtime_error(message);
+  }
+}
+
+}
+
+namespace visit {
+
+Evaluator::Evaluator(utils::StringInterner &strings)
+  : strings_(strings)
+  { }
+
+Value
+Evaluator::evaluate(const ast::Expr &expr)
+{
+  values_.clear();
+  traverse(expr);
+  ASSERT(values_.size() == 1);
+  return values_.back();
+}
+
+void
+Evaluator::leaveBinOp(const ast::BinOp &binOp)
+{
+  const auto rhs = values_.back();
+  values_.pop_back();
+  auto &lhs = values_.back();
+
+  using Op = ast::BinOp::Op;
+  switch (binOp.operation()) {
+    case Op::Add:
+      if (lhs.isString() && rhs.isString()) {
+        std::string joined(lhs.asString().str());
+        joined.append(rhs.asString().str());
+        lhs = Value::string(strings_.intern(joined));
+        return;
+      }
+      checkNumbers(lhs, rhs, "Operands must be two numbers or two strings.");
+      lhs = Value::number(lhs.asNumber() + rhs.asNumber());
+      return;
+    case Op::Sub:
+      checkNumbers(lhs, rhs);
+      lhs = Value::number(lhs.asNumber() - rhs.asNumber());
+      return;
+    case Op::Mult:
+      checkNumbers(lhs, rhs);
+      lhs = Value::number(lhs.asNumber() * rhs.asNumber());
+      return;
+    case Op::Div:
+      checkNumbers(lhs, rhs);
+      lhs = Value::number(lhs.asNumber() / rhs.asNumber());
+      return;
+    case Op::Gt:
+      checkNumbers(lhs, rhs);
+      lhs = Value::boolean(lhs.asNumber() > rhs.asNumber());
+      return;
+    case Op::GtEq:
+      checkNumbers(lhs, rhs);
+      lhs = Value::boolean(lhs.asNumber() >= rhs.asNumber());
+      return;
+    case Op::Lt:
+      checkNumbers(lhs, rhs);
+      lhs = Value::boolean(lhs.asNumber() < rhs.asNumber());
+      return;
+    case Op::LtEq:
+      checkNumbers(lhs, rhs);
+      lhs = Value::boolean(lhs.asNumber() <= rhs.asNumber());
+      return;
+    case Op::Eq:
+      lhs = Value::boolean(lhs == rhs);
+      return;
+    case Op::Neq:
+      lhs = Value::boolean(lhs != rhs);
+      return;
+  }
+}
+
+void
+Evaluator::leaveUnaryOp(const ast::UnaryOp &unaryOp)
+{
+  auto &operand = values_.back();
+  switch (unaryOp.operation()) {
+    case ast::UnaryOp::Op::Negate:
+      if (!operand.isNumber()) {
+        throw std::runtime_error("Operand must be a number.");
+      }
+      operand = Value::number(-operand.asNumber());
+      return;
+    case ast::UnaryOp::Op::Nott:
+      operand = Value::boolean(!operand.isTruthy());
+      return;
+  }
+}
+
+void
+Evaluator::visitString(const ast::String &string)
+{
+  values_.push_back(Value::string(string.value()));
+}
+
+void
+Evaluator::visitNum(const ast::Num &num)
+{
+  values_.push_back(Value::number(num.value()));
+}
+
+void
+Evaluator::visitTruee(const ast::Truee &)
+{
+  values_.push_back(Value::boolean(true));
+}
+
+void
+Evaluator::visitFalsee(const ast::Falsee &)
+{
+  values_.push_back(Value::boolean(false));
+}
+
+void
+Evaluator::visitNil(const ast::Nil &)
+{
+  values_.push_back(Value::nil());
+}
+
+}
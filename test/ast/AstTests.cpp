@@ -4,8 +4,11 @@
 #include <cstddef>
 #include <memory>
 #include <exception>
+#include <limits>
 
+#include "ast/ArenaExpr.hpp"
 #include "ast/Expr.hpp"
+#include "ast/FlatExpr.hpp"
 #include "visit/SmallVisitors.hpp"
 
 class Evaluator final : ast::Visitor<int> {
@@ -137,3 +140,151 @@ TEST(AstTests, TestUniqueIds) {
 
   ASSERT_TRUE(checker.hasUniqueIds(expr));
 }
+
+TEST(AstTests, TestArenaTree) {
+  // Only the operations are needed here, so the rest of the visits can be simple.
+  class OpCounter final : public ast::arena::ConstVisitor<int> {
+  public:
+    int visitBinOp(const ast::arena::BinOp &binOp) override { return 1 + visit(binOp.lhs()) + visit(binOp.rhs()); }
+    int visitUnaryOp(const ast::arena::UnaryOp &unaryOp) override { return 1 + visit(unaryOp.child()); }
+    int visitString(const ast::arena::String &) override { return 0; }
+    int visitNum(const ast::arena::Num &) override { return 0; }
+    int visitGrouping(const ast::arena::Grouping &grouping) override { return visit(grouping.child()); }
+    int visitTruee(const ast::arena::Truee &) override { return 0; }
+    int visitFalsee(const ast::arena::Falsee &) override { return 0; }
+    int visitNil(const ast::arena::Nil &) override { return 0; }
+  };
+
+  Arena arena;
+  using namespace ast::arena;
+  const Expr expr = add(arena, num(arena, 4), negate(arena, grouping(arena, mult(arena, num(arena, 3), nil(arena)))));
+
+  EXPECT_EQ(7, arena.objectCount());
+  EXPECT_EQ(3, OpCounter().visit(expr));
+  const auto binOp = std::get<BinOpPtr>(expr);
+  EXPECT_EQ(BinOp::Op::Add, binOp->operation());
+  EXPECT_EQ(4, std::get<NumPtr>(binOp->lhs())->value());
+}
+
+TEST(AstTests, TestDestroyDeepTree) {
+  // Deep enough that destroying the tree recursively would overflow the stack.
+  using namespace ast;
+  Expr expr = num(0);
+  for (int i = 0; i < 1000000; ++i) {
+    switch (i % 3) {
+      case 0: expr = add(std::move(expr), num(i)); break;
+      case 1: expr = grouping(std::move(expr)); break;
+      case 2: expr = negate(std::move(expr)); break;
+    }
+  }
+
+  expr = nil();
+  EXPECT_TRUE(std::holds_alternative<NilPtr>(expr));
+}
+
+TEST(AstTests, TestDestroyTreeWithMovedOutChild) {
+  using namespace ast;
+  auto binOp = sub(grouping(num(1)), negate(grouping(num(2))));
+  Expr rhs = std::move(binOp->rhs());
+
+  binOp.reset();
+  EXPECT_TRUE(std::holds_alternative<UnaryOpPtr>(rhs));
+}
+
+TEST(AstTests, TestStructuralEquality) {
+  using namespace ast;
+  const Expr expr = mult(add(num(1), string(utils::Symbol())), grouping(negate(truee())));
+  const Expr same = mult(add(num(1), string(utils::Symbol())), grouping(negate(truee())));
+
+  // Made separately, so only the structure is the same.
+  EXPECT_NE(visit::id(expr), visit::id(same));
+  EXPECT_TRUE(structurallyEqual(expr, same));
+  EXPECT_EQ(structuralHash(expr), structuralHash(same));
+
+  EXPECT_FALSE(structurallyEqual(expr, mult(add(num(2), string(utils::Symbol())), grouping(negate(truee())))));
+  EXPECT_FALSE(structurallyEqual(expr, mult(add(num(1), string(utils::Symbol())), grouping(nott(truee())))));
+  EXPECT_FALSE(structurallyEqual(expr, mult(add(num(1), string(utils::Symbol())), grouping(negate(falsee())))));
+  EXPECT_FALSE(structurallyEqual(expr, div(add(num(1), string(utils::Symbol())), grouping(negate(truee())))));
+  EXPECT_NE(structuralHash(truee()), structuralHash(falsee()));
+}
+
+TEST(AstTests, TestFlatStructuralEquality) {
+  using namespace ast::flat;
+  Tree tree;
+  const auto lhs = sub(tree, num(tree, 1), grouping(tree, nil(tree)));
+  Tree otherTree;
+  otherTree.add<Nil>(0u); // so the indices are different
+  const auto rhs = sub(otherTree, num(otherTree, 1), grouping(otherTree, nil(otherTree)));
+
+  EXPECT_TRUE(structurallyEqual(tree, lhs, otherTree, rhs));
+  EXPECT_EQ(structuralHash(tree, lhs), structuralHash(otherTree, rhs));
+  EXPECT_FALSE(structurallyEqual(tree, lhs, otherTree, Expr{ 0 }));
+}
+
+TEST(AstTests, TestStructuralEqualityOfDeepTrees) {
+  // Deep enough that hashing or comparing the trees recursively would overflow the stack.
+  using namespace ast;
+  Expr expr = num(0);
+  Expr same = num(0);
+  for (int i = 0; i < 1000000; ++i) {
+    expr = add(std::move(expr), num(i));
+    same = add(std::move(same), num(i));
+  }
+
+  EXPECT_TRUE(structurallyEqual(expr, same));
+  EXPECT_EQ(structuralHash(expr), structuralHash(same));
+  std::get<NumPtr>(std::get<BinOpPtr>(same)->rhs())->value() = -1;
+  EXPECT_FALSE(structurallyEqual(expr, same));
+}
+
+TEST(AstTests, TestStructuralEqualityOfNumbers) {
+  // Numbers are the same if they have the same bits, not if they compare equal.
+  using namespace ast;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  EXPECT_TRUE(structurallyEqual(num(double(nan)), num(double(nan))));
+  EXPECT_EQ(structuralHash(num(double(nan))), structuralHash(num(double(nan))));
+  EXPECT_FALSE(structurallyEqual(num(0.0), num(-0.0)));
+
+  flat::Tree tree;
+  Counter ids;
+  flat::SharingFactory factory(tree, ids);
+  const auto nanRoot = factory.num(double(nan));
+  EXPECT_EQ(nanRoot, factory.num(double(nan)));
+  const auto zero = factory.num(0.0);
+  const auto negativeZero = factory.num(-0.0);
+  EXPECT_NE(zero, negativeZero);
+  EXPECT_EQ(3, tree.size());
+  EXPECT_FALSE(flat::structurallyEqual(tree, zero, tree, negativeZero));
+}
+
+namespace {
+
+// Writes down each callback, to check the order they come in.
+class TraversalRecorder final : public ast::ConstTraversal<TraversalRecorder> {
+public:
+  std::string events;
+
+  void enterBinOp(const ast::BinOp &) { events += "enter+ "; }
+  void betweenBinOp(const ast::BinOp &) { events += "between+ "; }
+  void leaveBinOp(const ast::BinOp &) { events += "leave+ "; }
+  void enterGrouping(const ast::Grouping &) { events += "enter() "; }
+  void leaveGrouping(const ast::Grouping &) { events += "leave() "; }
+  void visitNum(const ast::Num &num) { events += std::to_string(static_cast<int>(num.value())) + " "; }
+  // Unary operators are left to the defaults, which do nothing.
+};
+
+}
+
+TEST(AstTests, TestTraversalOrder) {
+  using namespace ast;
+  const Expr expr = add(grouping(num(1)), negate(add(num(2), num(3))));
+
+  TraversalRecorder recorder;
+  recorder.traverse(expr);
+  EXPECT_EQ("enter+ enter() 1 leave() between+ enter+ 2 between+ 3 leave+ leave+ ", recorder.events);
+
+  // The stack is empty again afterwards, so the recorder can be reused.
+  recorder.events.clear();
+  recorder.traverse(num(4));
+  EXPECT_EQ("4 ", recorder.events);
+}
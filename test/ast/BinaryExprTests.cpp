@@ -0,0 +1,163 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "ast/BinaryExpr.hpp"
+#include "lexer/Lexer.h"
+#include "lexer/SourceBuffer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+#include "visit/PrettyPrinter.hpp"
+#include "visit/SmallVisitors.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string SOURCE = "\"a\" + 1 == -(\"a\" + 2.5) != (true == nil)";
+
+ast::flat::Expr
+parseFlat(utils::StringInterner &interner, ast::flat::Tree &tree)
+{
+  lexer::Lexer lexer(interner);
+  const auto stream = lexer.lexToStream(SOURCE);
+  parser::Parser parser(interner);
+  return parser.parse(stream, tree);
+}
+
+// Swaps the header for one with a fresh checksum, so the bytes get past it to be checked further.
+void
+updateChecksum(std::string &bytes)
+{
+  ast::binary::Header header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  header.checksum = hashBytes(bytes.data() + sizeof(header), bytes.size() - sizeof(header));
+  std::memcpy(bytes.data(), &header, sizeof(header));
+}
+
+}
+
+TEST(BinaryExprTests, TestSaveAndLoad) {
+  utils::StringInterner interner;
+  ast::flat::Tree tree;
+  const auto root = parseFlat(interner, tree);
+
+  const auto bytes = ast::binary::save(tree);
+  // "a" is only saved once.
+  EXPECT_EQ(sizeof(ast::binary::Header) + tree.size() * sizeof(ast::binary::Record) + 1, bytes.size());
+  // Nothing is left over from whatever the memory held before.
+  EXPECT_EQ(bytes, ast::binary::save(tree));
+
+  const auto image = ast::binary::Image::open(bytes);
+  EXPECT_EQ(tree.size(), image.size());
+
+  ast::flat::Tree loaded;
+  const auto loadedRoot = ast::binary::load(image, interner, loaded);
+  EXPECT_TRUE(ast::flat::structurallyEqual(tree, root, loaded, loadedRoot));
+  for (uint32_t index = 0; index < tree.size(); ++index) {
+    EXPECT_EQ(visit::id(tree, { index }), visit::id(loaded, { index }));
+  }
+
+  // Into a different interner, as if in another process. The symbols are different, but
+  // they're for the same strings.
+  utils::StringInterner otherInterner;
+  ast::flat::Tree reloaded;
+  const auto reloadedRoot = ast::binary::load(image, otherInterner, reloaded);
+  EXPECT_EQ(1, otherInterner.size());
+  visit::PrettyPrinter printer;
+  EXPECT_EQ(printer.print(tree, root), printer.print(reloaded, reloadedRoot));
+}
+
+TEST(BinaryExprTests, TestReadInPlace) {
+  utils::StringInterner interner;
+  ast::flat::Tree tree;
+  parseFlat(interner, tree);
+  const auto bytes = ast::binary::save(tree);
+  const auto image = ast::binary::Image::open(bytes);
+
+  using namespace ast::binary;
+  const auto &root = image[image.root()].get<BinOp>();
+  EXPECT_EQ(BinOp::Op::Neq, root.operation());
+  const auto &lhs = image[root.lhs()].get<BinOp>();
+  EXPECT_EQ(BinOp::Op::Eq, lhs.operation());
+
+  // "a" + 1
+  const auto &add = image[lhs.lhs()].get<BinOp>();
+  EXPECT_EQ(BinOp::Op::Add, add.operation());
+  const auto string = image.string(image[add.lhs()].get<String>().value());
+  EXPECT_EQ("a", string);
+  EXPECT_TRUE(string.data() > bytes.data() && string.data() < bytes.data() + bytes.size());
+  EXPECT_EQ(1, image[add.rhs()].get<Num>().value());
+
+  // (true == nil)
+  const auto &grouping = image[root.rhs()].get<Grouping>();
+  const auto &eq = image[grouping.child()].get<BinOp>();
+  EXPECT_EQ(Kind::Truee, image[eq.lhs()].kind());
+  EXPECT_EQ(Kind::Nil, image[eq.rhs()].kind());
+}
+
+TEST(BinaryExprTests, TestOpenMappedFile) {
+  utils::StringInterner interner;
+  ast::flat::Tree tree;
+  const auto root = parseFlat(interner, tree);
+
+  const auto path = fs::temp_directory_path() / ("lox1-binary-expr." + std::to_string(::getpid()));
+  std::ofstream(path, std::ios::binary) << ast::binary::save(tree);
+  {
+    const auto file = lexer::SourceBuffer::fromFile(path.string());
+    EXPECT_TRUE(file.isMapped());
+    const auto image = ast::binary::Image::open(file.view());
+    ast::flat::Tree loaded;
+    const auto loadedRoot = ast::binary::load(image, interner, loaded);
+    EXPECT_TRUE(ast::flat::structurallyEqual(tree, root, loaded, loadedRoot));
+  }
+  fs::remove(path);
+}
+
+TEST(BinaryExprTests, TestRejectsBadBytes) {
+  using ast::binary::Image;
+  utils::StringInterner interner;
+  ast::flat::Tree tree;
+  parseFlat(interner, tree);
+  const auto bytes = ast::binary::save(tree);
+  const auto headerSize = sizeof(ast::binary::Header);
+
+  EXPECT_THROW(Image::open(std::string_view(bytes).substr(0, headerSize - 1)), std::runtime_error);
+  EXPECT_THROW(Image::open(std::string_view(bytes).substr(0, bytes.size() - 1)), std::runtime_error);
+  EXPECT_THROW(Image::open(bytes + "x"), std::runtime_error);
+
+  auto notSaved = bytes;
+  notSaved[0] = 'X';
+  EXPECT_THROW(Image::open(notSaved), std::runtime_error);
+
+  auto otherVersion = bytes;
+  ++otherVersion[offsetof(ast::binary::Header, version)];
+  EXPECT_THROW(Image::open(otherVersion), std::runtime_error);
+
+  auto corrupted = bytes;
+  ++corrupted[headerSize + 3];
+  EXPECT_THROW(Image::open(corrupted), std::runtime_error);
+
+  // One byte in, so the records can't be read where they are.
+  const auto misaligned = "x" + bytes;
+  EXPECT_THROW(Image::open(std::string_view(misaligned).substr(1)), std::runtime_error);
+
+  // The first node is a leaf (the string), so give it a kind that has a child, which
+  // would have to come after it.
+  auto malformed = bytes;
+  const ast::binary::Record grouping(std::in_place_type<ast::binary::Grouping>, ast::binary::Expr{ 5 }, 0u);
+  std::memcpy(malformed.data() + headerSize, &grouping, sizeof(grouping));
+  updateChecksum(malformed);
+  EXPECT_THROW(Image::open(malformed), std::runtime_error);
+  // A correct checksum on its own isn't the problem.
+  auto rechecked = bytes;
+  updateChecksum(rechecked);
+  EXPECT_NO_THROW(Image::open(rechecked));
+}
@@ -2,8 +2,10 @@
 
 #include <vector>
 #include <optional>
+#include <string_view>
 
 #include "lexer/Lexer.h"
+#include "lexer/LineIndex.h"
 #include "utils/Logging.hpp"
 
 using namespace lexer;
@@ -28,27 +30,59 @@ expectSingleStringLex(const std::string &string)
 }
 
 void
-expectSingleNumberLex(const std::string &number)
+expectSingleNumberLex(const std::string &number, double value)
 {
   Lexer lexer;
   const auto tokens = lexer.lex(number);
   ASSERT_EQ(2, tokens.size());
   EXPECT_TOKEN_TYPE(Token::Type::NUM, tokens[0]);
   EXPECT_EQ(number, tokens[0].getContents());
+  ASSERT_TRUE(tokens[0].getNumber());
+  EXPECT_EQ(value, *tokens[0].getNumber());
   EXPECT_EOF(tokens);
 }
 
 template <class T> // totally unnecessary :)
 void
-expectIdentifierToken(const Token &token, T &&contents, std::optional<unsigned> lineNumber = std::nullopt)
+expectIdentifierToken(const Token &token, T &&contents)
 {
   EXPECT_EQ(Token::Type::ID, token.getType());
   EXPECT_EQ(std::forward<T>(contents), token.getContents());
-  if (lineNumber) {
-    EXPECT_EQ(*lineNumber, token.getLineNumber());
+}
+
+unsigned
+lineOf(std::string_view source, const Token &token)
+{
+  return LineIndex(source).position(token.getSpan().offset).line;
+}
+
+void
+expectSameTokens(const std::vector<Token> &expected, const std::vector<Token> &actual)
+{
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].getType(), actual[i].getType()) << "Token " << i;
+    EXPECT_EQ(expected[i].getContents(), actual[i].getContents()) << "Token " << i;
+    EXPECT_EQ(expected[i].getSpan().offset, actual[i].getSpan().offset) << "Token " << i;
+    EXPECT_EQ(expected[i].getSpan().length, actual[i].getSpan().length) << "Token " << i;
   }
 }
 
+// Applies the edit to the source, then checks that re-lexing around it gives
+// the same tokens as lexing the edited source from scratch.
+void
+expectRelexMatchesLex(std::string source, uint32_t offset, uint32_t removedLength, const std::string &insertedText)
+{
+  Lexer lexer;
+  const auto previousTokens = lexer.lex(source);
+
+  source.replace(offset, removedLength, insertedText);
+  const auto relexedTokens = lexer.relex(previousTokens, source, TextEdit{ offset, removedLength, insertedText });
+
+  Lexer freshLexer;
+  expectSameTokens(freshLexer.lex(source), relexedTokens);
+}
+
 }
 
 TEST(LexerTests, TestEmptyInput) {
@@ -188,11 +222,23 @@ TEST(LexerTests, TestAdjacentStrings) {
 }
 
 TEST(LexerTests, TestLexWholeNumber) {
-  expectSingleNumberLex("11");
+  expectSingleNumberLex("11", 11);
 }
 
 TEST(LexerTests, TestLexDecimalNumber) {
-  expectSingleNumberLex("2.25");
+  expectSingleNumberLex("2.25", 2.25);
+}
+
+TEST(LexerTests, TestNumberOutOfRange) {
+  Lexer lexer;
+  const auto input = "1 + 1" + std::string(400, '0') + " + 2";
+  try {
+    lexer.lex(input);
+    FAIL() << "Expected the number to be out of range";
+  } catch (const ErrorCollection &e) {
+    ASSERT_EQ(1, e.errors().size());
+    EXPECT_NE(std::string::npos, e.what().find("out of range"));
+  }
 }
 
 TEST(LexerTests, TestLexComment) {
@@ -201,7 +247,7 @@ TEST(LexerTests, TestLexComment) {
   const auto tokens = lexer.lex(input);
   ASSERT_EQ(1, tokens.size());
   EXPECT_EOF(tokens);
-  ASSERT_EQ(1, tokens[0].getLineNumber());
+  ASSERT_EQ(1, lineOf(input, tokens[0]));
 }
 
 TEST(LexerTests, TestLexCommentAndEndOfLine) {
@@ -210,7 +256,7 @@ TEST(LexerTests, TestLexCommentAndEndOfLine) {
   const auto tokens = lexer.lex(input);
   ASSERT_EQ(1, tokens.size());
   EXPECT_EOF(tokens);
-  ASSERT_EQ(2, tokens[0].getLineNumber())
+  ASSERT_EQ(2, lineOf(input, tokens[0]))
     << "Due to newline, EOF should be on second line";
 }
 
@@ -220,7 +266,7 @@ TEST(LexerTests, TestLexCommentWithManySlashes) {
   const auto tokens = lexer.lex(input);
   ASSERT_EQ(1, tokens.size());
   EXPECT_EOF(tokens);
-  ASSERT_EQ(1, tokens[0].getLineNumber());
+  ASSERT_EQ(1, lineOf(input, tokens[0]));
 }
 
 TEST(LexerTests, TextSingleAndMultiCharTokens) {
@@ -277,9 +323,230 @@ TEST(LexerTests, TestLineNumbers) {
   const auto input = "abc\ndef ghi\n\njkl";
   const auto tokens = lexer.lex(input);
 
-  expectIdentifierToken(tokens[0], "abc", 1);
-  expectIdentifierToken(tokens[1], "def", 2);
-  expectIdentifierToken(tokens[3], "jkl", 4);
+  expectIdentifierToken(tokens[0], "abc");
+  EXPECT_EQ(1, lineOf(input, tokens[0]));
+  expectIdentifierToken(tokens[1], "def");
+  EXPECT_EQ(2, lineOf(input, tokens[1]));
+  expectIdentifierToken(tokens[3], "jkl");
+  EXPECT_EQ(4, lineOf(input, tokens[3]));
 
   EXPECT_EOF(tokens);
 }
+
+TEST(LexerTests, TestTokensReferToSource) {
+  Lexer lexer;
+  const std::string input = "abc \"de f\"\n12.5";
+  const auto tokens = lexer.lex(input);
+  ASSERT_EQ(4, tokens.size());
+
+  // Contents are views onto the input, not copies of it.
+  EXPECT_EQ(input.data(), tokens[0].getContents().data());
+  EXPECT_EQ(input.data() + 5, tokens[1].getContents().data());
+  EXPECT_EQ("de f", tokens[1].getContents());
+
+  EXPECT_EQ(0, tokens[0].getSpan().offset);
+  EXPECT_EQ(3, tokens[0].getSpan().length);
+  // The span of a string includes its quotes.
+  EXPECT_EQ(4, tokens[1].getSpan().offset);
+  EXPECT_EQ(6, tokens[1].getSpan().length);
+  EXPECT_EQ(11, tokens[2].getSpan().offset);
+  EXPECT_EQ(4, tokens[2].getSpan().length);
+  EXPECT_EQ(input.size(), tokens[3].getSpan().offset);
+  EXPECT_EQ(0, tokens[3].getSpan().length);
+}
+
+TEST(LexerTests, TestLexCharacterRange) {
+  Lexer lexer;
+  const char input[] = "abc def ghi";
+  // Only lex the middle identifier.
+  const auto tokens = lexer.lex(input + 4, input + 7);
+  ASSERT_EQ(2, tokens.size());
+  expectIdentifierToken(tokens[0], "def");
+  EXPECT_EOF(tokens);
+}
+
+TEST(LexerTests, TestLineNumbersAfterMultiLineString) {
+  Lexer lexer;
+  const auto input = "\"a\nb\nc\" abc\n\n  \t \ndef // comment\n" "\"" "unterminated\n";
+
+  try {
+    lexer.lex(input);
+    FAIL() << "Expecting lexing to fail due to unterminated string.";
+  } catch (const ErrorCollection &e) {
+    ASSERT_EQ(1, e.errors().size());
+    // Strings are reported on the line they start on.
+    EXPECT_NE(std::string::npos, describe(e, LineIndex(input)).find("Line 7, column 1"));
+  }
+
+  const std::string input2 = "\"a\nb\nc\" abc\n\n  \t \ndef // comment\n\"x\ny\"";
+  const auto tokens = lexer.lex(input2);
+  ASSERT_EQ(5, tokens.size());
+  EXPECT_EQ(1, lineOf(input2, tokens[0]));
+  expectIdentifierToken(tokens[1], "abc");
+  EXPECT_EQ(3, lineOf(input2, tokens[1]));
+  expectIdentifierToken(tokens[2], "def");
+  EXPECT_EQ(6, lineOf(input2, tokens[2]));
+  EXPECT_EQ(7, lineOf(input2, tokens[3]));
+  EXPECT_EQ(8, lineOf(input2, tokens[4]));
+  EXPECT_EOF(tokens);
+}
+
+TEST(LexerTests, TestNextToken) {
+  Lexer lexer;
+  const std::string input = "a // comment\n  1";
+  lexer.reset(input);
+
+  expectIdentifierToken(lexer.nextToken(), "a");
+  const auto number = lexer.nextToken();
+  EXPECT_TOKEN_TYPE(Token::Type::NUM, number);
+  EXPECT_EQ(2, lineOf(input, number));
+  // Keeps returning EOF once the input runs out.
+  EXPECT_TOKEN_TYPE(Token::Type::EOFF, lexer.nextToken());
+  EXPECT_TOKEN_TYPE(Token::Type::EOFF, lexer.nextToken());
+}
+
+TEST(LexerTests, TestNextTokenReportsErrorsAtEnd) {
+  Lexer lexer;
+  const std::string input = "a @ b #";
+  lexer.reset(input);
+
+  // Errors don't stop the tokens on either side of them being lexed.
+  expectIdentifierToken(lexer.nextToken(), "a");
+  expectIdentifierToken(lexer.nextToken(), "b");
+  try {
+    lexer.nextToken();
+    FAIL() << "Expecting lexing to fail due to unrecognized characters.";
+  } catch (const ErrorCollection &e) {
+    EXPECT_EQ(2, e.errors().size());
+  }
+}
+
+TEST(LexerTests, TestRelexInsideToken) {
+  expectRelexMatchesLex("var abc = 1;\nprint abc;", 6, 0, "xyz");
+  expectRelexMatchesLex("var abc = 1;\nprint abc;", 4, 3, "d");
+  expectRelexMatchesLex("a = b;", 3, 0, "=");
+}
+
+TEST(LexerTests, TestRelexShiftsLines) {
+  expectRelexMatchesLex("a\nb\nc\nd", 1, 0, "\n\n");
+  expectRelexMatchesLex("a\nb\n\n\nc\nd", 3, 3, "");
+  expectRelexMatchesLex("a b\nc d\ne f", 1, 1, "\n");
+}
+
+TEST(LexerTests, TestRelexNeedsLookahead) {
+  // `1.` lexes as a number and a dot, but `1.5` is a single number.
+  expectRelexMatchesLex("x 1. y", 4, 0, "5");
+  expectRelexMatchesLex("x 1.5 y", 4, 1, "");
+}
+
+TEST(LexerTests, TestRelexOpenAndCloseString) {
+  // Moving the opening quote earlier pulls `b` into the string.
+  expectRelexMatchesLex("a b \"c\nd\" e\nf", 2, 3, "\"b ");
+  // Moving the closing quote earlier pushes `d` out of it, onto its own line.
+  expectRelexMatchesLex("a \"b c\nd\" e\nf", 5, 4, "c\" \nd");
+  expectRelexMatchesLex("\"a\nb\" c\nd", 3, 0, "\n\n\n");
+}
+
+TEST(LexerTests, TestRelexOpenAndCloseComment) {
+  expectRelexMatchesLex("a b c\nd e", 2, 0, "//");
+  expectRelexMatchesLex("a //b c\nd e", 2, 2, "");
+  // Removing the newline at the end of a comment comments out the next line too.
+  expectRelexMatchesLex("a //b c\nd e\nf", 7, 1, "");
+}
+
+TEST(LexerTests, TestRelexAtEnds) {
+  expectRelexMatchesLex("a b c", 0, 0, "z ");
+  expectRelexMatchesLex("a b c", 0, 2, "");
+  expectRelexMatchesLex("a b c", 5, 0, " d");
+  expectRelexMatchesLex("a b c", 3, 2, "");
+  expectRelexMatchesLex("", 0, 0, "a b");
+  expectRelexMatchesLex("a b", 0, 3, "");
+}
+
+TEST(LexerTests, TestRelexIntroducesError) {
+  Lexer lexer;
+  std::string source = "a b c";
+  const auto previousTokens = lexer.lex(source);
+
+  source.replace(2, 0, "@");
+  EXPECT_THROW(lexer.relex(previousTokens, source, TextEdit{ 2, 0, "@" }), ErrorCollection);
+
+  source = "a b c";
+  source.replace(2, 0, "\"");
+  EXPECT_THROW(lexer.relex(previousTokens, source, TextEdit{ 2, 0, "\"" }), ErrorCollection);
+}
+
+TEST(LexerTests, TestLexParallel) {
+  // Lots of short lines, with strings and whitespace straddling lines so that some
+  // chunks start in the middle of them.
+  std::string source;
+  for (int i = 0; i < 50; ++i) {
+    source += "var x" + std::to_string(i) + " = 1.5 * (y - 2); // comment \"not a string\n";
+    source += "print \"multi\nline // not a comment\nstring\" != nil;\n";
+    source += "    \n\n   \t";
+  }
+
+  Lexer lexer;
+  const auto expected = lexer.lex(source);
+  for (unsigned threads = 1; threads <= 16; ++threads) {
+    expectSameTokens(expected, lexer.lexParallel(source, threads));
+  }
+}
+
+TEST(LexerTests, TestLexParallelSmallInputs) {
+  Lexer lexer;
+  for (const std::string source : { "", "a", "\n", "a\nb", "\"\n\n\n\"" }) {
+    const auto expected = lexer.lex(source);
+    for (unsigned threads = 1; threads <= 8; ++threads) {
+      expectSameTokens(expected, lexer.lexParallel(source, threads));
+    }
+  }
+}
+
+TEST(LexerTests, TestLexParallelErrors) {
+  std::string source;
+  for (int i = 0; i < 20; ++i) {
+    source += "a @ b\n\"string with @ in it\n\" # c\n";
+  }
+  source += "\"unterminated\n\n";
+
+  Lexer lexer;
+  std::string expected;
+  try {
+    lexer.lex(source);
+    FAIL() << "Expecting lexing to fail.";
+  } catch (const ErrorCollection &e) {
+    expected = e.what();
+  }
+
+  for (unsigned threads = 1; threads <= 16; ++threads) {
+    try {
+      lexer.lexParallel(source, threads);
+      FAIL() << "Expecting lexing to fail with " << threads << " threads.";
+    } catch (const ErrorCollection &e) {
+      EXPECT_EQ(expected, e.what()) << threads << " threads";
+    }
+  }
+}
+
+TEST(LexerTests, TestInternedContents) {
+  utils::StringInterner strings;
+  Lexer lexer(strings);
+  const auto tokens = lexer.lex("abc \"abc\" def abc 1 + print");
+
+  ASSERT_EQ(8, tokens.size());
+  EXPECT_EQ(strings.intern("abc"), tokens[0].getSymbol());
+  EXPECT_EQ(tokens[0].getSymbol(), tokens[1].getSymbol());
+  EXPECT_EQ(tokens[0].getSymbol(), tokens[3].getSymbol());
+  EXPECT_EQ("def", tokens[2].getSymbol().str());
+  // Only identifiers and strings are interned.
+  EXPECT_FALSE(tokens[4].getSymbol().isValid());
+  EXPECT_FALSE(tokens[6].getSymbol().isValid());
+  EXPECT_EQ(2, strings.size());
+
+  // Same from the parallel lexer.
+  const auto parallelTokens = lexer.lexParallel("abc\n\"abc\"\ndef\nabc", 3);
+  EXPECT_EQ(tokens[0].getSymbol(), parallelTokens[0].getSymbol());
+  EXPECT_EQ(tokens[0].getSymbol(), parallelTokens[1].getSymbol());
+  EXPECT_EQ(tokens[2].getSymbol(), parallelTokens[2].getSymbol());
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "lexer/LineIndex.h"
+#include "utils/Error.hpp"
+
+using namespace lexer;
+
+namespace {
+
+void
+expectPosition(const LineIndex &lines, uint32_t offset, unsigned line, unsigned column)
+{
+  const auto position = lines.position(offset);
+  EXPECT_EQ(line, position.line) << "Offset " << offset;
+  EXPECT_EQ(column, position.column) << "Offset " << offset;
+}
+
+}
+
+TEST(LineIndexTests, TestPositions) {
+  const LineIndex lines("ab\ncde\n\nf");
+  EXPECT_EQ(4, lines.lineCount());
+
+  expectPosition(lines, 0, 1, 1);
+  expectPosition(lines, 1, 1, 2);
+  // A newline belongs to the line it ends.
+  expectPosition(lines, 2, 1, 3);
+  expectPosition(lines, 3, 2, 1);
+  expectPosition(lines, 5, 2, 3);
+  expectPosition(lines, 7, 3, 1);
+  expectPosition(lines, 8, 4, 1);
+  // The end of the source, e.g. where EOF is.
+  expectPosition(lines, 9, 4, 2);
+}
+
+TEST(LineIndexTests, TestEmptySource) {
+  const LineIndex lines("");
+  EXPECT_EQ(1, lines.lineCount());
+  expectPosition(lines, 0, 1, 1);
+}
+
+TEST(LineIndexTests, TestManyLines) {
+  // Long enough for the newlines to be found a block at a time.
+  std::string source;
+  for (int i = 0; i < 200; ++i) {
+    source += std::string(i % 37, 'x') + "\n";
+  }
+  const LineIndex lines(source);
+  EXPECT_EQ(201, lines.lineCount());
+
+  unsigned line = 1;
+  unsigned column = 1;
+  for (uint32_t offset = 0; offset < source.size(); ++offset) {
+    expectPosition(lines, offset, line, column);
+    if (source[offset] == '\n') {
+      ++line;
+      column = 1;
+    } else {
+      ++column;
+    }
+  }
+}
+
+TEST(LineIndexTests, TestErrorResolvedWhenShown) {
+  const std::string source = "1 +\n  @";
+  const CompileError error(6, "Lexer", "Unrecognized character", "");
+
+  EXPECT_NE(std::string::npos, error.what().find("Offset 6"));
+  EXPECT_NE(std::string::npos, describe(error, LineIndex(source)).find("Line 2, column 3"));
+}
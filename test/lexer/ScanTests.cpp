@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "lexer/Scan.h"
+
+using namespace lexer;
+
+namespace {
+
+const char *
+first(const std::string &s)
+{
+  return s.data();
+}
+
+const char *
+last(const std::string &s)
+{
+  return s.data() + s.size();
+}
+
+}
+
+TEST(ScanTests, TestBlockSizeMatchesBuild) {
+#if defined(LOX1_AVX2)
+  EXPECT_EQ(32, scan::blockSize());
+#elif defined(__x86_64__)
+  EXPECT_EQ(16, scan::blockSize());
+#endif
+}
+
+TEST(ScanTests, TestFindInEveryPosition) {
+  // Covers hits in the vectorised part, across block boundaries, and in the tail.
+  for (size_t i = 0; i < 100; ++i) {
+    std::string input(100, 'a');
+    input[i] = '"';
+    EXPECT_EQ(i, scan::find(first(input), last(input), '"') - first(input));
+  }
+}
+
+TEST(ScanTests, TestFindFirstOccurrence) {
+  const std::string input = std::string(40, 'x') + "\n" + std::string(40, 'x') + "\n";
+  EXPECT_EQ(40, scan::find(first(input), last(input), '\n') - first(input));
+}
+
+TEST(ScanTests, TestFindMissing) {
+  const std::string input(77, 'a');
+  EXPECT_EQ(last(input), scan::find(first(input), last(input), '"'));
+  EXPECT_EQ(first(input), scan::find(first(input), first(input), '"'));
+}
+
+TEST(ScanTests, TestCountNewlines) {
+  std::string input;
+  for (int i = 0; i < 50; ++i) {
+    input += "ab\ncd";
+  }
+  EXPECT_EQ(50, scan::countNewlines(first(input), last(input)));
+  EXPECT_EQ(1, scan::countNewlines(first(input), first(input) + 3));
+  EXPECT_EQ(0, scan::countNewlines(first(input), first(input)));
+}
+
+TEST(ScanTests, TestSkipWhitespace) {
+  const std::string input = std::string(20, ' ') + "\n\t\r\n" + std::string(30, ' ') + "\nabc \n";
+  const auto p = scan::skipWhitespace(first(input), last(input));
+  EXPECT_EQ('a', *p);
+}
+
+TEST(ScanTests, TestSkipWhitespaceToEnd) {
+  const std::string input = std::string(45, '\n');
+  EXPECT_EQ(last(input), scan::skipWhitespace(first(input), last(input)));
+}
+
+TEST(ScanTests, TestSkipNoWhitespace) {
+  const std::string input = "a" + std::string(40, ' ');
+  EXPECT_EQ(first(input), scan::skipWhitespace(first(input), last(input)));
+}
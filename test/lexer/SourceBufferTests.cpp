@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+
+#include <unistd.h>
+
+#include "lexer/Lexer.h"
+#include "lexer/SourceBuffer.h"
+
+using namespace lexer;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A file in the temp directory that's removed again at the end of the test.
+class TempFile {
+public:
+  TempFile(const std::string &name, const std::string &contents)
+    : path_(fs::temp_directory_path() / (name + "." + std::to_string(::getpid())))
+  {
+    std::ofstream(path_, std::ios::binary) << contents;
+  }
+
+  ~TempFile() { fs::remove(path_); }
+
+  std::string path() const { return path_.string(); }
+
+private:
+  const fs::path path_;
+
+};
+
+}
+
+TEST(SourceBufferTests, TestMapsRegularFile) {
+  const std::string contents = "var x = \"hello\";\n// comment\n1 + 2.5\n";
+  const TempFile file("lox1-source-buffer", contents);
+
+  const auto source = SourceBuffer::fromFile(file.path());
+  EXPECT_TRUE(source.isMapped());
+  EXPECT_EQ(contents, source.view());
+
+  // The lexer scans the mapping in place.
+  Lexer lexer;
+  const auto tokens = lexer.lex(source.view());
+  ASSERT_EQ(Token::Type::STR, tokens[3].getType());
+  EXPECT_EQ(source.view().data() + 9, tokens[3].getContents().data());
+}
+
+TEST(SourceBufferTests, TestEmptyFile) {
+  const TempFile file("lox1-source-buffer-empty", "");
+  const auto source = SourceBuffer::fromFile(file.path());
+  EXPECT_TRUE(source.view().empty());
+}
+
+TEST(SourceBufferTests, TestReadsPipe) {
+  int fds[2];
+  ASSERT_EQ(0, ::pipe(fds));
+  const std::string contents = "print 1;\n";
+  ASSERT_EQ(static_cast<ssize_t>(contents.size()), ::write(fds[1], contents.data(), contents.size()));
+  ::close(fds[1]);
+
+  // Pipes can't be mapped, so this has to fall back to reading.
+  const auto source = SourceBuffer::fromFile("/dev/fd/" + std::to_string(fds[0]));
+  ::close(fds[0]);
+  EXPECT_FALSE(source.isMapped());
+  EXPECT_EQ(contents, source.view());
+}
+
+TEST(SourceBufferTests, TestMissingFile) {
+  EXPECT_THROW(SourceBuffer::fromFile("/this/file/does/not/exist.lox"), std::runtime_error);
+}
+
+TEST(SourceBufferTests, TestMove) {
+  const TempFile file("lox1-source-buffer-move", "abc");
+  auto source = SourceBuffer::fromFile(file.path());
+  const auto data = source.view().data();
+
+  const auto moved = std::move(source);
+  EXPECT_EQ(data, moved.view().data());
+  EXPECT_EQ("abc", moved.view());
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "lexer/Lexer.h"
+#include "lexer/TokenSource.h"
+#include "lexer/TokenStream.h"
+#include "utils/StringInterner.hpp"
+
+using namespace lexer;
+
+TEST(TokenStreamTests, TestRoundTrip) {
+  utils::StringInterner strings;
+  Lexer lexer(strings);
+  const std::string input =
+R"(var abc = 1.5 * (def - "str
+ing") >= 2;
+if (!abc and this or super) print nil; else return false != true;
+while (x <= 1) { fun, class . for < > == } "" // end
+)";
+
+  const auto expected = lexer.lex(input);
+  const auto stream = lexer.lexToStream(input);
+  ASSERT_EQ(expected.size(), stream.size());
+
+  TokenStreamSource source(stream);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].getType(), stream.type(i)) << "Token " << i;
+
+    const auto actual = source.next();
+    ASSERT_TRUE(actual.has_value());
+    EXPECT_EQ(expected[i].getType(), actual->getType()) << "Token " << i;
+    EXPECT_EQ(expected[i].getContents(), actual->getContents()) << "Token " << i;
+    EXPECT_EQ(expected[i].getSpan().offset, actual->getSpan().offset) << "Token " << i;
+    EXPECT_EQ(expected[i].getSpan().length, actual->getSpan().length) << "Token " << i;
+    EXPECT_EQ(expected[i].getSymbol(), actual->getSymbol()) << "Token " << i;
+    EXPECT_EQ(expected[i].getNumber(), actual->getNumber()) << "Token " << i;
+  }
+  EXPECT_FALSE(source.next().has_value());
+}
+
+TEST(TokenStreamTests, TestSmallerThanVector) {
+  Lexer lexer;
+  std::string input;
+  for (int i = 0; i < 1000; ++i) {
+    input += "(a + 1) * -b != c;\n";
+  }
+
+  const auto tokens = lexer.lex(input);
+  const auto stream = lexer.lexToStream(input);
+
+  EXPECT_LT(stream.memoryUsage(), tokens.capacity() * sizeof(Token) / 2);
+}
@@ -1,13 +1,31 @@
 #include <gtest/gtest.h>
 
 #include "lexer/Lexer.h"
+#include "utils/StringInterner.hpp"
 
 using namespace lexer;
 
 TEST(TokenTests, TestProperties) {
-  const Token token(Token::Type::ID, 2, "abcd");
+  const Token token(Token::Type::ID, "abcd", { 7, 4 });
 
   EXPECT_EQ(token.getType(), Token::Type::ID);
-  EXPECT_EQ(token.getLineNumber(), 2);
   EXPECT_EQ(token.getContents(), "abcd");
+  EXPECT_EQ(token.getSpan().offset, 7);
+  EXPECT_EQ(token.getSpan().length, 4);
+}
+
+TEST(TokenTests, TestSymbolOrNumber) {
+  utils::StringInterner strings;
+  const Token id(Token::Type::ID, "abc", { 0, 3 }, strings.intern("abc"));
+  EXPECT_EQ(strings.intern("abc"), id.getSymbol());
+  EXPECT_FALSE(id.getNumber());
+
+  const Token num(Token::Type::NUM, "2.5", { 0, 3 }, {}, 2.5);
+  EXPECT_EQ(2.5, num.getNumber());
+  EXPECT_FALSE(num.getSymbol().isValid());
+
+  // Made by hand, with only the text.
+  const Token text(Token::Type::NUM, "2.5", { 0, 3 });
+  EXPECT_FALSE(text.getNumber());
+  EXPECT_FALSE(text.getSymbol().isValid());
 }
@@ -3,9 +3,13 @@
 #include <variant>
 #include <vector>
 #include <sstream>
+#include <string>
+#include <thread>
 
 #include "parser/Parser.h"
 #include "visit/PrettyPrinter.hpp"
+#include "visit/SmallVisitors.hpp"
+#include "utils/AllocationCounter.hpp"
 
 using lexer::Token;
 using parser::Parser;
@@ -31,7 +35,8 @@ assertProbablyTheSame(Expr &e1, Expr &e2)
 void
 assertDoesNotCompile(const std::vector<Token> &tokens)
 {
-  Parser parser;
+  utils::StringInterner strings;
+  Parser parser(strings);
   try {
     parser.parse(tokens);
 
@@ -56,30 +61,32 @@ assertDoesNotCompile(const std::vector<Token> &tokens)
 }
 
 TEST(ParserTests, TestPrimaryExpression) {
-  Parser parser;
+  utils::StringInterner strings;
+  Parser parser(strings);
 
   auto expr = parser.parse(
     {
-      Token(Token::Type::STR, 1, "hello"),
-      Token(Token::Type::EOFF, 1, ""),
+      Token(Token::Type::STR, "hello"),
+      Token(Token::Type::EOFF, ""),
     }
   );
 
-  ASSERT_EQ("hello", std::get<ast::StringPtr>(expr)->value());
+  ASSERT_EQ("hello", std::get<ast::StringPtr>(expr)->value().str());
 }
 
 TEST(ParserTests, TestOperatorPrecedence) {
-  Parser parser;
+  utils::StringInterner strings;
+  Parser parser(strings);
 
   Expr actual = parser.parse({
-    Token(Token::Type::NUM, 1, "1"),
-    Token(Token::Type::PLUS, 1, ""),
-    Token(Token::Type::NUM, 1, "2"),
-    Token(Token::Type::STAR, 1, ""),
-    Token(Token::Type::NUM, 1, "3"),
-    Token(Token::Type::PLUS, 1, ""),
-    Token(Token::Type::NUM, 1, "4"),
-    Token(Token::Type::EOFF, 1, ""),
+    Token(Token::Type::NUM, "1"),
+    Token(Token::Type::PLUS, ""),
+    Token(Token::Type::NUM, "2"),
+    Token(Token::Type::STAR, ""),
+    Token(Token::Type::NUM, "3"),
+    Token(Token::Type::PLUS, ""),
+    Token(Token::Type::NUM, "4"),
+    Token(Token::Type::EOFF, ""),
   });
 
   Expr expected = add(add(num(1), mult(num(2), num(3))), num(4));
@@ -87,27 +94,61 @@ TEST(ParserTests, TestOperatorPrecedence) {
   assertProbablyTheSame(actual, expected);
 }
 
+TEST(ParserTests, TestEveryPrecedenceLevel) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto tokens = lexer.lexToStream("1 == 2 < 3 - 4 / -5 != 6 >= 7 * 8 + 9 - 10");
+  Parser parser(strings);
+
+  Expr actual = parser.parse(tokens);
+
+  Expr expected = neq(
+    eq(num(1), lt(num(2), sub(num(3), div(num(4), negate(num(5)))))),
+    gtEq(num(6), sub(add(mult(num(7), num(8)), num(9)), num(10)))
+  );
+
+  assertProbablyTheSame(actual, expected);
+}
+
+TEST(ParserTests, TestParseMillionDeepChain) {
+  // Left-leaning chains are parsed in a loop, and the tree is destroyed with a worklist,
+  // so neither should run out of stack.
+  std::string input = "1";
+  for (int i = 0; i < 1000000; ++i) {
+    input += "+1";
+  }
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto tokens = lexer.lexToStream(input);
+  Parser parser(strings);
+
+  auto expr = parser.parse(tokens);
+
+  EXPECT_TRUE(std::holds_alternative<BinOpPtr>(expr));
+}
+
 TEST(ParserTests, TestTrailingBinOp) {
   assertDoesNotCompile({
-    Token(Token::Type::NUM, 1, "1"),
-    Token(Token::Type::EQ_EQ, 1, ""),
-    Token(Token::Type::EOFF, 1, ""),
+    Token(Token::Type::NUM, "1"),
+    Token(Token::Type::EQ_EQ, ""),
+    Token(Token::Type::EOFF, ""),
   });
 }
 
 TEST(ParserTests, TestGrouping) {
-  Parser parser;
+  utils::StringInterner strings;
+  Parser parser(strings);
 
   Expr actual = parser.parse(
     {
-      Token(Token::Type::LPEREN, 1, ""),
-      Token(Token::Type::NUM, 1, "1"),
-      Token(Token::Type::MINUS, 1, ""),
-      Token(Token::Type::NUM, 1, "2"),
-      Token(Token::Type::RPEREN, 1, ""),
-      Token(Token::Type::STAR, 1, ""),
-      Token(Token::Type::NUM, 3, "3"),
-      Token(Token::Type::EOFF, 1, ""),
+      Token(Token::Type::LPEREN, ""),
+      Token(Token::Type::NUM, "1"),
+      Token(Token::Type::MINUS, ""),
+      Token(Token::Type::NUM, "2"),
+      Token(Token::Type::RPEREN, ""),
+      Token(Token::Type::STAR, ""),
+      Token(Token::Type::NUM, "3"),
+      Token(Token::Type::EOFF, ""),
     }
   );
 
@@ -119,31 +160,32 @@ TEST(ParserTests, TestGrouping) {
 TEST(ParserTests, TestUnclosedGroup) {
   assertDoesNotCompile(
     {
-      Token(Token::Type::NUM, 1, "1"),
-      Token(Token::Type::PLUS, 1, ""),
-      Token(Token::Type::LPEREN, 1, ""),
-      Token(Token::Type::NUM, 1, "2"),
-      Token(Token::Type::PLUS, 1, ""),
-      Token(Token::Type::NUM, 1, "3"),
+      Token(Token::Type::NUM, "1"),
+      Token(Token::Type::PLUS, ""),
+      Token(Token::Type::LPEREN, ""),
+      Token(Token::Type::NUM, "2"),
+      Token(Token::Type::PLUS, ""),
+      Token(Token::Type::NUM, "3"),
       // Missing bracket:
-      //Token(Token::Type::RPEREN, 1, ""),
-      Token(Token::Type::EOFF, 1, ""),
+      //Token(Token::Type::RPEREN, ""),
+      Token(Token::Type::EOFF, ""),
     }
   );
 }
 
 TEST(ParserTests, TestNestedUnaryOps) {
-  Parser parser;
+  utils::StringInterner strings;
+  Parser parser(strings);
 
   Expr actual = parser.parse(
     {
-      Token(Token::Type::MINUS, 1, ""),
-      Token(Token::Type::NUM, 1, "1"),
-      Token(Token::Type::MINUS, 1, ""),
-      Token(Token::Type::MINUS, 1, ""),
-      Token(Token::Type::MINUS, 1, ""),
-      Token(Token::Type::NUM, 1, "2"),
-      Token(Token::Type::EOFF, 1, ""),
+      Token(Token::Type::MINUS, ""),
+      Token(Token::Type::NUM, "1"),
+      Token(Token::Type::MINUS, ""),
+      Token(Token::Type::MINUS, ""),
+      Token(Token::Type::MINUS, ""),
+      Token(Token::Type::NUM, "2"),
+      Token(Token::Type::EOFF, ""),
     }
   );
 
@@ -155,11 +197,11 @@ TEST(ParserTests, TestNestedUnaryOps) {
 TEST(ParserTests, TestLeadingBinOp) {
   assertDoesNotCompile(
     {
-      Token(Token::Type::SLASH, 1, ""),
-      Token(Token::Type::NUM, 1, "10"),
-      Token(Token::Type::MINUS, 1, ""),
-      Token(Token::Type::NUM, 1, "9"),
-      Token(Token::Type::EOFF, 1, ""),
+      Token(Token::Type::SLASH, ""),
+      Token(Token::Type::NUM, "10"),
+      Token(Token::Type::MINUS, ""),
+      Token(Token::Type::NUM, "9"),
+      Token(Token::Type::EOFF, ""),
     }
   );
 }
@@ -167,9 +209,9 @@ TEST(ParserTests, TestLeadingBinOp) {
 TEST(ParserTests, TestInvalidPrimaryExpression) {
   assertDoesNotCompile(
     {
-      Token(Token::Type::NIL, 1, ""),
-      Token(Token::Type::NIL, 1, ""),
-      Token(Token::Type::EOFF, 1, ""),
+      Token(Token::Type::NIL, ""),
+      Token(Token::Type::NIL, ""),
+      Token(Token::Type::EOFF, ""),
     }
   );
 }
@@ -177,27 +219,297 @@ TEST(ParserTests, TestInvalidPrimaryExpression) {
 TEST(ParserTests, TestUnsupportedNumber) {
   assertDoesNotCompile(
     {
-      // I tried to use a long number here, hoping that the standard library would
-      // complain but it seems to just round the number to the closest thing
-      // it can represent. I'm not sure if that's always the case or if it's
-      // platform-specific, so I think it's good to have code in the parser for
-      // catching and forwarding the exceptions that the STL throws.
-      // And we need to test it somehow so just throw some junk in -- this should
-      // never get past the lexer in the first place.
-      Token(Token::Type::NUM, 1, "thisisnotanumber"),
-      Token(Token::Type::EOFF, 1, "")
+      // Tokens from the lexer already carry their value, but hand-made ones like
+      // these only have the text, which the parser has to convert itself.
+      // So throw some junk in -- this should never get past the lexer in the first place.
+      Token(Token::Type::NUM, "thisisnotanumber"),
+      Token(Token::Type::EOFF, "")
     }
   );
 }
 
+TEST(ParserTests, TestNumberValueFromLexer) {
+  utils::StringInterner strings;
+  Parser parser(strings);
+
+  // Numbers from the lexer come with their value already converted.
+  auto expr = parser.parse(
+    {
+      Token(Token::Type::NUM, "2.5", {}, {}, 2.5),
+      Token(Token::Type::EOFF, ""),
+    }
+  );
+
+  ASSERT_EQ(2.5, std::get<ast::NumPtr>(expr)->value());
+}
+
 TEST(ParserTests, TestEOFNotEndOfProgram) {
   assertDoesNotCompile(
     {
-      Token(Token::Type::NUM, 1, "1"),
-      Token(Token::Type::EOFF, 1, ""), // This EOF should cause problems.
-      Token(Token::Type::PLUS, 1, ""),
-      Token(Token::Type::NUM, 1, "1"),
-      Token(Token::Type::EOFF, 1, ""),
+      Token(Token::Type::NUM, "1"),
+      Token(Token::Type::EOFF, ""), // This EOF should cause problems.
+      Token(Token::Type::PLUS, ""),
+      Token(Token::Type::NUM, "1"),
+      Token(Token::Type::EOFF, ""),
     }
   );
 }
+
+TEST(ParserTests, TestParseWhileLexing) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "(1 - 2) * -3 == \"abc\"\n!= true";
+  lexer::LexerTokenSource tokens(lexer, input);
+
+  Parser parser(strings);
+  Expr actual = parser.parse(tokens);
+
+  Expr expected = neq(eq(mult(grouping(sub(num(1), num(2))), negate(num(3))), string(strings.intern("abc"))), truee());
+  assertProbablyTheSame(actual, expected);
+}
+
+TEST(ParserTests, TestParseWhileLexingFailsOnLexerError) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "1 + 2 @";
+  lexer::LexerTokenSource tokens(lexer, input);
+
+  Parser parser(strings);
+  EXPECT_THROW(parser.parse(tokens), ErrorCollection);
+}
+
+TEST(ParserTests, TestParseWhileLexingReportsLexerErrorFirst) {
+  // The parser fails at the '2' before the lexer reaches the end of the source and
+  // reports the '@', but it's the lexer's error that explains what went wrong.
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "1 @ 2 # 3";
+  lexer::LexerTokenSource tokens(lexer, input);
+
+  Parser parser(strings);
+  try {
+    parser.parse(tokens);
+    FAIL() << "Expected the lexer's errors";
+  } catch (const ErrorCollection &errors) {
+    ASSERT_EQ(2, errors.errors().size());
+    EXPECT_EQ(2, errors.errors()[0].offset());
+    EXPECT_EQ(6, errors.errors()[1].offset());
+  }
+
+  // A parse error with nothing wrong in the source is still the parser's.
+  const std::string valid = "1 2";
+  lexer::LexerTokenSource validTokens(lexer, valid);
+  EXPECT_THROW(parser.parse(validTokens), CompileError);
+}
+
+TEST(ParserTests, TestErrorBeforeAnyTokenPointsAtEnd) {
+  // Nothing is consumed before the parser finds out that there's no expression, so
+  // the error is where the source ends rather than where it starts.
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "  // nothing here\n  ";
+  const auto tokens = lexer.lexToStream(input);
+  Parser parser(strings);
+  try {
+    parser.parse(tokens);
+    FAIL() << "Expected an empty source to fail parsing";
+  } catch (const CompileError &error) {
+    EXPECT_EQ(input.size(), error.offset());
+  }
+}
+
+TEST(ParserTests, TestEmptyTokens) {
+  assertDoesNotCompile({});
+}
+
+TEST(ParserTests, TestStringsShareInterner) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "\"abc\" == \"abc\"";
+  lexer::LexerTokenSource tokens(lexer, input);
+
+  Parser parser(strings);
+  Expr expr = parser.parse(tokens);
+
+  const auto &binOp = std::get<ast::BinOpPtr>(expr);
+  const auto lhs = std::get<ast::StringPtr>(binOp->lhs())->value();
+  const auto rhs = std::get<ast::StringPtr>(binOp->rhs())->value();
+  EXPECT_EQ(lhs, rhs);
+  EXPECT_EQ(strings.intern("abc"), lhs);
+  EXPECT_EQ(1, strings.size());
+}
+
+TEST(ParserTests, TestNoStringCopiesWhenSharingInterner) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  // Longer than std::string's small string buffer, so a copy would have to allocate.
+  const std::string input = "\"a string too long to be stored inline\" == \"another string\" + \"another string\"";
+  auto tokens = lexer.lex(input);
+  const auto stringCount = strings.size();
+  Parser parser(strings);
+
+  const auto before = utils::allocationCount();
+  Expr expr = parser.parse(std::move(tokens));
+  const auto allocations = utils::allocationCount() - before;
+
+  // The tokens are moved through to the parser, and the strings reach the tree as the
+  // lexer's symbols, so the only allocations are for the 5 nodes.
+  EXPECT_EQ(5, allocations);
+  EXPECT_EQ(stringCount, strings.size());
+  const auto &binOp = std::get<ast::BinOpPtr>(expr);
+  EXPECT_EQ("a string too long to be stored inline", std::get<ast::StringPtr>(binOp->lhs())->value().str());
+}
+
+TEST(ParserTests, TestParseIntoArena) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "1 + 2 * -3";
+  lexer::LexerTokenSource tokens(lexer, input);
+
+  Arena arena;
+  Parser parser(strings);
+  const auto expr = parser.parse(tokens, arena);
+
+  // Every node came from the arena.
+  EXPECT_EQ(6, arena.objectCount());
+  const auto add = std::get<ast::arena::BinOpPtr>(expr);
+  EXPECT_EQ(ast::BinOp::Op::Add, add->operation());
+  EXPECT_EQ(1, std::get<ast::arena::NumPtr>(add->lhs())->value());
+  const auto mult = std::get<ast::arena::BinOpPtr>(add->rhs());
+  EXPECT_EQ(ast::BinOp::Op::Mult, mult->operation());
+  EXPECT_EQ(2, std::get<ast::arena::NumPtr>(mult->lhs())->value());
+  const auto negate = std::get<ast::arena::UnaryOpPtr>(mult->rhs());
+  EXPECT_EQ(ast::UnaryOp::Op::Negate, negate->operation());
+  EXPECT_EQ(3, std::get<ast::arena::NumPtr>(negate->child())->value());
+}
+
+TEST(ParserTests, TestParseIntoFlatTree) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "1 + 2 * (3 - \"x\") >= -4 == !true";
+  const auto tokens = lexer.lexToStream(input);
+
+  Parser parser(strings);
+  const Expr expected = parser.parse(tokens);
+
+  ast::flat::Tree tree;
+  const auto actual = parser.parse(tokens, tree);
+
+  // 14 nodes, built children first.
+  EXPECT_EQ(14, tree.size());
+  EXPECT_EQ(tree.root(), actual);
+  visit::PrettyPrinter printer;
+  EXPECT_EQ(printer.print(expected), printer.print(tree, actual));
+}
+
+TEST(ParserTests, TestNodeIdsAreDenseInEachTree) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto tokens = lexer.lexToStream("(1 + 2) * -3 == nil");
+  Parser parser(strings);
+
+  for (int parse = 0; parse < 2; ++parse) {
+    ast::flat::Tree tree;
+    parser.parse(tokens, tree);
+
+    // Nodes are added to a flat tree as they're made, so their ids are their indices.
+    ASSERT_EQ(tree.size(), parser.nodeCount());
+    for (uint32_t index = 0; index < tree.size(); ++index) {
+      EXPECT_EQ(index, visit::id(tree, ast::flat::Expr{ index }));
+    }
+  }
+}
+
+TEST(ParserTests, TestConcurrentParses) {
+  // Each thread has its own parser, so each gets its own ids.
+  const std::string input = "1 + 2 * (3 - \"x\") >= -4 == !true";
+  std::vector<std::thread> threads;
+  std::vector<int> allDense(4, false);
+  for (size_t thread = 0; thread < allDense.size(); ++thread) {
+    threads.emplace_back([&input, &allDense, thread] {
+      utils::StringInterner strings;
+      lexer::Lexer lexer(strings);
+      Parser parser(strings);
+      bool dense = true;
+      for (int parse = 0; parse < 100; ++parse) {
+        lexer::LexerTokenSource source(lexer, input);
+        const Expr expr = parser.parse(source);
+        // The root is made last.
+        dense = dense && parser.nodeCount() == 14 && visit::id(expr) == 13;
+      }
+      allDense[thread] = dense;
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(std::vector<int>(4, true), allDense);
+}
+
+TEST(ParserTests, TestParseSharedSubtrees) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const auto tokens = lexer.lexToStream("(1 + 2) * (1 + 2) == (1 + 2) * (1 + 2) == -(1 + 2)");
+  Parser parser(strings);
+
+  ast::flat::Tree separate;
+  const auto separateRoot = parser.parse(tokens, separate);
+
+  ast::flat::Tree shared;
+  const auto sharedRoot = parser.parse(tokens, shared, Parser::Subtrees::Shared);
+
+  // 1, 2, +, (group), *, ==, -, and the == at the root.
+  EXPECT_EQ(8, shared.size());
+  EXPECT_LT(shared.size(), separate.size());
+  EXPECT_EQ(shared.size(), parser.nodeCount());
+  EXPECT_TRUE(ast::flat::structurallyEqual(separate, separateRoot, shared, sharedRoot));
+  visit::PrettyPrinter printer;
+  EXPECT_EQ(printer.print(separate, separateRoot), printer.print(shared, sharedRoot));
+  // Ids are still only handed out to nodes that are added.
+  for (uint32_t index = 0; index < shared.size(); ++index) {
+    EXPECT_EQ(index, visit::id(shared, ast::flat::Expr{ index }));
+  }
+}
+
+TEST(ParserTests, TestParseTokenStream) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "1 + 2 * (3 - \"x\") >= -4";
+  const auto tokens = lexer.lexToStream(input);
+  lexer::TokenStreamSource source(tokens);
+
+  Parser parser(strings);
+  Expr expected = gtEq(add(num(1), mult(num(2), grouping(sub(num(3), string(strings.intern("x")))))), negate(num(4)));
+
+  // Read in place, and copied out one token at a time.
+  Expr actual = parser.parse(tokens);
+  assertProbablyTheSame(actual, expected);
+  Expr fromSource = parser.parse(source);
+  assertProbablyTheSame(fromSource, expected);
+}
+
+TEST(ParserTests, TestParseTokenStreamErrors) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  Parser parser(strings);
+
+  // Errors point at the same tokens either way the stream is read.
+  for (const std::string input : { "1 + (2 * \"x\"", "1 + * 2", "(1) 2", "" }) {
+    const auto tokens = lexer.lexToStream(input);
+    uint32_t offset = 0;
+    try {
+      parser.parse(tokens);
+      FAIL() << "Expected " << input << " to fail parsing";
+    } catch (const CompileError &error) {
+      offset = error.offset();
+    }
+    lexer::TokenStreamSource source(tokens);
+    try {
+      parser.parse(source);
+      FAIL() << "Expected " << input << " to fail parsing";
+    } catch (const CompileError &error) {
+      EXPECT_EQ(offset, error.offset()) << input;
+    }
+  }
+}
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "utils/StringInterner.hpp"
+
+TEST(StringInternerTests, TestSameStringSameSymbol) {
+  utils::StringInterner strings;
+
+  const auto a1 = strings.intern("abc");
+  const auto b = strings.intern("abd");
+  const auto a2 = strings.intern(std::string("ab") + "c");
+
+  EXPECT_EQ(a1, a2);
+  EXPECT_NE(a1, b);
+  EXPECT_EQ("abc", a1.str());
+  EXPECT_EQ("abd", b.str());
+  EXPECT_EQ(2, strings.size());
+}
+
+TEST(StringInternerTests, TestSymbolsStayValid) {
+  utils::StringInterner strings;
+
+  // Short strings are stored inline in std::string, so make sure growing
+  // the interner doesn't move them.
+  const auto first = strings.intern("x");
+  for (int i = 0; i < 10000; ++i) {
+    strings.intern(std::to_string(i));
+  }
+
+  EXPECT_EQ("x", first.str());
+  EXPECT_EQ(first, strings.intern("x"));
+}
+
+TEST(StringInternerTests, TestEmptyAndInvalidSymbols) {
+  utils::StringInterner strings;
+
+  const auto empty = strings.intern("");
+  EXPECT_TRUE(empty.isValid());
+  EXPECT_EQ("", empty.str());
+
+  const utils::Symbol invalid;
+  EXPECT_FALSE(invalid.isValid());
+  EXPECT_NE(empty, invalid);
+}
+
+TEST(StringInternerTests, TestRawRoundTrip) {
+  utils::StringInterner strings;
+
+  const auto symbol = strings.intern("x");
+  EXPECT_EQ(symbol, utils::Symbol::fromRaw(symbol.raw()));
+  EXPECT_EQ("x", utils::Symbol::fromRaw(symbol.raw()).str());
+  EXPECT_EQ(nullptr, utils::Symbol().raw());
+  EXPECT_FALSE(utils::Symbol::fromRaw(nullptr).isValid());
+}
@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <string>
+#include <stdexcept>
+
+#include "lexer/Lexer.h"
+#include "lexer/TokenStream.h"
+#include "parser/Parser.h"
+#include "utils/AllocationCounter.hpp"
+#include "utils/StringInterner.hpp"
+#include "visit/Evaluator.hpp"
+
+using visit::Value;
+
+namespace {
+
+ast::Expr
+parse(utils::StringInterner &strings, const std::string &source)
+{
+  lexer::Lexer lexer(strings);
+  const auto stream = lexer.lexToStream(source);
+  parser::Parser parser(strings);
+  return parser.parse(stream);
+}
+
+Value
+evaluate(const std::string &source)
+{
+  static utils::StringInterner strings;
+  static visit::Evaluator evaluator(strings);
+  return evaluator.evaluate(parse(strings, source));
+}
+
+}
+
+TEST(EvaluatorTests, TestArithmetic) {
+  EXPECT_EQ(Value::number(7), evaluate("1 + 2 * 3"));
+  EXPECT_EQ(Value::number(9), evaluate("(1 + 2) * 3"));
+  EXPECT_EQ(Value::number(-1), evaluate("1 - 4 / 2"));
+  EXPECT_EQ(Value::number(4), evaluate("-(-4)"));
+  EXPECT_TRUE(std::isinf(evaluate("1 / 0").asNumber()));
+}
+
+TEST(EvaluatorTests, TestComparisonAndEquality) {
+  EXPECT_EQ(Value::boolean(true), evaluate("1 < 2 == 3 >= 3"));
+  EXPECT_EQ(Value::boolean(false), evaluate("2 <= 1"));
+  EXPECT_EQ(Value::boolean(true), evaluate("nil == nil"));
+  EXPECT_EQ(Value::boolean(false), evaluate("nil == false"));
+  EXPECT_EQ(Value::boolean(true), evaluate("1 != \"1\""));
+  EXPECT_EQ(Value::boolean(true), evaluate("!nil == !false"));
+  EXPECT_EQ(Value::boolean(false), evaluate("!0"));
+}
+
+TEST(EvaluatorTests, TestStrings) {
+  const auto joined = evaluate("\"con\" + \"cat\"");
+  ASSERT_TRUE(joined.isString());
+  EXPECT_EQ("concat", joined.asString().str());
+  // Made strings are interned, so they're equal to the same string written out.
+  EXPECT_EQ(Value::boolean(true), evaluate("\"a\" + \"b\" == \"ab\""));
+}
+
+TEST(EvaluatorTests, TestTypeErrors) {
+  EXPECT_THROW(evaluate("1 + \"a\""), std::runtime_error);
+  EXPECT_THROW(evaluate("\"a\" * 2"), std::runtime_error);
+  EXPECT_THROW(evaluate("true < false"), std::runtime_error);
+  EXPECT_THROW(evaluate("-nil"), std::runtime_error);
+  // The evaluator can be used again after an error.
+  EXPECT_EQ(Value::number(3), evaluate("1 + 2"));
+}
+
+TEST(EvaluatorTests, TestNoAllocations) {
+  utils::StringInterner strings;
+  visit::Evaluator evaluator(strings);
+  const auto expr = parse(strings, "(1 + 2) * -3 >= 4 / (5 - 6) == !nil != (\"s\" == \"s\")");
+  evaluator.evaluate(expr); // grow the stacks
+  const auto before = utils::allocationCount();
+  EXPECT_EQ(Value::boolean(true), evaluator.evaluate(expr));
+  EXPECT_EQ(before, utils::allocationCount());
+}
+
+TEST(EvaluatorTests, TestMillionDeepChain) {
+  std::string source = "0";
+  for (int i = 0; i < 1000000; ++i) {
+    source += i % 2 ? "-1" : "+2";
+  }
+  EXPECT_EQ(Value::number(500000), evaluate(source));
+}
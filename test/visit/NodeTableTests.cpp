@@ -0,0 +1,95 @@
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "lexer/Lexer.h"
+#include "lexer/TokenSource.h"
+#include "parser/Parser.h"
+#include "visit/NodeTable.hpp"
+
+namespace {
+
+// Records how deep each node is, with the root at depth 0.
+class DepthAnnotator final : ast::ConstVisitor<void> {
+public:
+  explicit DepthAnnotator(visit::NodeTable<int> &depths)
+    : depths_(depths)
+    { }
+
+  void
+  annotate(const ast::Expr &expr)
+  {
+    depth_ = 0;
+    visit(expr);
+  }
+
+private:
+  void visitBinOp(const ast::BinOp &binOp) override { record(binOp, { &binOp.lhs(), &binOp.rhs() }); }
+  void visitUnaryOp(const ast::UnaryOp &unaryOp) override { record(unaryOp, { &unaryOp.child() }); }
+  void visitString(const ast::String &string) override { record(string, {}); }
+  void visitNum(const ast::Num &num) override { record(num, {}); }
+  void visitGrouping(const ast::Grouping &grouping) override { record(grouping, { &grouping.child() }); }
+  void visitTruee(const ast::Truee &truee) override { record(truee, {}); }
+  void visitFalsee(const ast::Falsee &falsee) override { record(falsee, {}); }
+  void visitNil(const ast::Nil &nil) override { record(nil, {}); }
+
+  template <class Node>
+  void
+  record(const Node &node, std::initializer_list<const ast::Expr *> children)
+  {
+    depths_[node] = depth_;
+    ++depth_;
+    for (const auto child : children) {
+      visit(*child);
+    }
+    --depth_;
+  }
+
+  visit::NodeTable<int> &depths_;
+  int depth_ = 0;
+
+};
+
+}
+
+TEST(NodeTableTests, TestAnnotateParsedTree) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "1 + -(2 * nil)";
+  lexer::LexerTokenSource source(lexer, input);
+  parser::Parser parser(strings);
+  const ast::Expr expr = parser.parse(source);
+
+  visit::NodeTable<int> depths(parser.nodeCount(), -1);
+  DepthAnnotator(depths).annotate(expr);
+
+  ASSERT_EQ(7, depths.size());
+  EXPECT_EQ(0, depths[expr]);
+  const auto &add = *std::get<ast::BinOpPtr>(expr);
+  EXPECT_EQ(1, depths[add.lhs()]);
+  const auto &negate = *std::get<ast::UnaryOpPtr>(add.rhs());
+  EXPECT_EQ(1, depths[negate]);
+  const auto &grouping = *std::get<ast::GroupingPtr>(negate.child());
+  const auto &mult = *std::get<ast::BinOpPtr>(grouping.child());
+  EXPECT_EQ(4, depths[mult.rhs()]);
+  // Every node was visited.
+  for (size_t id = 0; id < depths.size(); ++id) {
+    EXPECT_NE(-1, depths[id]);
+  }
+}
+
+TEST(NodeTableTests, TestFlatTreeIds) {
+  utils::StringInterner strings;
+  lexer::Lexer lexer(strings);
+  const std::string input = "true == !false";
+  lexer::LexerTokenSource source(lexer, input);
+  parser::Parser parser(strings);
+  ast::flat::Tree tree;
+  const auto root = parser.parse(source, tree);
+
+  visit::NodeTable<std::string> names(parser.nodeCount());
+  names[visit::id(tree, root)] = "root";
+
+  EXPECT_EQ("root", names[tree.size() - 1]);
+  EXPECT_EQ("", names[0]);
+}
@@ -43,8 +43,9 @@ TEST(PrettyPrinterTests, TestDropTrailingZerosAndDot) {
 
 TEST(PrettyPrinterTests, TestString) {
   visit::PrettyPrinter printer;
+  utils::StringInterner strings;
 
-  ast::Expr string = ast::string("a b c 123");
+  ast::Expr string = ast::string(strings.intern("a b c 123"));
   auto printedString = printer.print(string);
 
   ASSERT_EQ("\"a b c 123\"", printedString);
@@ -52,11 +53,57 @@ TEST(PrettyPrinterTests, TestString) {
 
 TEST(PrettyPrinterTests, TestBigTree) {
   visit::PrettyPrinter printer;
+  utils::StringInterner strings;
 
   using namespace ast;
 
-  Expr expr = mult(add(num(1.5), num(2)), grouping(negate(string("1 1 1"))));
+  Expr expr = mult(add(num(1.5), num(2)), grouping(negate(string(strings.intern("1 1 1")))));
   auto printedExpr = printer.print(expr);
 
   ASSERT_EQ("(* (+ 1.5 2) (group (- \"1 1 1\")))", printedExpr);
 }
+
+TEST(PrettyPrinterTests, TestFlatTree) {
+  visit::PrettyPrinter printer;
+  utils::StringInterner strings;
+
+  using namespace ast::flat;
+
+  Tree tree;
+  // Children are added to the tree before their parents.
+  const auto lhs = add(tree, num(tree, 1.5), num(tree, 2));
+  const auto rhs = grouping(tree, negate(tree, string(tree, strings.intern("1 1 1"))));
+  const auto expr = mult(tree, Expr(lhs), Expr(rhs));
+
+  EXPECT_EQ(tree.root(), expr);
+  EXPECT_EQ("(* (+ 1.5 2) (group (- \"1 1 1\")))", printer.print(tree, expr));
+  EXPECT_EQ("(+ 1.5 2)", printer.print(tree, lhs));
+}
+
+TEST(PrettyPrinterTests, TestMillionDeepTree) {
+  // Deep enough to overflow the stack if printing recursed.
+  constexpr int depth = 1000000;
+  ast::Expr expr = ast::num(1);
+  ast::flat::Tree tree;
+  auto flatExpr = ast::flat::num(tree, 1);
+  for (int i = 0; i < depth; ++i) {
+    if (i % 2) {
+      expr = ast::add(ast::num(2), std::move(expr));
+      flatExpr = ast::flat::add(tree, ast::flat::num(tree, 2), std::move(flatExpr));
+    } else {
+      expr = ast::negate(std::move(expr));
+      flatExpr = ast::flat::negate(tree, std::move(flatExpr));
+    }
+  }
+  // The last node made is on the outside.
+  std::string expected;
+  for (int i = depth - 1; i >= 0; --i) {
+    expected += i % 2 ? "(+ 2 " : "(- ";
+  }
+  expected += "1" + std::string(depth, ')');
+
+  visit::PrettyPrinter printer;
+  // Not EXPECT_EQ, which would print megabytes on failure.
+  EXPECT_TRUE(expected == printer.print(expr));
+  EXPECT_TRUE(expected == printer.print(tree, flatExpr));
+}
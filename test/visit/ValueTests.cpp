@@ -0,0 +1,75 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <limits>
+
+#include "utils/StringInterner.hpp"
+#include "visit/Value.hpp"
+
+using visit::Value;
+
+TEST(ValueTests, TestKinds) {
+  utils::StringInterner strings;
+  const Value values[] = {
+    Value::nil(), Value::boolean(false), Value::boolean(true), Value::number(1.5), Value::string(strings.intern("a"))
+  };
+  for (const auto value : values) {
+    EXPECT_EQ(1, value.isNil() + value.isBool() + value.isNumber() + value.isString());
+  }
+  EXPECT_TRUE(values[0].isNil());
+  EXPECT_FALSE(values[1].asBool());
+  EXPECT_TRUE(values[2].asBool());
+  EXPECT_EQ(1.5, values[3].asNumber());
+  EXPECT_EQ("a", values[4].asString().str());
+}
+
+TEST(ValueTests, TestSpecialNumbers) {
+  const double numbers[] = {
+    0.0, -0.0, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::max(), std::numeric_limits<double>::denorm_min(), -1e300
+  };
+  for (const auto number : numbers) {
+    const auto value = Value::number(number);
+    ASSERT_TRUE(value.isNumber());
+    EXPECT_EQ(std::signbit(number), std::signbit(value.asNumber()));
+    EXPECT_EQ(number, value.asNumber());
+  }
+
+  // Whatever bits a NaN has, it stays a number.
+  for (const auto nan : { std::nan(""), -std::nan(""), std::numeric_limits<double>::signaling_NaN(), 0.0 / 0.0 }) {
+    const auto value = Value::number(nan);
+    ASSERT_TRUE(value.isNumber());
+    EXPECT_TRUE(std::isnan(value.asNumber()));
+    EXPECT_NE(value, value);
+  }
+}
+
+TEST(ValueTests, TestEquality) {
+  utils::StringInterner strings;
+  EXPECT_EQ(Value::number(0.0), Value::number(-0.0));
+  EXPECT_EQ(Value::nil(), Value::nil());
+  EXPECT_EQ(Value::string(strings.intern("ab")), Value::string(strings.intern("ab")));
+  EXPECT_NE(Value::string(strings.intern("ab")), Value::string(strings.intern("ba")));
+  // Different kinds are never equal, even when they'd be truthy or falsy alike.
+  EXPECT_NE(Value::nil(), Value::boolean(false));
+  EXPECT_NE(Value::number(1), Value::boolean(true));
+  EXPECT_NE(Value::number(0), Value::nil());
+}
+
+TEST(ValueTests, TestTruthiness) {
+  utils::StringInterner strings;
+  EXPECT_FALSE(Value::nil().isTruthy());
+  EXPECT_FALSE(Value::boolean(false).isTruthy());
+  EXPECT_TRUE(Value::boolean(true).isTruthy());
+  EXPECT_TRUE(Value::number(0).isTruthy());
+  EXPECT_TRUE(Value::string(strings.intern("")).isTruthy());
+}
+
+TEST(ValueTests, TestToString) {
+  utils::StringInterner strings;
+  EXPECT_EQ("nil", Value::nil().toString());
+  EXPECT_EQ("true", Value::boolean(true).toString());
+  EXPECT_EQ("3", Value::number(3).toString());
+  EXPECT_EQ("-2.5", Value::number(-2.5).toString());
+  EXPECT_EQ("hi there", Value::string(strings.intern("hi there")).toString());
+}